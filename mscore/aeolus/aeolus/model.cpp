@@ -24,6 +24,37 @@
 
 #define VERSION "0.0.0"
 
+//---------------------------------------------------------
+//   RankJob
+//    load or generate the waves of one rank
+//---------------------------------------------------------
+
+struct RankJob {
+      int divis;
+      int rank;
+      Addsynth* sdef;
+      Rankwave* wave;
+      float fsamp;
+      float fbase;
+      float* scale;
+      const char* path;
+      bool edited;            // stop was edited, do not load
+      };
+
+//---------------------------------------------------------
+//   loadRank
+//    generate the waves if there is no waveform file for
+//    the current tuning and save them for the next time
+//---------------------------------------------------------
+
+static void loadRank(RankJob& j)
+      {
+      if (j.edited || j.wave->load(j.path, j.sdef, j.fsamp, j.fbase, j.scale)) {
+            j.wave->gen_waves(j.sdef, j.fsamp, j.fbase, j.scale);
+            j.wave->save(j.path, j.sdef, j.fsamp, j.fbase, j.scale);
+            }
+      }
+
 //---------------------------------------------------------
 //   Divis
 //---------------------------------------------------------
@@ -419,16 +450,46 @@ void Model::init_ranks (int comm)
       _ready = false;
 //WS      send_event (TO_IFACE, new M_ifc_retune (_fbase, _itemp));
 
+      QList<RankJob> jobs;
       for (int g = 0; g < _ngroup; g++) {
             Group* G = _group + g;
             for (int i = 0; i < G->_nifelm; i++)
-                  proc_rank (g, i, comm);
+                  proc_rank (g, i, comm, &jobs);
             }
+      gen_ranks(jobs);
       _ready = true;
       }
 
+//---------------------------------------------------------
+//   gen_ranks
+//    load or generate the ranks on the global thread pool
+//    and install them
+//---------------------------------------------------------
+
+void Model::gen_ranks(QList<RankJob>& jobs)
+      {
+      if (jobs.size() > 1 && QThreadPool::globalInstance()->maxThreadCount() > 1)
+            QtConcurrent::blockingMap(jobs, loadRank);
+      else {
+            for (int i = 0; i < jobs.size(); ++i)
+                  loadRank(jobs[i]);
+            }
+      foreach(const RankJob& j, jobs) {
+            Rank* R = _divis [j.divis]._ranks + j.rank;
+            _aeolus->_divisp [j.divis]->set_rank (j.rank, j.wave, R->_sdef->_pan, R->_sdef->_del);
+            R->_wave = j.wave;
+            }
+      }
+
+
+//---------------------------------------------------------
+//   proc_rank
+//    save the rank or queue it for loading in jobs;
+//    without jobs the rank belongs to an edited stop and
+//    is generated immediately
+//---------------------------------------------------------
 
-void Model::proc_rank (int g, int i, int comm)
+void Model::proc_rank (int g, int i, int comm, QList<RankJob>* jobs)
       {
       Ifelm* I = _group [g]._ifelms + i;
       if ((I->_type == Ifelm::DIVRANK) || (I->_type == Ifelm::KBDRANK)) {
@@ -443,26 +504,26 @@ void Model::proc_rank (int g, int i, int comm)
                   }
             else if (R->_count != _count) {
                   R->_count = _count;
-                  M_def_rank* M = new M_def_rank (comm);
-                  M->_divis = d;
-                  M->_rank  = r;
-                  M->_group = g;
-                  M->_ifelm = i;
-                  M->_fsamp = _aeolus->_fsamp;
-                  M->_fbase = _fbase;
-                  M->_scale = scales [_itemp]._data;
-                  M->_sdef  = R->_sdef;
-                  M->_wave  = R->_wave;
-                  M->_path  = _waves;
-
-//WS                  send_event(TO_IFACE, new M_ifc_ifelm (MT_IFC_ELATT, M->_group, M->_ifelm));
-
-                  M->_wave = new Rankwave (M->_sdef->_n0, M->_sdef->_n1);
-                  if (M->_wave->load (M->_path, M->_sdef, M->_fsamp, M->_fbase, M->_scale))
-                        M->_wave->gen_waves (M->_sdef, M->_fsamp, M->_fbase, M->_scale);
-
-                  _aeolus->_divisp [M->_divis]->set_rank (M->_rank, M->_wave,  M->_sdef->_pan, M->_sdef->_del);
-                  _divis [M->_divis]._ranks [M->_rank]._wave = M->_wave;
+                  RankJob j;
+                  j.divis = d;
+                  j.rank  = r;
+                  j.fsamp = _aeolus->_fsamp;
+                  j.fbase = _fbase;
+                  j.scale = scales [_itemp]._data;
+                  j.sdef  = R->_sdef;
+                  j.path  = _waves;
+                  j.edited = jobs == 0;
+                  j.wave  = new Rankwave (j.sdef->_n0, j.sdef->_n1);
+
+//WS                  send_event(TO_IFACE, new M_ifc_ifelm (MT_IFC_ELATT, g, i));
+
+                  if (jobs)
+                        jobs->append(j);
+                  else {
+                        QList<RankJob> jl;
+                        jl.append(j);
+                        gen_ranks(jl);
+                        }
                   }
             }
       }
@@ -27,6 +27,7 @@
 #include "global.h"
 
 class Aeolus;
+struct RankJob;
 
 class Asect
 {
@@ -170,7 +171,8 @@ class Model
       void init_audio();
       void init_iface();
       void init_ranks(int comm);
-      void proc_rank(int g, int i, int comm);
+      void proc_rank(int g, int i, int comm, QList<RankJob>* jobs = 0);
+      void gen_ranks(QList<RankJob>& jobs);
       void set_aupar(int s, int a, int p, float v);
       void set_dipar(int s, int d, int p, float v);
       void set_mconf(int i, uint16_t *d);
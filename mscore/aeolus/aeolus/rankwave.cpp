@@ -22,22 +22,11 @@
 
 extern float exp2ap (float);
 
+// Number of tunings of a stop for which the waveform files are kept.
+static const int WAVES_KEPT = 4;
 
-Rngen   Pipewave::_rgen;
-float  *Pipewave::_arg = 0;
-float  *Pipewave::_att = 0;
-
-
-void Pipewave::initstatic (float fsamp)
-{
-    int k;
 
-    if (_arg) return;
-    k = (int)(fsamp);
-    _arg = new float [k];
-    k = (int)(0.5f * fsamp);
-    _att = new float [k];
-}
+Rngen   Pipewave::_rgen;
 
 
 void Pipewave::play (void)
@@ -180,7 +169,7 @@ void Pipewave::play (void)
 }
 
 
-void Pipewave::genwave (Addsynth *D, int n, float fsamp, float fpipe)
+void Pipewave::genwave (Addsynth *D, int n, float fsamp, float fpipe, Rngen *R, float *arg, float *att)
 {
     int    h, i, k, nc;
     float  f0, f1, f, m, t, v, v0;
@@ -194,7 +183,7 @@ void Pipewave::genwave (Addsynth *D, int n, float fsamp, float fpipe)
     _l0 = (int)(fsamp * m + 0.5);
     _l0 = (_l0 + PERIOD - 1) & ~(PERIOD - 1);
 
-    f1 = (fpipe + D->_n_off.vi (n) + D->_n_ran.vi (n) * (2 * _rgen.urand () - 1)) / fsamp;
+    f1 = (fpipe + D->_n_off.vi (n) + D->_n_ran.vi (n) * (2 * R->urand () - 1)) / fsamp;
     f0 = f1 * exp2ap (D->_n_atd.vi (n) / 1200.0f);
 
     for (h = N_HARM - 1; h >= 0; h--)
@@ -231,14 +220,14 @@ void Pipewave::genwave (Addsynth *D, int n, float fsamp, float fpipe)
     k = (int)(fsamp * D->_n_att.vi (n) + 0.5);
     for (i = 0; i <= _l0; i++)
     {
-        _arg [i] = t - floorf (t + 0.5);
+        arg [i] = t - floorf (t + 0.5);
 	t += (i < k) ? (((k - i) * f0 + i * f1) / k) : f1;
     }
 
     for (i = 1; i < _l1; i++)
     {
-	t = _arg [_l0]+ (float) i * nc / _l1;
-        _arg [i + _l0] = t - floorf (t + 0.5);
+	t = arg [_l0]+ (float) i * nc / _l1;
+        arg [i + _l0] = t - floorf (t + 0.5);
     }
 
     v0 = exp2ap (0.1661 * D->_n_vol.vi (n));
@@ -248,16 +237,16 @@ void Pipewave::genwave (Addsynth *D, int n, float fsamp, float fpipe)
         v = D->_h_lev.vi (h, n);
         if (v < -80.0) continue;
 
-        v = v0 * exp2ap (0.1661 * (v + D->_h_ran.vi (h, n) * (2 * _rgen.urand () - 1)));
+        v = v0 * exp2ap (0.1661 * (v + D->_h_ran.vi (h, n) * (2 * R->urand () - 1)));
         k = (int)(fsamp * D->_h_att.vi (h, n) + 0.5);
-        attgain (k, D->_h_atp.vi (h, n));
+        attgain (att, k, D->_h_atp.vi (h, n));
 
         for (i = 0; i < _l0 + _l1; i++)
         {
-	    t = _arg [i] * (h + 1);
+	    t = arg [i] * (h + 1);
             t -= floorf (t);
             m = v * sinf (2 * M_PI * t);
-            if (i < k) m *= _att [i];
+            if (i < k) m *= att [i];
             _p0 [i] += m;
         }
     }
@@ -308,7 +297,7 @@ void Pipewave::looplen (float f, float fsamp, int lmax, int *aa, int *bb)
 }
 
 
-void Pipewave::attgain (int n, float p)
+void Pipewave::attgain (float *att, int n, float p)
 {
     int    i, j, k;
     float  d, m, w, x, y, z;
@@ -328,7 +317,7 @@ void Pipewave::attgain (int n, float p)
         while (j < k)
 	{
             m = (double) j / n;
-            _att [j++] = (1.0 - m) * z + m;
+            att [j++] = (1.0 - m) * z + m;
             z += d;
 	}
     }
@@ -360,9 +349,13 @@ void Pipewave::save (FILE *F)
 }
 
 
-void Pipewave::load (FILE *F)
+int Pipewave::load (const char *data, int size, bool map)
 {
-    int  k;
+    // Set up the pipe from waveform file data. If map is set the
+    // wave is used in place. Returns the number of bytes used, or
+    // zero if the data is invalid.
+
+    int  k, n;
     union
     {
         int16_t i16 [16];
@@ -370,24 +363,33 @@ void Pipewave::load (FILE *F)
 	float   flt [8];
     } d;
 
-    fread (&d, 1, 32, F);
+    if (size < 32) return 0;
+    memcpy (&d, data, 32);
     _l0  = d.i32 [0];
     _l1  = d.i32 [1];
     _k_s = d.i16 [4];
     _k_r = d.i16 [5];
     _m_r = d.flt [3];
+    if ((_l0 < 0) || (_l1 <= 0) || (_k_s < 1) || (_k_s > 3)) return 0;
     k = _l0 +_l1 + _k_s * (PERIOD + 4);
-    delete[] _p0;
-    _p0 = new float [k];
+    if (k > (size - 32) / (int) sizeof (float)) return 0;
+    n = 32 + k * sizeof (float);
+    if (map) _p0 = (float *)(data + 32);
+    else
+    {
+        delete[] _p0;
+        _p0 = new float [k];
+        memcpy (_p0, data + 32, k * sizeof (float));
+    }
     _p1 = _p0 + _l0;
     _p2 = _p1 + _l1;
-    fread (_p0, k, sizeof (float), F);
+    return n;
 }
 
 
 
 
-Rankwave::Rankwave (int n0, int n1) : _n0 (n0), _n1 (n1), _list (0), _modif (false)
+Rankwave::Rankwave (int n0, int n1) : _n0 (n0), _n1 (n1), _list (0), _modif (false), _file (0)
 {
     _pipes = new Pipewave [n1 - n0 + 1];
 }
@@ -395,23 +397,93 @@ Rankwave::Rankwave (int n0, int n1) : _n0 (n0), _n1 (n1), _list (0), _modif (fal
 
 Rankwave::~Rankwave (void)
 {
+    unmap ();
     delete[] _pipes;
 }
 
 
+void Rankwave::unmap (void)
+{
+    // Detach the pipes from a mapped waveform file.
+
+    if (! _file) return;
+    for (int i = _n0; i <= _n1; i++) _pipes [i - _n0]._p0 = 0;
+    delete _file;
+    _file = 0;
+}
+
+
 void Rankwave::gen_waves (Addsynth *D, float fsamp, float fbase, float *scale)
 {
-    Pipewave::initstatic (fsamp);
+    // The scratch buffers and the random generator are local,
+    // so that several ranks can be generated at the same time.
+    // The generator is seeded from the stop name to give each
+    // rank its own but repeatable random variations.
+
+    Rngen     R;
+    uint32_t  seed = 2166136261u;
+    float    *arg = new float [(int)(fsamp)];
+    float    *att = new float [(int)(0.5f * fsamp)];
 
+    for (const char *p = D->_filename; *p; p++) seed = (seed ^ (uint8_t)(*p)) * 16777619u;
+    R.init (seed ? seed : 1);
+
+    unmap ();
     fbase *=  D->_fn / (D->_fd * scale [9]);
     for (int i = _n0; i <= _n1; i++)
     {
-	_pipes [i - _n0].genwave (D, i - _n0, fsamp, ldexpf (fbase * scale [i % 12], i / 12 - 5));
+	_pipes [i - _n0].genwave (D, i - _n0, fsamp, ldexpf (fbase * scale [i % 12], i / 12 - 5), &R, arg, att);
     }
+    delete[] arg;
+    delete[] att;
     _modif = true;
 }
 
 
+void Rankwave::wavename (char *name, const char *path, Addsynth *D, float fsamp, float fbase, float *scale)
+{
+    // Waveform files are named after the stop and a hash of the
+    // sample frequency, tuning and temperament, so the waves of
+    // several tunings are kept side by side.
+
+    uint32_t  h = 2166136261u;
+    float     v [14];
+    char     *p;
+
+    v [0] = fsamp;
+    v [1] = fbase;
+    memcpy (v + 2, scale, 12 * sizeof (float));
+    for (unsigned int i = 0; i < sizeof (v); i++) h = (h ^ ((uint8_t *) v)[i]) * 16777619u;
+
+    sprintf (name, "%s/%s", path, D->_filename);
+    if ((p = strrchr (name, '.'))) sprintf (p, "-%08x.ae1", h);
+    else sprintf (name + strlen (name), "-%08x.ae1", h);
+}
+
+
+void Rankwave::prune (const char *name)
+{
+    // Remove the waveform files of all but the WAVES_KEPT most
+    // recently written tunings of the stop of file 'name', and the
+    // file written before the names had a hash. A file which is
+    // still mapped elsewhere stays valid on systems which allow to
+    // remove it, and is left alone on the others.
+
+    QFileInfo      fi (QString::fromLocal8Bit (name));
+    QString        stem = fi.fileName ();
+    QDir           dir (fi.absolutePath ());
+    QFileInfoList  list;
+
+    stem.chop (13);   // "-xxxxxxxx.ae1"
+    QFile::remove (dir.filePath (stem + ".ae1"));
+    list = dir.entryInfoList (QStringList (stem + "-????????.ae1"), QDir::Files, QDir::Time);
+    for (int i = WAVES_KEPT; i < list.size (); i++)
+    {
+        if (list [i].fileName () != fi.fileName ()) QFile::remove (list [i].absoluteFilePath ());
+    }
+}
+
+
 void Rankwave::set_param (float *out, int del, int pan)
 {
     int         n, a, b;
@@ -453,17 +525,18 @@ int Rankwave::save (const char *path, Addsynth *D, float fsamp, float fbase, flo
     Pipewave  *P;
     int        i;
     char       name [1024];
+    char       temp [1100];
     char       data [64];
-    char      *p;
 
-    sprintf (name, "%s/%s", path, D->_filename);
-    if ((p = strrchr (name, '.'))) strcpy (p, ".ae1");
-    else strcat (name, ".ae1");
+    // The file is written under a temporary name and renamed, as
+    // other ranks or instances may have the previous version mapped.
 
-    F = fopen (name, "wb");
+    wavename (name, path, D, fsamp, fbase, scale);
+    sprintf (temp, "%s.%lld.%p", name, (long long) QCoreApplication::applicationPid (), (void *) this);
+    F = fopen (temp, "wb");
     if (F == NULL)
     {
-	fprintf (stderr, "Can't open waveform file '%s' for writing\n", name);
+	fprintf (stderr, "Can't open waveform file '%s' for writing\n", temp);
         return 1;
     }
 
@@ -488,7 +561,20 @@ int Rankwave::save (const char *path, Addsynth *D, float fsamp, float fbase, flo
 
     for (i = _n0, P = _pipes; i <= _n1; i++, P++) P->save (F);
 
-    fclose (F);
+    if (fclose (F))
+    {
+	fprintf (stderr, "Can't write waveform file '%s'\n", temp);
+        QFile::remove (temp);
+        return 1;
+    }
+    QFile::remove (name);
+    if (! QFile::rename (temp, name))
+    {
+	fprintf (stderr, "Can't rename waveform file '%s'\n", temp);
+        QFile::remove (temp);
+        return 1;
+    }
+    prune (name);
 
     _modif = false;
     return 0;
@@ -497,34 +583,45 @@ int Rankwave::save (const char *path, Addsynth *D, float fsamp, float fbase, flo
 
 int Rankwave::load (const char *path, Addsynth *D, float fsamp, float fbase, float *scale)
 {
-    FILE      *F;
-    Pipewave  *P;
-    int        i;
-    char       name [1024];
-    char       data [64];
-    char      *p;
-    float      f;
-
-    sprintf (name, "%s/%s", path, D->_filename);
-    if ((p = strrchr (name, '.'))) strcpy (p, ".ae1");
-    else strcat (name, ".ae1");
+    // The waveform file is mapped and the pipes play from it
+    // directly; if the file can not be mapped it is read.
 
-    F = fopen (name, "rb");
-    if (F == NULL)
+    Pipewave   *P;
+    QByteArray  buf;
+    const char *data;
+    qint64      size;
+    int         i, n;
+    char        name [1024];
+    float       f;
+
+    wavename (name, path, D, fsamp, fbase, scale);
+    _file = new QFile (name);
+    if (! _file->open (QIODevice::ReadOnly))
     {
 #ifdef DEBUG
 	fprintf (stderr, "Can't open waveform file '%s' for reading\n", name);
 #endif
+        delete _file;
+        _file = 0;
         return 1;
     }
+    size = _file->size ();
+    data = (const char *)(_file->map (0, size));
+    if (! data)
+    {
+        buf = _file->readAll ();
+        data = buf.constData ();
+        size = buf.size ();
+        delete _file;
+        _file = 0;
+    }
 
-    fread (data, 1, 16, F);
-    if (strcmp (data, "ae1"))
+    if ((size < 80) || strcmp (data, "ae1"))
     {
 #ifdef DEBUG
 	fprintf (stderr, "File '%s' is not an Aeolus waveform file\n", name);
 #endif
-        fclose (F);
+        unmap ();
         return 1;
     }
 
@@ -533,56 +630,70 @@ int Rankwave::load (const char *path, Addsynth *D, float fsamp, float fbase, flo
 #ifdef DEBUG
 	fprintf (stderr, "File '%s' has an incompatible version tag (%d)\n", name, data [4]);
 #endif
-        fclose (F);
+        unmap ();
         return 1;
     }
 
-    fread (data, 1, 64, F);
+    data += 16;
+    size -= 16;
     if (_n0 != data [4] || _n1 != data [5])
     {
 #ifdef DEBUG
 	fprintf (stderr, "File '%s' has an incompatible note range (%d %d), (%d %d)\n", name, _n0, _n1, data [4], data [5]);
 #endif
-        fclose (F);
+        unmap ();
         return 1;
     }
 
-    f = *((float *)(data + 8));
+    memcpy (&f, data + 8, sizeof (float));
     if (fabsf (f - fsamp) > 0.1f)
     {
 #ifdef DEBUG
 	fprintf (stderr, "File '%s' has a different sample frequency (%3.1lf)\n", name, f);
 #endif
-        fclose (F);
+        unmap ();
         return 1;
     }
 
-    f = *((float *)(data + 12));
+    memcpy (&f, data + 12, sizeof (float));
     if (fabsf (f - fbase) > 0.1f)
     {
 #ifdef DEBUG
 	fprintf (stderr, "File '%s' has a different tuning (%3.1lf)\n", name, f);
 #endif
-        fclose (F);
+        unmap ();
         return 1;
     }
 
     for (i = 0; i < 12; i++)
     {
-        f = *((float *)(data + 16 + 4 * i));
+        memcpy (&f, data + 16 + 4 * i, sizeof (float));
         if (fabsf (f /  scale [i] - 1.0f) > 6e-5f)
         {
 #ifdef DEBUG
 	    fprintf (stderr, "File '%s' has a different temperament\n", name);
 #endif
-            fclose (F);
+            unmap ();
             return 1;
         }
     }
 
-    for (i = _n0, P = _pipes; i <= _n1; i++, P++) P->load (F);
-
-    fclose (F);
+    data += 64;
+    size -= 64;
+    for (i = _n0, P = _pipes; i <= _n1; i++, P++)
+    {
+        n = P->load (data, (int) qMin (size, qint64 (INT_MAX)), _file != 0);
+        if (! n)
+        {
+#ifdef DEBUG
+	    fprintf (stderr, "File '%s' is truncated\n", name);
+#endif
+            unmap ();
+            return 1;
+        }
+        data += n;
+        size -= n;
+    }
 
     _modif = false;
     return 0;
@@ -42,13 +42,13 @@ private:
 
     friend class Rankwave;
 
-    void genwave (Addsynth *D, int n, float fsamp, float fpipe);
+    void genwave (Addsynth *D, int n, float fsamp, float fpipe, Rngen *R, float *arg, float *att);
     void save (FILE *F);
-    void load (FILE *F);
+    int  load (const char *data, int size, bool map);
     void play (void);
 
     static void looplen (float f, float fsamp, int lmax, int *aa, int *bb);
-    static void attgain (int n, float p);
+    static void attgain (float *att, int n, float p);
 
     float     *_p0;    // attack start
     float     *_p1;    // loop start
@@ -74,11 +74,7 @@ private:
     int16_t    _i_r;   // release count
 
 
-    static void initstatic (float fsamp);
-
     static   Rngen   _rgen;
-    static   float  *_arg;
-    static   float  *_att;
 };
 
 
@@ -133,12 +129,17 @@ private:
     Rankwave (const Rankwave&);
     Rankwave& operator=(const Rankwave&);
 
+    void unmap (void);
+    static void wavename (char *name, const char *path, Addsynth *D, float fsamp, float fbase, float *scale);
+    static void prune (const char *name);
+
     int         _n0;
     int         _n1;
     uint32_t    _sbit;
     Pipewave   *_list;
     Pipewave   *_pipes;
     bool        _modif;
+    QFile      *_file;   // mapped waveform file the pipes point into
 };
 
 
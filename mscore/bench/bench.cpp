@@ -0,0 +1,454 @@
+//=============================================================================
+//  MuseScore
+//  Music Composition & Notation
+//  $Id:$
+//
+//  Copyright (C) 2011 Werner Schweer and others
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2
+//  as published by the Free Software Foundation and appearing in
+//  the file LICENSE.GPL
+//=============================================================================
+
+//
+//    mscorebench
+//       headless benchmark for layout, edit, midi rendering,
+//       save and binary snapshots over a set of score files;
+//       prints one json record per score to stdout
+//
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "libmscore/mscore.h"
+#include "libmscore/score.h"
+#include "libmscore/staff.h"
+#include "libmscore/measure.h"
+#include "libmscore/segment.h"
+#include "libmscore/chord.h"
+#include "libmscore/note.h"
+#include "libmscore/keysig.h"
+#include "libmscore/page.h"
+#include "libmscore/event.h"
+#include "libmscore/undo.h"
+#include "libmscore/utils.h"
+#include "libmscore/pool.h"
+#include "libmscore/system.h"
+#include "libmscore/bsp.h"
+#include "omr/omr.h"
+#include "oldbsp.h"
+
+bool debugMode = false;
+QString revision;
+
+// dummies:
+
+#ifdef OMR
+Omr::Omr(Score*) {}
+void Omr::write(Xml&) const {}
+void Omr::read(QDomElement) {}
+#endif
+
+//---------------------------------------------------------
+//   BenchResult
+//    all times in milliseconds
+//---------------------------------------------------------
+
+struct BenchResult {
+      double load;
+      double layoutMin;
+      double layoutAvg;
+      double edit;
+      double undo;
+      double midi;
+      int events;
+      double save;
+      int saveBytes;
+      double xmlRead;
+      double snapSave;
+      double snapRead;
+      int snapBytes;
+      bool snapEqual;
+      double bspRebuild;
+      double bspQuery;
+      double bspOldRebuild;
+      double bspOldQuery;
+      int bspItems;
+      int bspFound;           // point query hits
+      int bspOldFound;
+      int pages;
+      qint64 allocs;
+      qint64 poolBytes;
+      long peakRss;           // kbyte
+      };
+
+//---------------------------------------------------------
+//   peakRss
+//---------------------------------------------------------
+
+static long peakRss()
+      {
+      struct rusage ru;
+      if (getrusage(RUSAGE_SELF, &ru))
+            return 0;
+      return ru.ru_maxrss;
+      }
+
+//---------------------------------------------------------
+//   usage
+//---------------------------------------------------------
+
+static void usage(const char* prog)
+      {
+      fprintf(stderr, "%s: usage: %s [-n count] file|directory...\n", prog, prog);
+      fprintf(stderr, "   -n count  layout iterations per score (default 5)\n");
+      fprintf(stderr, "   reads *.mscx and *.mscz files; needs a display\n"
+                      "   (use xvfb-run on a headless machine)\n");
+      }
+
+//---------------------------------------------------------
+//   readScore
+//    load score like MuseScore::readScore() but without
+//    the importers and the final layout
+//---------------------------------------------------------
+
+static bool readScore(Score* score, const QString& name)
+      {
+      QString csl = score->fileInfo()->suffix().toLower();
+      if (csl == "mscz") {
+            if (!score->loadCompressedMsc(name))
+                  return false;
+            }
+      else if (!score->loadMsc(name))
+            return false;
+      score->connectTies();
+      score->rebuildMidiMapping();
+      score->setCreated(false);
+      score->setSaved(false);
+
+      int staffIdx = 0;
+      foreach(Staff* st, score->staves()) {
+            if (st->updateKeymap())
+                  st->keymap()->clear();
+            int track = staffIdx * VOICES;
+            KeySig* key1 = 0;
+            for (Measure* m = score->firstMeasure(); m; m = m->nextMeasure()) {
+                  for (Segment* s = m->first(); s; s = s->next()) {
+                        Element* e = s->element(track);
+                        if (!e || e->generated())
+                              continue;
+                        if ((s->subtype() == SegKeySig) && st->updateKeymap()) {
+                              KeySig* ks = static_cast<KeySig*>(e);
+                              int naturals = key1 ? key1->keySigEvent().accidentalType() : 0;
+                              ks->setOldSig(naturals);
+                              st->setKey(s->tick(), ks->keySigEvent());
+                              key1 = ks;
+                              }
+                        }
+                  if (m->sectionBreak())
+                        key1 = 0;
+                  }
+            st->setUpdateKeymap(false);
+            ++staffIdx;
+            }
+      score->updateNotes();
+      return true;
+      }
+
+//---------------------------------------------------------
+//   firstNote
+//    the note to change in the edit benchmark; take it
+//    from the middle of the score to avoid measuring the
+//    cheap case of a relayout at the very beginning
+//---------------------------------------------------------
+
+static Note* firstNote(Score* score)
+      {
+      QList<Note*> notes;
+      for (Segment* s = score->firstSegment(SegChordRest); s; s = s->next1(SegChordRest)) {
+            Element* e = s->element(0);
+            if (e && e->type() == CHORD)
+                  notes.append(static_cast<Chord*>(e)->upNote());
+            }
+      return notes.isEmpty() ? 0 : notes[notes.size() / 2];
+      }
+
+//---------------------------------------------------------
+//   resetDiscovered
+//    callers of the old tree have to reset itemDiscovered
+//    after rectangle queries; this is part of its cost
+//---------------------------------------------------------
+
+static void resetDiscovered(BspTree*, const QList<const Element*>&)
+      {
+      }
+
+static void resetDiscovered(OldBspTree*, const QList<const Element*>& l)
+      {
+      foreach(const Element* e, l)
+            e->itemDiscovered = 0;
+      }
+
+//---------------------------------------------------------
+//   bspQuery
+//    query a 32x32 grid of rectangles and their center
+//    points of page rectangle bb; returns the time in ms
+//    and adds the number of point hits to found
+//---------------------------------------------------------
+
+template <class T>
+static double bspQuery(T* tree, const QRectF& bb, int* found)
+      {
+      double t = curTime();
+      qreal w = bb.width() / 32.0;
+      qreal h = bb.height() / 32.0;
+      for (int y = 0; y < 32; ++y) {
+            for (int x = 0; x < 32; ++x) {
+                  QRectF r(bb.x() + x * w, bb.y() + y * h, w, h);
+                  resetDiscovered(tree, tree->items(r));
+                  *found += tree->items(r.center()).size();
+                  }
+            }
+      return (curTime() - t) * 1000.0;
+      }
+
+//---------------------------------------------------------
+//   benchScore
+//---------------------------------------------------------
+
+static bool benchScore(const QString& path, int iterations, BenchResult* r)
+      {
+      memset(r, 0, sizeof(BenchResult));
+      qint64 allocs = ElementPool::allocations();
+
+      double t = curTime();
+      Score* score = new Score(MScore::defaultStyle());
+      score->setName(path);
+      if (!readScore(score, path)) {
+            delete score;
+            return false;
+            }
+      score->doLayout();
+      r->load = (curTime() - t) * 1000.0;
+
+      //
+      // full layout
+      //
+      double sum = 0.0;
+      for (int i = 0; i < iterations; ++i) {
+            t = curTime();
+            score->doLayout();
+            double d = (curTime() - t) * 1000.0;
+            sum += d;
+            if (i == 0 || d < r->layoutMin)
+                  r->layoutMin = d;
+            }
+      r->layoutAvg = iterations ? sum / iterations : 0.0;
+
+      //
+      // single note edit and its undo, both with
+      // incremental layout of the changed measure
+      //
+      Note* note = firstNote(score);
+      if (note) {
+            Measure* m = note->chord()->measure();
+            score->select(note, SELECT_SINGLE, 0);
+            t = curTime();
+            score->startCmd();
+            score->upDown(true, UP_DOWN_CHROMATIC);
+            score->setLayoutAll(false);
+            score->setLayout(m);
+            score->endCmd();
+            score->end();
+            r->edit = (curTime() - t) * 1000.0;
+
+            t = curTime();
+            score->undo()->undo();
+            score->setLayoutAll(false);
+            score->setLayout(m);
+            score->end();
+            r->undo = (curTime() - t) * 1000.0;
+            }
+
+      //
+      // midi rendering
+      //
+      t = curTime();
+      EventMap events;
+      score->toEList(&events);
+      r->midi   = (curTime() - t) * 1000.0;
+      r->events = events.size();
+
+      //
+      // save into memory
+      //
+      QBuffer buffer;
+      buffer.open(QIODevice::WriteOnly);
+      t = curTime();
+      score->saveFile(&buffer, false);
+      r->save      = (curTime() - t) * 1000.0;
+      r->saveBytes = buffer.size();
+
+      //
+      // shape tree: rebuild and query every page with a
+      // grid of small rectangles and points, like mouse hit
+      // testing; the old and the new tree get the same
+      // elements and the same queries
+      //
+      r->pages = score->pages().size();
+      foreach(Page* page, score->pages()) {
+            QList<Element*> el;
+            foreach(System* s, *page->systems()) {
+                  foreach(MeasureBase* m, s->measures())
+                        m->scanElements(&el, collectElements, false);
+                  s->scanElements(&el, collectElements, false);
+                  }
+            el.append(page);
+            r->bspItems += el.size();
+            QRectF bb(page->abbox());
+
+            t = curTime();
+            BspTree tree;
+            tree.initialize(bb, el.size());
+            foreach(Element* e, el)
+                  tree.insert(e);
+            tree.pack();
+            r->bspRebuild += (curTime() - t) * 1000.0;
+
+            t = curTime();
+            OldBspTree oldTree;
+            oldTree.initialize(bb, el.size());
+            foreach(Element* e, el)
+                  oldTree.insert(e);
+            r->bspOldRebuild += (curTime() - t) * 1000.0;
+
+            r->bspQuery    += bspQuery(&tree, bb, &r->bspFound);
+            r->bspOldQuery += bspQuery(&oldTree, bb, &r->bspOldFound);
+            }
+
+      r->allocs    = ElementPool::allocations() - allocs;
+      r->poolBytes = ElementPool::bytesInUse();
+      r->peakRss   = peakRss();
+
+      //
+      // binary snapshot against xml: read the saved xml and
+      // the snapshot into new scores; both must save the
+      // same xml. Runs last so it does not count in allocs
+      // and peak rss.
+      //
+      t = curTime();
+      QByteArray snap = score->snapshot();
+      r->snapSave  = (curTime() - t) * 1000.0;
+      r->snapBytes = snap.size();
+
+      buffer.close();
+      buffer.open(QIODevice::ReadOnly);
+      Score* xmlScore = new Score(MScore::defaultStyle());
+      t = curTime();
+      bool xmlOk = xmlScore->read1(&buffer);
+      r->xmlRead = (curTime() - t) * 1000.0;
+
+      Score* snapScore = new Score(MScore::defaultStyle());
+      t = curTime();
+      bool snapOk = snapScore->readSnapshot(snap);
+      r->snapRead = (curTime() - t) * 1000.0;
+
+      if (xmlOk && snapOk) {
+            QBuffer b1, b2;
+            b1.open(QIODevice::WriteOnly);
+            b2.open(QIODevice::WriteOnly);
+            xmlScore->saveFile(&b1, false);
+            snapScore->saveFile(&b2, false);
+            r->snapEqual = b1.data() == b2.data();
+            }
+      delete xmlScore;
+      delete snapScore;
+      delete score;
+      return true;
+      }
+
+//---------------------------------------------------------
+//   printResult
+//---------------------------------------------------------
+
+static void printResult(const QString& path, const BenchResult& r)
+      {
+      QString name(path);
+      name.replace("\\", "\\\\");
+      name.replace("\"", "\\\"");
+      printf("{\"score\":\"%s\",\"load_ms\":%.3f,\"layout_min_ms\":%.3f,\"layout_avg_ms\":%.3f,"
+         "\"edit_ms\":%.3f,\"undo_ms\":%.3f,\"midi_ms\":%.3f,\"events\":%d,"
+         "\"save_ms\":%.3f,\"save_bytes\":%d,\"xml_read_ms\":%.3f,"
+         "\"snapshot_save_ms\":%.3f,\"snapshot_read_ms\":%.3f,\"snapshot_bytes\":%d,\"snapshot_equal\":%s,"
+         "\"pages\":%d,\"bsp_items\":%d,\"bsp_rebuild_ms\":%.3f,\"bsp_query_ms\":%.3f,"
+         "\"bsp_old_rebuild_ms\":%.3f,\"bsp_old_query_ms\":%.3f,\"bsp_equal\":%s,"
+         "\"allocs\":%lld,\"pool_bytes\":%lld,\"peak_rss_kb\":%ld}\n",
+         qPrintable(name), r.load, r.layoutMin, r.layoutAvg,
+         r.edit, r.undo, r.midi, r.events,
+         r.save, r.saveBytes, r.xmlRead,
+         r.snapSave, r.snapRead, r.snapBytes, r.snapEqual ? "true" : "false",
+         r.pages, r.bspItems, r.bspRebuild, r.bspQuery,
+         r.bspOldRebuild, r.bspOldQuery, r.bspFound == r.bspOldFound ? "true" : "false",
+         r.allocs, r.poolBytes, r.peakRss);
+      fflush(stdout);
+      }
+
+//---------------------------------------------------------
+//   main
+//---------------------------------------------------------
+
+int main(int argc, char* argv[])
+      {
+      QApplication app(argc, argv);
+
+      int iterations = 5;
+      QStringList files;
+      QStringList args = app.arguments();
+      args.removeFirst();
+      for (int i = 0; i < args.size(); ++i) {
+            QString a = args[i];
+            if (a == "-n" && i + 1 < args.size())
+                  iterations = args[++i].toInt();
+            else if (a == "-h" || a == "--help") {
+                  usage(argv[0]);
+                  return 0;
+                  }
+            else {
+                  QFileInfo fi(a);
+                  if (fi.isDir()) {
+                        QDir dir(a);
+                        QStringList filter;
+                        filter << "*.mscx" << "*.mscz";
+                        foreach(QFileInfo f, dir.entryInfoList(filter, QDir::Files, QDir::Name))
+                              files.append(f.filePath());
+                        }
+                  else
+                        files.append(a);
+                  }
+            }
+      if (files.isEmpty()) {
+            usage(argv[0]);
+            return -1;
+            }
+
+      QWidget wi(0);
+      PDPI = wi.logicalDpiX();    // physical resolution
+      DPI  = PDPI;                // logical drawing resolution
+      DPMM = DPI / INCH;          // dots/mm
+
+      MScore::init();
+
+      int rv = 0;
+      foreach(const QString& path, files) {
+            BenchResult r;
+            if (!benchScore(path, iterations, &r)) {
+                  fprintf(stderr, "mscorebench: cannot load <%s>\n", qPrintable(path));
+                  rv = -1;
+                  continue;
+                  }
+            printResult(path, r);
+            }
+      return rv;
+      }
@@ -0,0 +1,169 @@
+//=============================================================================
+//  MuseScore
+//  Music Composition & Notation
+//  $Id:$
+//
+//  Copyright (C) 2011 Werner Schweer and others
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2
+//  as published by the Free Software Foundation and appearing in
+//  the file LICENSE.GPL
+//=============================================================================
+
+//
+//    fluiddsptest
+//       compare the dsp kernels selected by initDspKernels()
+//       against the scalar kernels on random data; exits
+//       with 1 if any result is off by more than the
+//       tolerance
+//
+
+#include <stdio.h>
+
+#include "fluid/fluid.h"
+#include "fluid/voice.h"
+#include "fluid/simd.h"
+
+using namespace FluidS;
+
+bool debugMode = false;
+
+static const unsigned N   = 1021;         // odd to test the tails
+static const unsigned LEN = 4 * N;
+
+static unsigned seed = 12345;
+static int errors    = 0;
+
+//---------------------------------------------------------
+//   rnd
+//    -1.0 - 1.0
+//---------------------------------------------------------
+
+static float rnd()
+      {
+      seed = seed * 1103515245 + 12345;
+      return float(int(seed >> 8) - 0x800000) / float(0x800000);
+      }
+
+//---------------------------------------------------------
+//   check
+//    |a - b| <= tol * scale
+//---------------------------------------------------------
+
+static void check(const char* test, unsigned i, float a, float b, float tol, float scale)
+      {
+      if (qAbs(a - b) <= tol * scale)
+            return;
+      if (errors++ < 10)
+            printf("%s: %s: index %u: scalar %g, %s %g\n", test, dspKernels.name, i, a, dspKernels.name, b);
+      }
+
+//---------------------------------------------------------
+//   testInterpolate
+//---------------------------------------------------------
+
+static void testInterpolate(int order, const short* data, double incrValue, unsigned start)
+      {
+      const char* test = order == 4 ? "interpolate4" : "interpolate7";
+      float a[N], b[N];
+      for (unsigned i = 0; i < N; ++i)
+            a[i] = b[i] = 0.0;
+
+      Phase p1, p2, incr;
+      p1.setFloat(4.123);
+      p2.setFloat(4.123);
+      incr.setFloat(incrValue);
+      float amp1       = 0.7f;
+      float amp2       = 0.7f;
+      float ampIncr    = -1e-4f;
+      unsigned endIndex = LEN - 8;
+      unsigned n1, n2;
+      if (order == 4) {
+            n1 = scalarDspKernels.interpolate4(a, start, N, data, p1, incr, amp1, ampIncr, endIndex);
+            n2 = dspKernels.interpolate4(b, start, N, data, p2, incr, amp2, ampIncr, endIndex);
+            }
+      else {
+            n1 = scalarDspKernels.interpolate7(a, start, N, data, p1, incr, amp1, ampIncr, endIndex);
+            n2 = dspKernels.interpolate7(b, start, N, data, p2, incr, amp2, ampIncr, endIndex);
+            }
+      if (n1 != n2 || p1.data != p2.data) {
+            printf("%s: %s: incr %g: end mismatch: scalar %u, %s %u\n",
+               test, dspKernels.name, incrValue, n1, dspKernels.name, n2);
+            ++errors;
+            }
+      check(test, n1, amp1, amp2, 1e-5, 1.0);
+      // float sums in another order; relative to full scale
+      for (unsigned i = 0; i < N; ++i)
+            check(test, i, a[i], b[i], 1e-5, 32768.0);
+      }
+
+//---------------------------------------------------------
+//   testMix
+//---------------------------------------------------------
+
+static void testMix(unsigned n)
+      {
+      float src[N], a[N], b[N];
+      for (unsigned i = 0; i < N; ++i) {
+            src[i] = rnd();
+            a[i]   = b[i] = rnd();
+            }
+      float gain = rnd();
+      scalarDspKernels.mix(a, src, gain, n);
+      dspKernels.mix(b, src, gain, n);
+      for (unsigned i = 0; i < N; ++i)
+            check("mix", i, a[i], b[i], 1e-6, 1.0);
+      }
+
+//---------------------------------------------------------
+//   testMix2
+//---------------------------------------------------------
+
+static void testMix2(unsigned n)
+      {
+      float src[N], a1[N], a2[N], b1[N], b2[N];
+      for (unsigned i = 0; i < N; ++i) {
+            src[i] = rnd();
+            a1[i]  = b1[i] = rnd();
+            a2[i]  = b2[i] = rnd();
+            }
+      float gain1 = rnd();
+      float gain2 = rnd();
+      scalarDspKernels.mix2(a1, gain1, a2, gain2, src, n);
+      dspKernels.mix2(b1, gain1, b2, gain2, src, n);
+      for (unsigned i = 0; i < N; ++i) {
+            check("mix2", i, a1[i], b1[i], 1e-6, 1.0);
+            check("mix2", i, a2[i], b2[i], 1e-6, 1.0);
+            }
+      }
+
+//---------------------------------------------------------
+//   main
+//---------------------------------------------------------
+
+int main(int, char*[])
+      {
+      Voice::dsp_float_config();
+      initDspKernels();
+
+      short* data = new short[LEN];
+      for (unsigned i = 0; i < LEN; ++i)
+            data[i] = short(rnd() * 32767.0);
+
+      static const double incr[] = { 0.25, 0.5, 1.0, 1.37, 2.9 };
+      for (unsigned k = 0; k < sizeof(incr)/sizeof(*incr); ++k) {
+            for (unsigned start = 0; start < 4; ++start) {
+                  testInterpolate(4, data, incr[k], start);
+                  testInterpolate(7, data, incr[k], start);
+                  }
+            }
+      for (unsigned n = N - 7; n <= N; ++n) {
+            testMix(n);
+            testMix2(n);
+            }
+      delete[] data;
+
+      printf("dsp kernels <%s>: %s\n", dspKernels.name, errors ? "FAILED" : "ok");
+      return errors ? 1 : 0;
+      }
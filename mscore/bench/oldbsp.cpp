@@ -0,0 +1,294 @@
+//=============================================================================
+//  MuseScore
+//  Music Composition & Notation
+//  $Id$
+//
+//  Copyright (C) 2007-2011 Werner Schweer
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2
+//  as published by the Free Software Foundation and appearing in
+//  the file LICENCE.GPL
+//
+//  This code is from Qt implementation of QGraphicsItem
+//    Copyright (C) 1992-2007 Trolltech ASA. All rights reserved.
+//=============================================================================
+
+#include "oldbsp.h"
+#include "libmscore/element.h"
+
+//---------------------------------------------------------
+//   OldInsertVisitor
+//---------------------------------------------------------
+
+class OldInsertVisitor : public OldBspTreeVisitor
+      {
+   public:
+      const Element* item;
+
+      inline void visit(QList<const Element*> *items) { items->prepend(item); }
+      };
+
+//---------------------------------------------------------
+//   OldRemoveVisitor
+//---------------------------------------------------------
+
+class OldRemoveVisitor : public OldBspTreeVisitor
+      {
+   public:
+      const Element* item;
+
+      inline void visit(QList<const Element*> *items) { items->removeAll(item); }
+      };
+
+//---------------------------------------------------------
+//   OldFindVisitor
+//---------------------------------------------------------
+
+class OldFindVisitor : public OldBspTreeVisitor
+      {
+   public:
+      QList<const Element*>* foundItems;
+
+      void visit(QList<const Element*>* items) {
+            for (int i = 0; i < items->size(); ++i) {
+                  const Element* item = items->at(i);
+                  if (!item->itemDiscovered) {
+                        item->itemDiscovered = 1;
+                        foundItems->prepend(item);
+                        }
+                  }
+            }
+      };
+
+//---------------------------------------------------------
+//   OldBspTree
+//---------------------------------------------------------
+
+OldBspTree::OldBspTree()
+   : leafCnt(0)
+      {
+      insertVisitor = new OldInsertVisitor;
+      removeVisitor = new OldRemoveVisitor;
+      findVisitor   = new OldFindVisitor;
+      depth = 0;
+      }
+
+OldBspTree::~OldBspTree()
+      {
+      delete insertVisitor;
+      delete removeVisitor;
+      delete findVisitor;
+      }
+
+//---------------------------------------------------------
+//   intmaxlog
+//---------------------------------------------------------
+
+static inline int intmaxlog(int n)
+      {
+      return (n > 0 ? qMax(int(::ceil(::log(qreal(n))/::log(qreal(2)))), 5) : 0);
+      }
+
+//---------------------------------------------------------
+//   initialize
+//---------------------------------------------------------
+
+void OldBspTree::initialize(const QRectF& rect, int n)
+      {
+      depth      = intmaxlog(n);
+      this->rect = rect;
+      leafCnt    = 0;
+
+      nodes.resize((1 << (depth+1)) - 1);
+      leaves.resize(1 << depth);
+      leaves.fill(QList<const Element*>());
+      initialize(rect, depth, 0);
+      }
+
+//---------------------------------------------------------
+//   clear
+//---------------------------------------------------------
+
+void OldBspTree::clear()
+      {
+      leafCnt = 0;
+      nodes.clear();
+      leaves.clear();
+      }
+
+//---------------------------------------------------------
+//   insert
+//---------------------------------------------------------
+
+void OldBspTree::insert(const Element* element)
+      {
+      insertVisitor->item = element;
+      climbTree(insertVisitor, element->abbox());
+      }
+
+//---------------------------------------------------------
+//   remove
+//---------------------------------------------------------
+
+void OldBspTree::remove(const Element* element)
+      {
+      removeVisitor->item = element;
+      climbTree(removeVisitor, element->abbox());
+      }
+
+//---------------------------------------------------------
+//   items
+//    like the old tree the caller has to reset
+//    itemDiscovered of the returned items
+//---------------------------------------------------------
+
+QList<const Element*> OldBspTree::items(const QRectF& rect)
+      {
+      QList<const Element*> tmp;
+      findVisitor->foundItems = &tmp;
+      climbTree(findVisitor, rect);
+      return tmp;
+      }
+
+//---------------------------------------------------------
+//   items
+//---------------------------------------------------------
+
+QList<const Element*> OldBspTree::items(const QPointF& pos)
+      {
+      QList<const Element*> tmp;
+      findVisitor->foundItems = &tmp;
+      climbTree(findVisitor, pos);
+
+      QList<const Element*> l;
+      for (int i = 0; i < tmp.size(); ++i) {
+            const Element* e = tmp.at(i);
+            e->itemDiscovered = 0;
+            if (e->contains(pos))
+                  l.append(e);
+            }
+      return l;
+      }
+
+//---------------------------------------------------------
+//   initialize
+//---------------------------------------------------------
+
+void OldBspTree::initialize(const QRectF& rect, int depth, int index)
+      {
+      Node* node = &nodes[index];
+      if (index == 0) {
+            node->type = Node::Horizontal;
+            node->offset = rect.center().x();
+            }
+
+      if (depth) {
+            Node::Type type;
+            QRectF rect1, rect2;
+            qreal offset1, offset2;
+
+            if (node->type == Node::Horizontal) {
+                  type = Node::Vertical;
+                  rect1.setRect(rect.left(), rect.top(), rect.width(), rect.height() * .5);
+                  rect2.setRect(rect1.left(), rect1.bottom(), rect1.width(), rect.height() - rect1.height());
+                  offset1 = rect1.center().x();
+                  offset2 = rect2.center().x();
+                  }
+            else {
+                  type = Node::Horizontal;
+                  rect1.setRect(rect.left(), rect.top(), rect.width() * .5, rect.height());
+                  rect2.setRect(rect1.right(), rect1.top(), rect.width() - rect1.width(), rect1.height());
+                  offset1 = rect1.center().y();
+                  offset2 = rect2.center().y();
+                  }
+
+            int childIndex = firstChildIndex(index);
+
+            Node* child   = &nodes[childIndex];
+            child->offset = offset1;
+            child->type   = type;
+
+            child = &nodes[childIndex + 1];
+            child->offset = offset2;
+            child->type   = type;
+
+            initialize(rect1, depth - 1, childIndex);
+            initialize(rect2, depth - 1, childIndex + 1);
+            }
+      else {
+            node->type      = Node::Leaf;
+            node->leafIndex = leafCnt++;
+            }
+      }
+
+//---------------------------------------------------------
+//   climbTree
+//---------------------------------------------------------
+
+void OldBspTree::climbTree(OldBspTreeVisitor* visitor, const QPointF& pos, int index)
+      {
+      if (nodes.isEmpty())
+            return;
+
+      Node* node = &nodes[index];
+      int childIndex = firstChildIndex(index);
+
+      switch (node->type) {
+            case Node::Leaf:
+                  visitor->visit(&leaves[node->leafIndex]);
+                  break;
+            case Node::Vertical:
+                  if (pos.x() < node->offset)
+                        climbTree(visitor, pos, childIndex);
+                  else
+                        climbTree(visitor, pos, childIndex + 1);
+                  break;
+            case Node::Horizontal:
+                  if (pos.y() < node->offset)
+                        climbTree(visitor, pos, childIndex);
+                  else
+                        climbTree(visitor, pos, childIndex + 1);
+                  break;
+            }
+      }
+
+//---------------------------------------------------------
+//   climbTree
+//---------------------------------------------------------
+
+void OldBspTree::climbTree(OldBspTreeVisitor* visitor, const QRectF& rect, int index)
+      {
+      if (nodes.isEmpty())
+            return;
+
+      Node* node = &nodes[index];
+      int childIndex = firstChildIndex(index);
+
+      switch (node->type) {
+            case Node::Leaf:
+                  visitor->visit(&leaves[node->leafIndex]);
+                  break;
+            case Node::Vertical:
+                  if (rect.left() < node->offset) {
+                        climbTree(visitor, rect, childIndex);
+                        if (rect.right() >= node->offset)
+                              climbTree(visitor, rect, childIndex + 1);
+                        }
+                  else {
+                        climbTree(visitor, rect, childIndex + 1);
+                        }
+                  break;
+            case Node::Horizontal:
+                  if (rect.top() < node->offset) {
+                        climbTree(visitor, rect, childIndex);
+                        if (rect.bottom() >= node->offset)
+                              climbTree(visitor, rect, childIndex + 1);
+                        }
+                  else {
+                        climbTree(visitor, rect, childIndex + 1);
+                        }
+                  break;
+            }
+      }
+
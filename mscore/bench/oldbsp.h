@@ -0,0 +1,88 @@
+//=============================================================================
+//  MuseScore
+//  Music Composition & Notation
+//  $Id$
+//
+//  Copyright (C) 2007-2011 Werner Schweer
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2
+//  as published by the Free Software Foundation and appearing in
+//  the file LICENCE.GPL
+//
+//  This code is from Qt implementation of QGraphicsItem
+//    Copyright (C) 1992-2007 Trolltech ASA. All rights reserved.
+//=============================================================================
+
+#ifndef __OLDBSP_H__
+#define __OLDBSP_H__
+
+class Element;
+class OldBspTreeVisitor;
+class OldInsertVisitor;
+class OldRemoveVisitor;
+class OldFindVisitor;
+
+//---------------------------------------------------------
+//   OldBspTree
+//    the BspTree before items were packed into flat
+//    arrays (one QList per leaf, duplicates filtered with
+//    Element::itemDiscovered); kept only to compare
+//    against libmscore/bsp.cpp in mscorebench
+//---------------------------------------------------------
+
+class OldBspTree
+      {
+   public:
+      struct Node {
+            enum Type { Horizontal, Vertical, Leaf };
+            union {
+                  qreal offset;
+                  int leafIndex;
+                  };
+            Type type;
+            };
+   private:
+      uint depth;
+      void initialize(const QRectF& rect, int depth, int index);
+      void climbTree(OldBspTreeVisitor* visitor, const QPointF& pos, int index = 0);
+      void climbTree(OldBspTreeVisitor* visitor, const QRectF& rect, int index = 0);
+
+      QVector<Node> nodes;
+      QVector<QList<const Element*> > leaves;
+      int leafCnt;
+      QRectF rect;
+
+      OldInsertVisitor* insertVisitor;
+      OldRemoveVisitor* removeVisitor;
+      OldFindVisitor* findVisitor;
+
+   public:
+      OldBspTree();
+      ~OldBspTree();
+
+      void initialize(const QRectF& rect, int depth);
+      void clear();
+
+      void insert(const Element* item);
+      void remove(const Element* item);
+
+      QList<const Element*> items(const QRectF& rect);
+      QList<const Element*> items(const QPointF& pos);
+
+      inline int firstChildIndex(int index) const { return index * 2 + 1; }
+      };
+
+//---------------------------------------------------------
+//   OldBspTreeVisitor
+//---------------------------------------------------------
+
+class OldBspTreeVisitor
+      {
+   public:
+      virtual ~OldBspTreeVisitor() {}
+      virtual void visit(QList<const Element*>* items) = 0;
+      };
+
+#endif
+
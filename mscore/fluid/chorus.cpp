@@ -110,12 +110,12 @@ Chorus::Chorus(float sr)
                   if (fabs(i_shifted) < 0.000001) {
                         /* sinc(0) cannot be calculated straightforward (limit needed
                            for 0/0) */
-                        sinc_table[i][ii] = (float)1.;
+                        sinc_table[ii][i] = (float)1.;
                         }
                   else {
-                        sinc_table[i][ii] = (float)sin(i_shifted * M_PI) / (M_PI * i_shifted);
+                        sinc_table[ii][i] = (float)sin(i_shifted * M_PI) / (M_PI * i_shifted);
                         /* Hamming window */
-                        sinc_table[i][ii] *= (float)0.5 * (1.0 + cos(2.0 * M_PI * i_shifted / (float)INTERPOLATION_SAMPLES));
+                        sinc_table[ii][i] *= (float)0.5 * (1.0 + cos(2.0 * M_PI * i_shifted / (float)INTERPOLATION_SAMPLES));
                         }
                   }
             }
@@ -199,55 +199,62 @@ void Chorus::update()
 
 void Chorus::process(int n, float* in, float* left_out, float* right_out)
       {
-      for (int sample_index = 0; sample_index < n; sample_index++) {
-            float d_in = in[sample_index];
-            float d_out = 0.0f;
+      while (n) {
+            int m = qMin(n, CHORUS_BLOCK);
 
-            /* Write the current sample into the circular buffer */
-            chorusbuf[counter] = d_in;
+            /* Write the input into the circular buffer */
+            for (int k = 0; k < m; k++) {
+                  chorusbuf[(counter + k) & MAX_SAMPLES_ANDMASK] = in[k];
+                  outbuf[k] = 0.0f;
+                  }
 
             for (int i = 0; i < number_blocks; i++) {
-                  /* Calculate the delay in subsamples for the delay line of chorus block nr. */
-
-                  /* The value in the lookup table is so, that this expression
-                   * will always be positive.  It will always include a number of
-                   * full periods of MAX_SAMPLES*INTERPOLATION_SUBSAMPLES to
-                   * remain positive at all times.
-                   */
-                  int pos_subsamples = (INTERPOLATION_SUBSAMPLES * counter
-                     - lookup_tab[phase[i]]);
-
-                  int pos_samples = pos_subsamples/INTERPOLATION_SUBSAMPLES;
+                  long ph = phase[i];
+                  for (int k = 0; k < m; k++) {
+                        /* Calculate the delay in subsamples for the delay line of chorus block nr. */
+
+                        /* The value in the lookup table is so, that this expression
+                         * will always be positive.  It will always include a number of
+                         * full periods of MAX_SAMPLES*INTERPOLATION_SUBSAMPLES to
+                         * remain positive at all times.
+                         */
+                        int pos_subsamples = (INTERPOLATION_SUBSAMPLES * ((counter + k) & MAX_SAMPLES_ANDMASK)
+                           - lookup_tab[ph]);
 
-                  /* modulo divide by INTERPOLATION_SUBSAMPLES */
-                  pos_subsamples &= INTERPOLATION_SUBSAMPLES_ANDMASK;
+                        int pos_samples = pos_subsamples/INTERPOLATION_SUBSAMPLES;
 
-                  for (int ii = 0; ii < INTERPOLATION_SAMPLES; ii++) {
-	                  /* Add the delayed signal to the chorus sum d_out Note: The
-	                   * delay in the delay line moves backwards for increasing
-	                   * delay!*/
+                        /* modulo divide by INTERPOLATION_SUBSAMPLES */
+                        const float* sinc = sinc_table[pos_subsamples & INTERPOLATION_SUBSAMPLES_ANDMASK];
 
-	                  /* The & in chorusbuf[...] is equivalent to a division modulo
-	                     MAX_SAMPLES, only faster.
+                        /* Add the delayed signal to the chorus sum. Note: The
+                         * delay in the delay line moves backwards for increasing
+                         * delay!
                          */
-                        d_out += (chorusbuf[pos_samples & MAX_SAMPLES_ANDMASK]
-                           * sinc_table[ii][pos_subsamples]);
-                        pos_samples--;
+                        float d_out = 0.0f;
+                        for (int ii = 0; ii < INTERPOLATION_SAMPLES; ii++)
+                              d_out += chorusbuf[(pos_samples - ii) & MAX_SAMPLES_ANDMASK] * sinc[ii];
+                        outbuf[k] += d_out;
+
+                        /* Cycle the phase of the modulating LFO */
+                        if (++ph >= modulation_period_samples)
+                              ph = 0;
                         }
-                  /* Cycle the phase of the modulating LFO */
-                  phase[i]++;
-                  phase[i] %= (modulation_period_samples);
+                  phase[i] = ph;
                   } /* foreach chorus block */
 
-            d_out *= level;
-
-            /* Add the chorus sum d_out to output */
-            left_out[sample_index]  += d_out;
-            right_out[sample_index] += d_out;
+            /* Add the chorus sum to output */
+            for (int k = 0; k < m; k++) {
+                  float d_out = outbuf[k] * level;
+                  left_out[k]  += d_out;
+                  right_out[k] += d_out;
+                  }
 
             /* Move forward in circular buffer */
-            counter++;
-            counter %= MAX_SAMPLES;
+            counter = (counter + m) & MAX_SAMPLES_ANDMASK;
+            in        += m;
+            left_out  += m;
+            right_out += m;
+            n         -= m;
             }
       }
 
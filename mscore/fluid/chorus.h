@@ -41,6 +41,12 @@ namespace FluidS {
 */
 #define INTERPOLATION_SAMPLES 5
 
+/* Frames processed per step; the input of a step is written into
+   the delay line before the delays are read, so this must be small
+   compared to the delay line length.
+*/
+#define CHORUS_BLOCK 64
+
 
 //---------------------------------------------------------
 //   Chorus
@@ -72,8 +78,9 @@ class Chorus {
       int* lookup_tab;
       float sample_rate;
 
-      /* sinc lookup table */
-      float sinc_table[INTERPOLATION_SAMPLES][INTERPOLATION_SUBSAMPLES];
+      /* sinc lookup table, the taps of a subsample offset are adjacent */
+      float sinc_table[INTERPOLATION_SUBSAMPLES][INTERPOLATION_SAMPLES];
+      float outbuf[CHORUS_BLOCK];
 
    public:
       Chorus(float sample_rate);
@@ -21,6 +21,7 @@
 #include "fluid.h"
 #include "voice.h"
 #include "sfont.h"
+#include "simd.h"
 
 namespace FluidS {
 
@@ -331,18 +332,9 @@ int Voice::dsp_float_interpolate_4th_order(unsigned n)
                   }
 
             /* interpolate the sequence of sample points */
-            for ( ; dsp_i < n && dsp_phase_index <= end_index; dsp_i++) {
-                  coeffs = interp_coeff[fluid_phase_fract_to_tablerow (phase)];
-                  dsp_buf[dsp_i] = amp * (coeffs[0] * dsp_data[dsp_phase_index-1]
-				  + coeffs[1] * dsp_data[dsp_phase_index]
-				  + coeffs[2] * dsp_data[dsp_phase_index+1]
-				  + coeffs[3] * dsp_data[dsp_phase_index+2]);
-
-                  /* increment phase and amplitude */
-                  phase += dsp_phase_incr;
-                  dsp_phase_index = phase.index();
-                  amp += dsp_amp_incr;
-                  }
+            dsp_i = dspKernels.interpolate4(dsp_buf, dsp_i, n, dsp_data,
+               phase, dsp_phase_incr, amp, dsp_amp_incr, end_index);
+            dsp_phase_index = phase.index();
 
             /* break out if buffer filled */
             if (dsp_i >= n)
@@ -529,22 +521,9 @@ int Voice::dsp_float_interpolate_7th_order(unsigned n)
             start_index -= 2;	/* set back to original start index */
 
             /* interpolate the sequence of sample points */
-            for ( ; dsp_i < n && dsp_phase_index <= end_index; dsp_i++) {
-                  coeffs = sinc_table7[fluid_phase_fract_to_tablerow (dsp_phase)];
-
-                  dsp_buf[dsp_i] = dsp_amp * (coeffs[0] * (float)dsp_data[dsp_phase_index-3]
-                     + coeffs[1] * (float)dsp_data[dsp_phase_index-2]
-                     + coeffs[2] * (float)dsp_data[dsp_phase_index-1]
-                     + coeffs[3] * (float)dsp_data[dsp_phase_index]
-                     + coeffs[4] * (float)dsp_data[dsp_phase_index+1]
-                     + coeffs[5] * (float)dsp_data[dsp_phase_index+2]
-                     + coeffs[6] * (float)dsp_data[dsp_phase_index+3]);
-
-                  /* increment phase and amplitude */
-                  dsp_phase += dsp_phase_incr;
-                  dsp_phase_index = dsp_phase.index();
-                  dsp_amp += dsp_amp_incr;
-                  }
+            dsp_i = dspKernels.interpolate7(dsp_buf, dsp_i, n, dsp_data,
+               dsp_phase, dsp_phase_incr, dsp_amp, dsp_amp_incr, end_index);
+            dsp_phase_index = dsp_phase.index();
 
             /* break out if buffer filled */
             if (dsp_i >= n)
@@ -22,13 +22,40 @@
 #include "fluid.h"
 #include "sfont.h"
 #include "conv.h"
+#include "simd.h"
 #include "gen.h"
 #include "chorus.h"
 #include "voice.h"
 #include "msynth/sparm_p.h"
 
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+#ifdef Q_WS_WIN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+extern bool debugMode;
+
 namespace FluidS {
 
+//---------------------------------------------------------
+//   peakRss
+//    peak resident set size in kbyte, 0 if unknown
+//---------------------------------------------------------
+
+static long peakRss()
+      {
+#ifdef Q_OS_UNIX
+      struct rusage ru;
+      if (getrusage(RUSAGE_SELF, &ru) == 0)
+            return ru.ru_maxrss;
+#endif
+      return 0;
+      }
+
 /***************************************************************
  *
  *                         GLOBAL
@@ -90,7 +117,12 @@ Fluid::Fluid()
       fx_buf[1] = new float[FLUID_MAX_BUFSIZE];
       reverb    = 0;
       chorus    = 0;
-      silentBlocks = 0;
+      reverbBlocks = 0;
+      chorusBlocks = 0;
+      renderList   = 0;
+      renderVoices = 0;
+      renderLen    = 0;
+      rendering    = false;
       }
 
 //---------------------------------------------------------
@@ -103,6 +135,7 @@ void Fluid::init()
       initialized = true;
       fluid_conversion_config();
       Voice::dsp_float_config();
+      initDspKernels();
       }
 
 //---------------------------------------------------------
@@ -125,12 +158,18 @@ void Fluid::init(int sr)
             _tuning[i] = i * 100.0;
       _masterTuning = 440.0;
 
-      for (int i = 0; i < 512; i++)
+      activeVoices.reserve(POLYPHONY);
+      freeVoices.reserve(POLYPHONY);
+      for (int i = 0; i < POLYPHONY; i++)
             freeVoices.append(new Voice(this));
+      renderList = new Voice*[POLYPHONY];
 
       reverb = new Reverb();
       chorus = new Chorus(sample_rate);
       reverb->setPreset(0);
+
+      // the audio thread renders too, use up to eight cores
+      setRenderThreads(qMax(0, qMin(QThread::idealThreadCount(), 8) - 1));
       }
 
 //---------------------------------------------------------
@@ -140,6 +179,8 @@ void Fluid::init(int sr)
 Fluid::~Fluid()
       {
       _state = FLUID_SYNTH_STOPPED;
+      setRenderThreads(0);
+      delete[] renderList;
       foreach(Voice* v, activeVoices)
             delete v;
       foreach(Voice* v, freeVoices)
@@ -166,10 +207,206 @@ Fluid::~Fluid()
 
 void Fluid::freeVoice(Voice* v)
       {
+      if (rendering)          // process() collects the voice later
+            return;
       if (activeVoices.removeOne(v))
             freeVoices.append(v);
       }
 
+//---------------------------------------------------------
+//   setRenderThreads
+//    set the number of threads helping the audio thread
+//    to write the voices; must not be called while
+//    process() runs
+//---------------------------------------------------------
+
+void Fluid::setRenderThreads(int n)
+      {
+      foreach(RenderThread* t, renderThreads) {
+            t->stop();
+            delete t;
+            }
+      renderThreads.clear();
+      for (int i = 0; i < n; ++i) {
+            RenderThread* t = new RenderThread(this);
+            t->start(QThread::TimeCriticalPriority);
+            renderThreads.append(t);
+            }
+      }
+
+//---------------------------------------------------------
+//   renderShare
+//    write voices of renderList until all are taken;
+//    called by the audio thread and the render threads
+//---------------------------------------------------------
+
+void Fluid::renderShare(float* left, float* right, float* reverb, float* chorus)
+      {
+      static const int CHUNK = 4;
+      for (;;) {
+            int i = nextVoice.fetchAndAddRelaxed(CHUNK);
+            if (i >= renderVoices)
+                  break;
+            int n = qMin(i + CHUNK, renderVoices);
+            for (; i < n; ++i)
+                  renderList[i]->write(renderLen, left, right, reverb, chorus);
+            }
+      }
+
+//---------------------------------------------------------
+//   RenderThread
+//---------------------------------------------------------
+
+RenderThread::RenderThread(Fluid* f)
+      {
+      fluid = f;
+      quit  = false;
+      left  = new float[FLUID_MAX_BUFSIZE];
+      right = new float[FLUID_MAX_BUFSIZE];
+      fx[0] = new float[FLUID_MAX_BUFSIZE];
+      fx[1] = new float[FLUID_MAX_BUFSIZE];
+      }
+
+RenderThread::~RenderThread()
+      {
+      delete[] left;
+      delete[] right;
+      delete[] fx[0];
+      delete[] fx[1];
+      }
+
+//---------------------------------------------------------
+//   stop
+//---------------------------------------------------------
+
+void RenderThread::stop()
+      {
+      quit = true;
+      generation.fetchAndAddRelease(1);
+      wait();
+      }
+
+//---------------------------------------------------------
+//   run
+//---------------------------------------------------------
+
+void RenderThread::run()
+      {
+      int seen = 0;
+      for (;;) {
+            //
+            // blocks follow each other within a few ms while
+            // playing; yield until the next one and sleep only
+            // if there is none for a while
+            //
+            int spins = 0;
+            while (generation.fetchAndAddAcquire(0) == seen) {
+                  if (++spins < SPIN_ROUNDS)
+                        yieldCurrentThread();
+                  else
+                        msleep(1);
+                  }
+            seen = generation.fetchAndAddAcquire(0);
+            if (quit)
+                  break;
+            DenormalGuard dg;
+            int byte_size = fluid->renderLength() * sizeof(float);
+            memset(left,  0, byte_size);
+            memset(right, 0, byte_size);
+            memset(fx[0], 0, byte_size);
+            memset(fx[1], 0, byte_size);
+            fluid->renderShare(left, right, fx[0], fx[1]);
+            fluid->renderDone();
+            }
+      }
+
+//---------------------------------------------------------
+//   ParameterSlots
+//---------------------------------------------------------
+
+ParameterSlots::ParameterSlots()
+      {
+      for (int i = 0; i < PARAMETER_SLOTS; ++i) {
+            slots[i].value = 0.0;
+            slots[i].valid = false;
+            }
+      }
+
+//---------------------------------------------------------
+//   slot
+//    return the slot of parameter id or -1
+//---------------------------------------------------------
+
+int ParameterSlots::slot(int id)
+      {
+      SParmId spid(id);
+      if (spid.paramId >= unsigned(PARAMETER_GROUP_SLOTS))
+            return -1;
+      if (spid.subsystemId == REVERB_GROUP)
+            return spid.paramId;
+      if (spid.subsystemId == CHORUS_GROUP)
+            return PARAMETER_GROUP_SLOTS + spid.paramId;
+      return -1;
+      }
+
+//---------------------------------------------------------
+//   id
+//    return the parameter id of slot
+//---------------------------------------------------------
+
+int ParameterSlots::id(int slot)
+      {
+      int group = slot < PARAMETER_GROUP_SLOTS ? REVERB_GROUP : CHORUS_GROUP;
+      return SParmId(FLUID_ID, group, slot % PARAMETER_GROUP_SLOTS).val;
+      }
+
+//---------------------------------------------------------
+//   set
+//    writer only
+//---------------------------------------------------------
+
+void ParameterSlots::set(int slot, double value)
+      {
+      Slot& s = slots[slot];
+      s.seq.fetchAndAddOrdered(1);
+      s.value = value;
+      s.valid = true;
+      s.seq.fetchAndAddOrdered(1);
+      for (;;) {
+            int o = changed;
+            if (changed.testAndSetOrdered(o, o | (1 << slot)))
+                  break;
+            }
+      }
+
+//---------------------------------------------------------
+//   value
+//    reader: return false if the value is being written
+//---------------------------------------------------------
+
+bool ParameterSlots::value(int slot, double* value) const
+      {
+      Slot& s = const_cast<Slot&>(slots[slot]);
+      int seq = s.seq.fetchAndAddOrdered(0);
+      if (seq & 1)
+            return false;
+      *value = s.value;
+      return s.seq.fetchAndAddOrdered(0) == seq;
+      }
+
+//---------------------------------------------------------
+//   writtenValue
+//    writer: return the last value set if there is one
+//---------------------------------------------------------
+
+bool ParameterSlots::writtenValue(int slot, double* value) const
+      {
+      if (!slots[slot].valid)
+            return false;
+      *value = slots[slot].value;
+      return true;
+      }
+
 //---------------------------------------------------------
 //   play
 //---------------------------------------------------------
@@ -485,6 +722,18 @@ void Fluid::program_reset()
 void Fluid::process(unsigned len, float* lout, float* rout, float gain)
       {
       const int byte_size = len * sizeof(float);
+      DenormalGuard dg;
+
+      SoundFontChange* sc = sfChange.fetchAndStoreOrdered(0);
+      if (sc)
+            applySoundFontChange(sc);
+
+      int changed = parameters.takeChanged();
+      for (int i = 0; changed; ++i, changed >>= 1) {
+            double value;
+            if ((changed & 1) && parameters.value(i, &value))
+                  applyParameter(ParameterSlots::id(i), value);
+            }
 
       /* clean the audio buffers */
       memset(left_buf,  0, byte_size);
@@ -492,24 +741,60 @@ void Fluid::process(unsigned len, float* lout, float* rout, float gain)
       memset(fx_buf[0], 0, byte_size);
       memset(fx_buf[1], 0, byte_size);
 
-      if (mutex.tryLock()) {
-            if (activeVoices.isEmpty())
-                  silentBlocks--;
-            else {
-                  silentBlocks = SILENT_BLOCKS;
-                  foreach (Voice* v, activeVoices)
-                        v->write(len, left_buf, right_buf, fx_buf[0], fx_buf[1]);
+      int n = activeVoices.size();
+      bool reverbSend = false;
+      bool chorusSend = false;
+      if (n) {
+            //
+            // write voices from a snapshot of activeVoices; voices
+            // which end meanwhile are collected afterwards
+            //
+            for (int i = 0; i < n; ++i)
+                  renderList[i] = activeVoices[i];
+            renderVoices = n;
+            renderLen    = len;
+            rendering    = true;
+            nextVoice.fetchAndStoreRelaxed(0);
+
+            int threads = qMin(renderThreads.size(), n / THREAD_VOICES - 1);
+            if (threads > 0) {
+                  busyThreads.fetchAndStoreRelaxed(threads);
+                  for (int i = 0; i < threads; ++i)
+                        renderThreads[i]->render();
                   }
-            if (silentBlocks > 0) {
-                  reverb->process(len, fx_buf[0], left_buf, right_buf);
-                  chorus->process(len, fx_buf[1], left_buf, right_buf);
+            renderShare(left_buf, right_buf, fx_buf[0], fx_buf[1]);
+            if (threads > 0) {
+                  while (busyThreads.fetchAndAddAcquire(0) > 0)
+                        ;
+                  for (int i = 0; i < threads; ++i) {
+                        RenderThread* t = renderThreads[i];
+                        dspKernels.mix(left_buf,  t->left,  1.0, len);
+                        dspKernels.mix(right_buf, t->right, 1.0, len);
+                        dspKernels.mix(fx_buf[0], t->fx[0], 1.0, len);
+                        dspKernels.mix(fx_buf[1], t->fx[1], 1.0, len);
+                        }
+                  }
+            rendering = false;
+            for (int i = 0; i < n; ++i) {
+                  Voice* v = renderList[i];
+                  reverbSend |= v->amp_reverb != 0.0;
+                  chorusSend |= v->amp_chorus != 0.0;
+                  if (!v->PLAYING())
+                        freeVoice(v);
                   }
-            mutex.unlock();
-            }
-      for (unsigned i = 0; i < len; i++) {
-            *lout++ += gain * left_buf[i];
-            *rout++ += gain * right_buf[i];
             }
+      //
+      // run the effects only while voices send to them
+      // and for the length of their tail
+      //
+      reverbBlocks = reverbSend ? SILENT_BLOCKS : qMax(reverbBlocks - 1, 0);
+      chorusBlocks = chorusSend ? SILENT_BLOCKS : qMax(chorusBlocks - 1, 0);
+      if (reverbBlocks > 0 && reverb->getlevel() != 0.0)
+            reverb->process(len, fx_buf[0], left_buf, right_buf);
+      if (chorusBlocks > 0 && chorus->get_level() != 0.0)
+            chorus->process(len, fx_buf[1], left_buf, right_buf);
+      dspKernels.mix(lout, left_buf, gain, len);
+      dspKernels.mix(rout, right_buf, gain, len);
       }
 
 /*
@@ -712,20 +997,19 @@ bool Fluid::loadSoundFonts(const QStringList& sl)
             // printf("Fluid:loadSoundFonts: already loaded\n");
             return true;
             }
-      mutex.lock();
-      foreach(Voice* v, activeVoices)
-            v->off();
-      foreach(Channel* c, channel)
-            c->reset();
-      foreach (SFont* sf, sfonts)
-            sfunload(sf->id(), true);
+      SoundFontChange* sc = new SoundFontChange;
+      sc->voicesOff     = true;
+      sc->resetChannels = true;
       bool ok = true;
 
       for (int i = sl.size() - 1; i >= 0; --i) {
-            if (sfload(sl[i], true) == -1)
+            SFont* sf = sfload(sl[i]);
+            if (sf)
+                  sc->sfonts.prepend(sf);
+            else
                   ok = false;
             }
-      mutex.unlock();
+      changeSoundFonts(sc);
       return ok;
       }
 
@@ -736,10 +1020,14 @@ bool Fluid::loadSoundFonts(const QStringList& sl)
 
 bool Fluid::addSoundFont(const QString& s)
       {
-      mutex.lock();
-      bool rv = (sfload(s, true) == -1) ? false : true;
-      mutex.unlock();
-      return rv;
+      SFont* sf = sfload(s);
+      if (!sf)
+            return false;
+      SoundFontChange* sc = new SoundFontChange;
+      sc->sfonts = sfonts;
+      sc->sfonts.prepend(sf);
+      changeSoundFonts(sc);
+      return true;
       }
 
 //---------------------------------------------------------
@@ -749,67 +1037,116 @@ bool Fluid::addSoundFont(const QString& s)
 
 bool Fluid::removeSoundFont(const QString& s)
       {
-      mutex.lock();
-      foreach(Voice* v, activeVoices)
-            v->off();
       SFont* sf = get_sfont_by_name(s);
-      sfunload(sf->id(), true);
-      mutex.unlock();
+      if (!sf)
+            return false;
+      SoundFontChange* sc = new SoundFontChange;
+      sc->voicesOff = true;
+      sc->sfonts    = sfonts;
+      sc->sfonts.removeAll(sf);
+      changeSoundFonts(sc);
       return true;
       }
 
+//---------------------------------------------------------
+//   changeSoundFonts
+//    hand sc to process() and wait until it is installed;
+//    then delete the fonts no longer used. If no block
+//    comes the audio is not running and sc is installed
+//    here.
+//---------------------------------------------------------
+
+void Fluid::changeSoundFonts(SoundFontChange* sc)
+      {
+      sfChange.fetchAndStoreOrdered(sc);
+      for (int i = 0; i < 100 && sfChange == sc; ++i) {
+#ifdef Q_WS_WIN
+            Sleep(1);
+#else
+            usleep(1000);
+#endif
+            }
+      if (sfChange.testAndSetOrdered(sc, 0))
+            applySoundFontChange(sc);
+      while (!sc->done.fetchAndAddAcquire(0)) {
+#ifdef Q_WS_WIN
+            Sleep(1);
+#else
+            usleep(1000);
+#endif
+            }
+      // sc->sfonts is the old list now
+      foreach(SFont* sf, sc->sfonts) {
+            if (!sfonts.contains(sf))
+                  delete sf;
+            }
+      delete sc;
+      updatePatchList();
+      if (debugMode)
+            printf("fluid: soundfonts installed, peak rss %ld kB\n", peakRss());
+      }
+
+//---------------------------------------------------------
+//   applySoundFontChange
+//    install the soundfont list of sc; called by process()
+//    at the start of a block, allocates nothing
+//---------------------------------------------------------
+
+void Fluid::applySoundFontChange(SoundFontChange* sc)
+      {
+      if (sc->voicesOff) {
+            foreach(Voice* v, activeVoices)
+                  v->off();
+            }
+      if (sc->resetChannels) {
+            foreach(Channel* c, channel)
+                  c->reset();
+            }
+      QList<SFont*> ol = sfonts;
+      sfonts     = sc->sfonts;
+      sc->sfonts = ol;
+      program_reset();
+      sc->done.fetchAndStoreRelease(1);
+      }
+
 //---------------------------------------------------------
 //   sfload
+//    read a soundfont; it is installed by
+//    changeSoundFonts()
 //---------------------------------------------------------
 
-int Fluid::sfload(const QString& filename, bool reset_presets)
+SFont* Fluid::sfload(const QString& filename)
       {
       if (filename.isEmpty())
-            return -1;
+            return 0;
 
       SFont* sf = new SFont(this);
       if (!sf->read(filename)) {
             delete sf;
-            sf = 0;
-            return -1;
+            return 0;
             }
 
+#ifdef SOUNDFONT3
+      sf->openPcmCache();
+#endif
       sf->setId(++sfont_id);
-
-      /* insert the sfont as the first one on the list */
-      sfonts.prepend(sf);
-
-      /* reset the presets for all channels */
-      if (reset_presets)
-            program_reset();
-
-      updatePatchList();
-      return sf->id();
+      if (debugMode)
+            printf("fluid: loaded <%s>, peak rss %ld kB\n", qPrintable(filename), peakRss());
+      return sf;
       }
 
 //---------------------------------------------------------
-//   sfunload
+//   sampleInUse
+//    return true if an active voice plays sample s
 //---------------------------------------------------------
 
-bool Fluid::sfunload(int id, bool reset_presets)
+bool Fluid::sampleInUse(const Sample* s) const
       {
-      SFont* sf = get_sfont_by_id(id);
-
-      if (!sf) {
-            printf("No SoundFont with id = %d", id);
-            return false;
+      foreach(const Voice* v, activeVoices) {
+            if (v->sample == s)
+                  return true;
             }
-
-      sfonts.removeAll(sf);   // remove the SoundFont from the list
-
-      /* reset the presets for all channels */
-      if (reset_presets)
-            program_reset();
-      else
-            update_presets();
-      delete sf;
-      updatePatchList();
-      return true;
+      return false;
       }
 
 //---------------------------------------------------------
@@ -995,7 +1332,12 @@ SyntiParameter Fluid::parameter(int id) const
       for (unsigned i = 0; i < sizeof(params)/sizeof(*params); ++i) {
             SyntiParameter& p = params[i];
             if (id == p.id()) {
-                  if (group == REVERB_GROUP)
+                  // a value set but not yet applied by process()
+                  double value;
+                  int slot = ParameterSlots::slot(id);
+                  if (slot >= 0 && parameters.writtenValue(slot, &value))
+                        params[i].set(value);
+                  else if (group == REVERB_GROUP)
                         params[i].set(reverb->parameter(no));
                   else if (group == CHORUS_GROUP)
                         params[i].set(chorus->parameter(no));
@@ -1016,6 +1358,18 @@ void Fluid::setParameter(int id, double value)
       SParmId spid(id);
       if (spid.syntiId != FLUID_ID)
             return;
+      int slot = ParameterSlots::slot(id);
+      if (slot >= 0)
+            parameters.set(slot, value);
+      }
+
+//---------------------------------------------------------
+//   applyParameter
+//---------------------------------------------------------
+
+void Fluid::applyParameter(int id, double value)
+      {
+      SParmId spid(id);
       if (spid.subsystemId == REVERB_GROUP)
             reverb->setParameter(spid.paramId, value);
       else if (spid.subsystemId == CHORUS_GROUP)
@@ -1119,14 +1473,11 @@ void Fluid::setState(SyntiState& sp)
             if (spid.syntiId != FLUID_ID)
                   continue;
             int group = spid.subsystemId;
-            int no    = spid.paramId;
 
             if (group == FLUID_GROUP)
                   ;
-            else if (group == REVERB_GROUP)
-                  reverb->setParameter(no, p.fval());
-            else if (group == CHORUS_GROUP)
-                  chorus->setParameter(no, p.fval());
+            else if (group == REVERB_GROUP || group == CHORUS_GROUP)
+                  setParameter(id, p.fval());
             else
                   printf("Fluid::setState: unknown group %d\n", group);
             }
@@ -308,13 +308,95 @@ enum {
       CHORUS_GAIN
       };
 
+//---------------------------------------------------------
+//   ParameterSlots
+//    latest value of every reverb and chorus parameter
+//    set by the gui thread; the audio thread applies the
+//    changed values at the start of process()
+//
+//    Only the last value of a parameter counts, so new
+//    values overwrite older ones instead of being queued.
+//    Each slot is a sequence lock: the writer makes seq
+//    odd while it writes the value and then marks the
+//    slot changed. A reader which sees a write in progress
+//    skips the slot; the writer marks it again when done.
+//---------------------------------------------------------
+
+static const int PARAMETER_GROUP_SLOTS = 8;
+static const int PARAMETER_SLOTS       = 2 * PARAMETER_GROUP_SLOTS;
+
+class ParameterSlots {
+      struct Slot {
+            QAtomicInt seq;
+            volatile double value;
+            bool valid;             // set once, writer only
+            };
+      Slot slots[PARAMETER_SLOTS];
+      QAtomicInt changed;           // bit i: slot i changed
+
+   public:
+      ParameterSlots();
+      static int slot(int id);
+      static int id(int slot);
+      void set(int slot, double value);
+      bool value(int slot, double* value) const;
+      bool writtenValue(int slot, double* value) const;
+      int takeChanged()           { return changed.fetchAndStoreOrdered(0); }
+      };
+
+//---------------------------------------------------------
+//   SoundFontChange
+//    a soundfont list prepared by the gui thread; process()
+//    installs it at the start of the next block
+//---------------------------------------------------------
+
+struct SoundFontChange {
+      QList<SFont*> sfonts;         // the new list, the old one after done
+      bool voicesOff;               // stop all voices
+      bool resetChannels;
+      QAtomicInt done;
+
+      SoundFontChange() : voicesOff(false), resetChannels(false) {}
+      };
+
+//---------------------------------------------------------
+//   RenderThread
+//    renders a share of the active voices of a Fluid into
+//    its private buffers; started once and woken for every
+//    process() call with enough voices by counting up
+//    generation, which the thread polls
+//---------------------------------------------------------
+
+class RenderThread : public QThread {
+      static const int SPIN_ROUNDS = 20000;     // yields before falling asleep
+
+      Fluid* fluid;
+      QAtomicInt generation;
+      volatile bool quit;
+
+      virtual void run();
+
+   public:
+      float* left;
+      float* right;
+      float* fx[2];
+
+      RenderThread(Fluid*);
+      ~RenderThread();
+      void render()     { generation.fetchAndAddRelease(1); }
+      void stop();
+      };
+
 //---------------------------------------------------------
 //   Fluid
 //---------------------------------------------------------
 
 class Fluid : public Synth {
-      static const int SILENT_BLOCKS = 32*5;
-      int silentBlocks;
+      static const int SILENT_BLOCKS = 32*5;      // effect tail after the last send
+      static const int POLYPHONY     = 512;
+      static const int THREAD_VOICES = 16;      // min. voices per render thread
+      int reverbBlocks;                   // blocks until the reverb tail is silent
+      int chorusBlocks;
 
       QList<SFont*> sfonts;               // the loaded soundfonts
       QList<BankOffset*> bank_offsets;    // the offsets of the soundfont banks
@@ -331,9 +413,22 @@ class Fluid : public Synth {
       float _masterTuning;                // usually 440.0
       double _tuning[128];                // the pitch of every key, in cents
 
-      QMutex mutex;
+      QAtomicPointer<SoundFontChange> sfChange;   // taken by process()
+      void changeSoundFonts(SoundFontChange*);
+      void applySoundFontChange(SoundFontChange*);
       void updatePatchList();
 
+      ParameterSlots parameters;
+      void applyParameter(int id, double val);
+
+      QList<RenderThread*> renderThreads;
+      Voice** renderList;                 // snapshot of activeVoices for one process() call
+      int renderVoices;
+      unsigned renderLen;
+      bool rendering;                     // voices are written, defer freeVoice()
+      QAtomicInt nextVoice;               // next voice in renderList to write
+      QAtomicInt busyThreads;             // render threads not yet done
+
    protected:
       int _state;                         // the synthesizer state
 
@@ -356,8 +451,7 @@ class Fluid : public Synth {
       SFont* get_sfont(int idx) const     { return sfonts[idx];   }
       void remove_sfont(SFont* sf);
       int add_sfont(SFont* sf);
-      bool sfunload(int id, bool reset_presets);
-      int sfload(const QString& filename, bool reset_presets);
+      SFont* sfload(const QString& filename);
 
    public:
       Fluid();
@@ -436,6 +530,11 @@ class Fluid : public Synth {
       void get_pitch_bend(int chan, int* ppitch_bend);
 
       void freeVoice(Voice* v);
+      void renderShare(float* left, float* right, float* reverb, float* chorus);
+      void renderDone()             { busyThreads.fetchAndAddRelease(-1); }
+      unsigned renderLength() const { return renderLen; }
+      void setRenderThreads(int n);
+      int nRenderThreads() const    { return renderThreads.size(); }
 
       double getPitch(int k) const   { return _tuning[k]; }
       float ct2hz_real(float cents)  { return powf(2.0f, (cents - 6900.0f) / 1200.0f) * _masterTuning; }
@@ -447,6 +546,7 @@ class Fluid : public Synth {
       virtual void setMasterTuning(double f)  { _masterTuning = f;    }
 
       QString error() const { return _error; }
+      bool sampleInUse(const Sample*) const;
 
       friend class Voice;
       friend class Preset;
@@ -0,0 +1,331 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA
+ */
+
+#include "pcmcache.h"
+
+extern QString dataPath;
+extern bool debugMode;
+
+namespace FluidS {
+
+static const qint64 PCM_CACHE_BYTES = 1024 * 1024 * 1024;     // max. size of all cache files
+static const char PCM_MAGIC[8]      = { 'F', 'L', 'U', 'I', 'D', 'P', 'C', 'M' };
+static const char PCM_RECORD[4]     = { 'S', 'M', 'P', 'L' };
+static const quint32 PCM_VERSION    = 3;
+static const int PCM_WRITE_INTERVAL = 250;      // ms between two writes of new samples
+
+//---------------------------------------------------------
+//   PcmHeader
+//    followed by the records; all values are in host byte
+//    order
+//---------------------------------------------------------
+
+struct PcmHeader {
+      char magic[8];
+      quint32 version;
+      quint32 reserved;
+      char hash[16];          // contentHash() of the font
+      };
+
+//---------------------------------------------------------
+//   PcmRecord
+//    followed by the sample data, padded to 16 bytes; the
+//    sample data is 16 byte aligned
+//---------------------------------------------------------
+
+struct PcmRecord {
+      char magic[4];
+      quint32 key;
+      quint32 frames;
+      quint32 loopstart;
+      quint32 loopend;
+      quint32 reserved[3];
+      };
+
+static qint64 align(qint64 n)
+      {
+      return (n + 15) & ~qint64(15);
+      }
+
+//---------------------------------------------------------
+//   PcmWriter::run
+//---------------------------------------------------------
+
+void PcmWriter::run()
+      {
+      while (!quit) {
+            cache->write();
+            msleep(PCM_WRITE_INTERVAL);
+            }
+      cache->write();
+      }
+
+//---------------------------------------------------------
+//   PcmCache
+//---------------------------------------------------------
+
+PcmCache::PcmCache(const QString& font, const QByteArray& h)
+      : hash(h), pending(0)
+      {
+      map        = 0;
+      writer     = 0;
+      addedBytes = 0;
+      if (dataPath.isEmpty() || hash.size() != 16)
+            return;
+      path = dataPath + "/sf3cache/" + hash.toHex() + ".pcm";
+      file.setFileName(path);
+      QList<Entry> list;
+      map = mapFile(&file, &list);
+      foreach(const Entry& e, list)
+            entries.insert(e.key, e);
+      if (debugMode && map)
+            printf("fluid: %d cached samples for <%s>\n", entries.size(), qPrintable(font));
+      writer = new PcmWriter(this);
+      writer->start(QThread::LowPriority);
+      }
+
+PcmCache::~PcmCache()
+      {
+      if (writer) {
+            writer->stop();
+            delete writer;
+            }
+      out.close();
+      entries.clear();
+      map = 0;
+      file.close();
+      if (writer)
+            trim();
+      }
+
+//---------------------------------------------------------
+//   mapFile
+//    open and map the cache file f and read its entries;
+//    returns zero if there is no valid cache file. A
+//    damaged or incomplete record ends the list.
+//---------------------------------------------------------
+
+const uchar* PcmCache::mapFile(QFile* f, QList<Entry>* list) const
+      {
+      if (!f->open(QIODevice::ReadOnly))
+            return 0;
+      quint64 size   = f->size();
+      const uchar* p = size >= sizeof(PcmHeader) ? f->map(0, size) : 0;
+      if (p) {
+            const PcmHeader* h = (const PcmHeader*)p;
+            if (memcmp(h->magic, PCM_MAGIC, sizeof(PCM_MAGIC)) == 0
+               && h->version == PCM_VERSION
+               && memcmp(h->hash, hash.constData(), sizeof(h->hash)) == 0) {
+                  quint64 pos = sizeof(PcmHeader);
+                  while (pos + sizeof(PcmRecord) <= size) {
+                        const PcmRecord* r = (const PcmRecord*)(p + pos);
+                        quint64 bytes      = quint64(r->frames) * sizeof(short);
+                        if (memcmp(r->magic, PCM_RECORD, sizeof(PCM_RECORD))
+                           || bytes > size - pos - sizeof(PcmRecord)
+                           || quint64(align(pos + sizeof(PcmRecord) + bytes)) > size)
+                              break;
+                        Entry e;
+                        e.key       = r->key;
+                        e.frames    = r->frames;
+                        e.loopstart = r->loopstart;
+                        e.loopend   = r->loopend;
+                        e.offset    = pos + sizeof(PcmRecord);
+                        list->append(e);
+                        pos = align(e.offset + bytes);
+                        }
+                  return p;
+                  }
+            if (debugMode)
+                  printf("fluid: drop invalid sample cache <%s>\n", qPrintable(f->fileName()));
+            }
+      f->close();
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   find
+//    return the cached sample data for key or zero
+//---------------------------------------------------------
+
+const short* PcmCache::find(quint32 key, Entry* e) const
+      {
+      if (!map)
+            return 0;
+      QHash<quint32, Entry>::const_iterator i = entries.find(key);
+      if (i == entries.end())
+            return 0;
+      *e = i.value();
+      return (const short*)(map + e->offset);
+      }
+
+//---------------------------------------------------------
+//   add
+//    queue a decoded sample for the writer; called on the
+//    audio thread, so it only copies the sample and pushes
+//    it without lock
+//---------------------------------------------------------
+
+void PcmCache::add(quint32 key, const short* data, quint32 frames, quint32 loopstart, quint32 loopend)
+      {
+      if (!writer || entries.contains(key) || added.contains(key))
+            return;
+      qint64 bytes = qint64(frames) * sizeof(short);
+      if (addedBytes + bytes > PCM_CACHE_BYTES)
+            return;
+      added.insert(key);
+      addedBytes += bytes;
+
+      Pending* p = new Pending;
+      p->record.resize(align(sizeof(PcmRecord) + bytes));
+      char* d = p->record.data();
+      PcmRecord* r = (PcmRecord*)d;
+      memcpy(r->magic, PCM_RECORD, sizeof(PCM_RECORD));
+      r->key       = key;
+      r->frames    = frames;
+      r->loopstart = loopstart;
+      r->loopend   = loopend;
+      memset(r->reserved, 0, sizeof(r->reserved));
+      memcpy(d + sizeof(PcmRecord), data, bytes);
+      memset(d + sizeof(PcmRecord) + bytes, 0, p->record.size() - sizeof(PcmRecord) - bytes);
+
+      Pending* head;
+      do {
+            head    = pending;
+            p->next = head;
+            } while (!pending.testAndSetOrdered(head, p));
+      }
+
+//---------------------------------------------------------
+//   openOut
+//    open the cache file for appending; a new or invalid
+//    file gets a new header, a damaged last record is cut
+//    off. Returns false if the file cannot be written.
+//---------------------------------------------------------
+
+bool PcmCache::openOut()
+      {
+      QDir dir;
+      dir.mkpath(dataPath + "/sf3cache");
+      QFile f(path);
+      if (!f.open(QIODevice::ReadWrite)) {
+            printf("fluid: cannot write sample cache <%s>: %s\n", qPrintable(path), qPrintable(f.errorString()));
+            return false;
+            }
+      PcmHeader h;
+      qint64 size = f.size();
+      qint64 end  = 0;
+      if (size >= qint64(sizeof(h)) && f.read((char*)&h, sizeof(h)) == sizeof(h)
+         && memcmp(h.magic, PCM_MAGIC, sizeof(PCM_MAGIC)) == 0
+         && h.version == PCM_VERSION
+         && memcmp(h.hash, hash.constData(), sizeof(h.hash)) == 0) {
+            end = sizeof(h);
+            PcmRecord r;
+            while (f.seek(end) && f.read((char*)&r, sizeof(r)) == sizeof(r)
+               && memcmp(r.magic, PCM_RECORD, sizeof(PCM_RECORD)) == 0
+               && align(end + sizeof(r) + qint64(r.frames) * sizeof(short)) <= size)
+                  end = align(end + sizeof(r) + qint64(r.frames) * sizeof(short));
+            }
+      bool ok = true;
+      if (end != size)
+            ok = f.resize(end);
+      if (ok && end == 0) {
+            memset(&h, 0, sizeof(h));
+            memcpy(h.magic, PCM_MAGIC, sizeof(PCM_MAGIC));
+            h.version = PCM_VERSION;
+            memcpy(h.hash, hash.constData(), sizeof(h.hash));
+            ok = f.seek(0) && f.write((const char*)&h, sizeof(h)) == sizeof(h);
+            }
+      f.close();
+      if (!ok) {
+            printf("fluid: cannot write sample cache <%s>\n", qPrintable(path));
+            return false;
+            }
+      // each record is written with one write() at the end
+      // of the file, also if another synthesizer appends
+      out.setFileName(path);
+      return out.open(QIODevice::Append | QIODevice::Unbuffered);
+      }
+
+//---------------------------------------------------------
+//   write
+//    append the samples added since the last call to the
+//    cache file; called by the writer thread. Returns false
+//    if there was nothing to write.
+//---------------------------------------------------------
+
+bool PcmCache::write()
+      {
+      Pending* p = pending.fetchAndStoreOrdered(0);
+      if (p == 0)
+            return false;
+      Pending* list = 0;            // oldest first
+      while (p) {
+            Pending* next = p->next;
+            p->next = list;
+            list    = p;
+            p       = next;
+            }
+      if (!out.isOpen() && !path.isEmpty() && !openOut())
+            path = QString();       // do not try again
+      int n = 0;
+      for (p = list; p; p = list) {
+            list = p->next;
+            if (out.isOpen() && out.size() + p->record.size() <= PCM_CACHE_BYTES) {
+                  if (out.write(p->record) == p->record.size())
+                        ++n;
+                  else {
+                        printf("fluid: write sample cache <%s> failed: %s\n",
+                           qPrintable(path), qPrintable(out.errorString()));
+                        out.close();
+                        path = QString();
+                        }
+                  }
+            delete p;
+            }
+      if (debugMode && n)
+            printf("fluid: %d samples appended to <%s>\n", n, qPrintable(out.fileName()));
+      return true;
+      }
+
+//---------------------------------------------------------
+//   trim
+//    remove the least recently written cache files until
+//    the cache fits into PCM_CACHE_BYTES; also remove
+//    temporary files left behind by older versions
+//---------------------------------------------------------
+
+void PcmCache::trim()
+      {
+      QDir dir(dataPath + "/sf3cache");
+      QFileInfoList fl = dir.entryInfoList(QStringList("*.pcm"), QDir::Files, QDir::Time);
+      qint64 total = 0;
+      foreach(const QFileInfo& fi, fl) {
+            total += fi.size();
+            if (total > PCM_CACHE_BYTES && fi.absoluteFilePath() != QFileInfo(path).absoluteFilePath())
+                  QFile::remove(fi.absoluteFilePath());
+            }
+      QDateTime old = QDateTime::currentDateTime().addDays(-1);
+      foreach(const QFileInfo& fi, dir.entryInfoList(QStringList("*.tmp"), QDir::Files)) {
+            if (fi.lastModified() < old)
+                  QFile::remove(fi.absoluteFilePath());
+            }
+      }
+}
+
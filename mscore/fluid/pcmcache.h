@@ -0,0 +1,107 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA
+ */
+
+#ifndef _FLUID_PCMCACHE_H
+#define _FLUID_PCMCACHE_H
+
+namespace FluidS {
+
+class PcmCache;
+
+//---------------------------------------------------------
+//   PcmWriter
+//    appends the samples added to a PcmCache to its file;
+//    polls the list of new samples so add() needs no lock
+//---------------------------------------------------------
+
+class PcmWriter : public QThread {
+      PcmCache* cache;
+      volatile bool quit;
+
+      virtual void run();
+
+   public:
+      PcmWriter(PcmCache* c) : cache(c), quit(false) {}
+      void stop()       { quit = true; wait(); }
+      };
+
+//---------------------------------------------------------
+//   PcmCache
+//    disk cache of the decoded samples of a compressed
+//    sound font
+//
+//    There is one file per sound font in dataPath/sf3cache
+//    named after SFont::contentHash(), so the same font at
+//    another path shares the file and a changed font gets a
+//    new one. The file is mapped and the samples are used
+//    in place.
+//
+//    The file is a header followed by records of one sample
+//    each. Samples decoded while the font is loaded are
+//    appended by a PcmWriter thread shortly after they
+//    were added, so a crash loses at most the last ones; a
+//    truncated last record is ignored and overwritten.
+//---------------------------------------------------------
+
+class PcmCache {
+   public:
+      struct Entry {
+            quint32 key;            // compressed position of the sample in the font
+            quint32 frames;
+            quint32 loopstart;
+            quint32 loopend;
+            quint64 offset;         // position of the sample data in the file
+            };
+
+   private:
+      //  a decoded sample waiting for the writer; pushed
+      //  by add() on a lock free stack
+      struct Pending {
+            Pending* next;
+            QByteArray record;      // record header and data as written
+            };
+
+      QString path;
+      QByteArray hash;              // contentHash() of the font
+      QFile file;
+      const uchar* map;
+      QHash<quint32, Entry> entries;
+      QSet<quint32> added;          // keys added in this session
+      qint64 addedBytes;
+
+      QAtomicPointer<Pending> pending;
+      PcmWriter* writer;
+      QFile out;                    // append handle of the writer
+
+      const uchar* mapFile(QFile* f, QList<Entry>* list) const;
+      bool openOut();
+      void trim();
+
+   public:
+      PcmCache(const QString& font, const QByteArray& hash);
+      ~PcmCache();
+      const short* find(quint32 key, Entry* e) const;
+      void add(quint32 key, const short* data, quint32 frames, quint32 loopstart, quint32 loopend);
+      bool write();
+      };
+}
+
+#endif
+
@@ -67,6 +67,63 @@ void Comb::setdamp(float val)
       damp2 = 1 - val;
       }
 
+//---------------------------------------------------------
+//   process
+//    add n frames of comb output to out; the delay line
+//    is processed in runs up to its end so that the inner
+//    loop keeps the filter state in registers
+//---------------------------------------------------------
+
+void Comb::process(const float* in, float* out, int n)
+      {
+      float fs = filterstore;
+      int idx  = bufidx;
+      while (n) {
+            int m    = qMin(n, bufsize - idx);
+            float* b = buffer + idx;
+            for (int i = 0; i < m; ++i) {
+                  float tmp = b[i];
+                  fs        = (tmp * damp2) + (fs * damp1);
+                  b[i]      = in[i] + (fs * feedback);
+                  out[i]   += tmp;
+                  }
+            in  += m;
+            out += m;
+            n   -= m;
+            idx += m;
+            if (idx >= bufsize)
+                  idx = 0;
+            }
+      filterstore = fs;
+      bufidx      = idx;
+      }
+
+//---------------------------------------------------------
+//   process
+//    filter n frames of buf in place
+//---------------------------------------------------------
+
+void Allpass::process(float* buf, int n)
+      {
+      int idx = bufidx;
+      while (n) {
+            int m    = qMin(n, bufsize - idx);
+            float* b = buffer + idx;
+            for (int i = 0; i < m; ++i) {
+                  float bufout = b[i];
+                  float input  = buf[i];
+                  b[i]         = input + (bufout * feedback);
+                  buf[i]       = bufout - input;
+                  }
+            buf += m;
+            n   -= m;
+            idx += m;
+            if (idx >= bufsize)
+                  idx = 0;
+            }
+      bufidx = idx;
+      }
+
 static const int stereospread = 23;
 
 /*
@@ -137,28 +194,34 @@ void Reverb::process(int n, float* in, float* l, float* r)
             update();
             parameterChanged = false;
             }
-      for (int k = 0; k < n; k++) {
-            float outL = 0.0;
-            float outR = 0.0;
-
-            float input = (in[k] * 2.0 + DC_OFFSET) * gain;
-
+      while (n) {
+            int m = qMin(n, reverbBlock);
+            for (int k = 0; k < m; k++) {
+                  input[k] = (in[k] * 2.0f + float(DC_OFFSET)) * gain;
+                  outL[k]  = 0.0f;
+                  outR[k]  = 0.0f;
+                  }
             for (int i = 0; i < numcombs; i++) {      // Accumulate comb filters in parallel
-                  outL += combL[i].process(input);
-                  outR += combR[i].process(input);
+                  combL[i].process(input, outL, m);
+                  combR[i].process(input, outR, m);
                   }
             for (int i = 0; i < numallpasses; i++) {  // Feed through allpasses in series
-                  outL = allpassL[i].process(outL);
-                  outR = allpassR[i].process(outR);
+                  allpassL[i].process(outL, m);
+                  allpassR[i].process(outR, m);
                   }
-
-            /* Remove the DC offset */
-            outL -= DC_OFFSET;
-            outR -= DC_OFFSET;
-
-            /* Calculate output MIXING with anything already there */
-            l[k] += outL * wet1 + outR * wet2;
-            r[k] += outR * wet1 + outL * wet2;
+            for (int k = 0; k < m; k++) {
+                  /* Remove the DC offset */
+                  float sl = outL[k] - float(DC_OFFSET);
+                  float sr = outR[k] - float(DC_OFFSET);
+
+                  /* Calculate output MIXING with anything already there */
+                  l[k] += sl * wet1 + sr * wet2;
+                  r[k] += sr * wet1 + sl * wet2;
+                  }
+            in += m;
+            l  += m;
+            r  += m;
+            n  -= m;
             }
       }
 
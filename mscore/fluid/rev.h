@@ -43,14 +43,7 @@ class Allpass {
       void setfeedback(float val) { feedback = val;  }
       float getfeedback() const   { return feedback; }
 
-      float process(float _input) {
-            float bufout = buffer[bufidx];
-            float output = bufout - _input;
-            buffer[bufidx] = _input + (bufout * feedback);
-            if (++bufidx >= bufsize)
-                  bufidx = 0;
-            return output;
-            }
+      void process(float* buf, int n);
       };
 
 //---------------------------------------------------------
@@ -74,20 +67,14 @@ class Comb {
       void setfeedback(float val) { feedback = val;  }
       float getfeedback() const   { return feedback; }
 
-      float process(float input) {
-            float tmp = buffer[bufidx];
-            filterstore      = (tmp * damp2) + (filterstore * damp1);
-            buffer[bufidx]   = input + (filterstore * feedback);
-            if (++bufidx >= bufsize)
-                  bufidx = 0;
-            return tmp;
-            }
+      void process(const float* in, float* out, int n);
       };
 
 static const float scaleroom  = 0.28f;
 static const float offsetroom = 0.7f;
 static const float scalewet   = 3.0f;
 static const float scaledamp  = 0.4f;
+static const int reverbBlock  = 256;      // frames processed per step
 
 //---------------------------------------------------------
 //   Reverb
@@ -121,6 +108,10 @@ class Reverb {
       Allpass allpassL[numallpasses];
       Allpass allpassR[numallpasses];
 
+      float input[reverbBlock];
+      float outL[reverbBlock];
+      float outR[reverbBlock];
+
    public:
       Reverb();
       void process(int n, float* in, float* left_out, float* right_out);
@@ -24,6 +24,9 @@
 #include "sfont.h"
 #include "fluid.h"
 #include "voice.h"
+#ifdef SOUNDFONT3
+#include "pcmcache.h"
+#endif
 
 // #define DEBUG_SFONT
 
@@ -33,6 +36,8 @@ extern bool debugMode;
 
 namespace FluidS {
 
+static const unsigned SAMPLE_CACHE_BYTES = 64 * 1024 * 1024;   // max. unreferenced decoded samples
+
 //---------------------------------------------------------
 //   SFVersion
 //---------------------------------------------------------
@@ -49,15 +54,25 @@ SFVersion::SFVersion()
 
 SFont::SFont(Fluid* f)
       {
-      synth      = f;
-      samplepos  = 0;
-      samplesize = 0;
+      synth          = f;
+      samplepos      = 0;
+      samplesize     = 0;
+      sampleMap      = 0;
+      sampleFileOpen = false;
+      cacheBytes     = 0;
+#ifdef SOUNDFONT3
+      pcm            = 0;
+#endif
       }
 
 SFont::~SFont()
       {
+      cache.clear();
       foreach(Sample* s, sample)
             delete s;
+#ifdef SOUNDFONT3
+      delete pcm;
+#endif
       foreach(Preset* p, presets)
             delete p;
       foreach(unsigned char* p, infos)
@@ -135,23 +150,46 @@ Preset::~Preset()
 
 void Preset::loadSamples()
       {
-//      sfont->synth->mutex.lock();
       if (_global_zone && _global_zone->instrument) {
             Instrument* i = _global_zone->instrument;
             if (i->global_zone && i->global_zone->sample)
-                  i->global_zone->sample->load();
+                  i->global_zone->sample->ref();
             foreach(Zone* iz, i->zones)
-                  iz->sample->load();
+                  iz->sample->ref();
             }
 
       foreach(Zone* z, zones) {
             Instrument* i = z->instrument;
             if (i->global_zone && i->global_zone->sample)
-                  i->global_zone->sample->load();
+                  i->global_zone->sample->ref();
             foreach(Zone* iz, i->zones)
-                  iz->sample->load();
+                  iz->sample->ref();
+            }
+      }
+
+//---------------------------------------------------------
+//   unloadSamples
+//    this is called if the preset is no longer associated
+//    with a channel
+//---------------------------------------------------------
+
+void Preset::unloadSamples()
+      {
+      if (_global_zone && _global_zone->instrument) {
+            Instrument* i = _global_zone->instrument;
+            if (i->global_zone && i->global_zone->sample)
+                  i->global_zone->sample->unref();
+            foreach(Zone* iz, i->zones)
+                  iz->sample->unref();
+            }
+
+      foreach(Zone* z, zones) {
+            Instrument* i = z->instrument;
+            if (i->global_zone && i->global_zone->sample)
+                  i->global_zone->sample->unref();
+            foreach(Zone* iz, i->zones)
+                  iz->sample->unref();
             }
-//      sfont->synth->mutex.unlock();
       }
 
 //---------------------------------------------------------
@@ -575,6 +613,8 @@ Sample::Sample(SFont* s)
       {
       sf          = s;
       _valid      = false;
+      mapped      = false;
+      refs        = 0;
       start       = 0;
       end         = 0;
       loopstart   = 0;
@@ -584,6 +624,12 @@ Sample::Sample(SFont* s)
       pitchadj    = 0;
       sampletype  = 0;
       data        = 0;
+#ifdef SOUNDFONT3
+      oggStart     = 0;
+      oggEnd       = 0;
+      oggLoopstart = 0;
+      oggLoopend   = 0;
+#endif
       amplitude_that_reaches_noise_floor_is_valid = false;
       amplitude_that_reaches_noise_floor = 0.0;
       }
@@ -594,58 +640,132 @@ Sample::Sample(SFont* s)
 
 Sample::~Sample()
       {
-      delete[] data;
+      if (!mapped)
+            delete[] data;
+      }
+
+//---------------------------------------------------------
+//   ref
+//    a channel preset uses the sample
+//---------------------------------------------------------
+
+void Sample::ref()
+      {
+      if (refs++ == 0 && decoded())
+            sf->uncacheSample(this);
+      load();
+      }
+
+#ifdef SOUNDFONT3
+//---------------------------------------------------------
+//   hashHeader
+//    add the header values as read from the file to hash;
+//    called before any sample is decoded
+//---------------------------------------------------------
+
+void Sample::hashHeader(QCryptographicHash* hash) const
+      {
+      quint32 v[5];
+      v[0] = start;
+      v[1] = end;
+      v[2] = loopstart;
+      v[3] = loopend;
+      v[4] = sampletype;
+      hash->addData((const char*)v, sizeof(v));
+      }
+#endif
+
+//---------------------------------------------------------
+//   unref
+//    unused decoded samples go to the sound font cache
+//    where they stay until the cache is full
+//---------------------------------------------------------
+
+void Sample::unref()
+      {
+      if (refs > 0 && --refs == 0 && decoded() && data)
+            sf->cacheSample(this);
       }
 
 //---------------------------------------------------------
 //   load
+//    uncompressed sample data is used in place from the
+//    mapped sound font file if possible
 //---------------------------------------------------------
 
 void Sample::load()
       {
       if (!_valid || data)
             return;
-      QFile fd(sf->get_name());
-      if (!fd.open(QIODevice::ReadOnly))
-            return;
-      if (sampletype & FLUID_SAMPLETYPE_OGG_VORBIS) {
-            if (!fd.seek(sf->samplePos() + start))
-                  return;
-            }
-      else {
-            if (!fd.seek(sf->samplePos() + start * sizeof(short)))
-                  return;
-            }
-      unsigned int size = end - start;
 
       if (sampletype & FLUID_SAMPLETYPE_OGG_VORBIS) {
 #ifdef SOUNDFONT3
-            char* p = new char[size];
-            if (fd.read(p, size) != size) {
-                  printf("  read %d failed\n", size);
+            // decoding rebases the sample; remember the file position
+            // to be able to decode again after the cache dropped it
+            if (oggEnd == 0) {
+                  oggStart     = start;
+                  oggEnd       = end;
+                  oggLoopstart = loopstart;
+                  oggLoopend   = loopend;
+                  }
+            else {
+                  start     = oggStart;
+                  end       = oggEnd;
+                  loopstart = oggLoopstart;
+                  loopend   = oggLoopend;
+                  }
+            PcmCache* pc = sf->pcmCache();
+            PcmCache::Entry e;
+            const short* p = pc ? pc->find(oggStart, &e) : 0;
+            if (p) {
+                  data      = (short*)p;
+                  mapped    = true;
+                  start     = 0;
+                  end       = e.frames - 1;
+                  loopstart = e.loopstart;
+                  loopend   = e.loopend;
+                  optimize();
                   return;
                   }
-            decompressOggVorbis(p, size);
-            delete[] p;
+            unsigned int size = end - start;
+            const uchar* map  = sf->sampleData();
+            if (map && end <= sf->getSamplesize())
+                  decompressOggVorbis((char*)map + start, size);
+            else {
+                  char* buf = new char[size];
+                  if (sf->readSampleData(start, buf, size))
+                        decompressOggVorbis(buf, size);
+                  else
+                        printf("  read %d failed\n", size);
+                  delete[] buf;
+                  }
+            if (!data)
+                  return;
+            if (pc && _valid)
+                  pc->add(oggStart, data, end + 1, loopstart, loopend);
 #endif
             }
       else {
-            data = new short[size];
-            size *= sizeof(short);
-
-            if (fd.read((char*)data, size) != size)
-                  return;
-
-            if (QSysInfo::ByteOrder == QSysInfo::BigEndian) {
-                  unsigned char hi, lo;
-                  unsigned int i, j;
-                  short s;
-                  uchar* cbuf = (uchar*) data;
-                  for (i = 0, j = 0; j < size; i++) {
-                        lo = cbuf[j++];
-                        hi = cbuf[j++];
-                        s = (hi << 8) | lo;
-                        data[i] = s;
+            unsigned int size = end - start;
+            const uchar* map  = sf->sampleData();
+            const uchar* p    = 0;
+            if (map && end * sizeof(short) <= sf->getSamplesize())
+                  p = map + start * sizeof(short);
+            if (p && QSysInfo::ByteOrder == QSysInfo::LittleEndian && !((quintptr)p & 1)) {
+                  data   = (short*)p;
+                  mapped = true;
+                  }
+            else {
+                  data = new short[size];
+                  if (!sf->readSampleData(start * sizeof(short), (char*)data, size * sizeof(short))) {
+                        delete[] data;
+                        data = 0;
+                        return;
+                        }
+                  if (QSysInfo::ByteOrder == QSysInfo::BigEndian) {
+                        uchar* cbuf = (uchar*) data;
+                        for (unsigned int i = 0; i < size; i++)
+                              data[i] = (cbuf[i*2+1] << 8) | cbuf[i*2];
                         }
                   }
             end       -= (start + 1);       // marks last sample, contrary to SF spec.
@@ -656,6 +776,19 @@ void Sample::load()
       optimize();
       }
 
+//---------------------------------------------------------
+//   unload
+//    release decoded sample data
+//---------------------------------------------------------
+
+void Sample::unload()
+      {
+      if (!mapped)
+            delete[] data;
+      data   = 0;
+      mapped = false;
+      }
+
 //---------------------------------------------------------
 //   inRom
 //---------------------------------------------------------
@@ -764,6 +897,132 @@ bool SFont::load()
       return true;
       }
 
+//---------------------------------------------------------
+//   sampleData
+//    map the sample data of the sound font file; the pages
+//    are shared with all users of the file and loaded by
+//    the system on first access
+//    returns zero if the file cannot be mapped
+//---------------------------------------------------------
+
+const uchar* SFont::sampleData()
+      {
+      if (!sampleFileOpen) {
+            sampleFileOpen = true;
+            if (!f.open(QIODevice::ReadOnly)) {
+                  qCritical("Unable to open file \"%s\"", qPrintable(f.fileName()));
+                  return 0;
+                  }
+            sampleMap = f.map(samplepos, samplesize);
+            if (!sampleMap && debugMode)
+                  printf("fluid: cannot map <%s>, reading samples\n", qPrintable(f.fileName()));
+            }
+      return sampleMap;
+      }
+
+#ifdef SOUNDFONT3
+//---------------------------------------------------------
+//   openPcmCache
+//    open the disk cache if the font has compressed
+//    samples; called by Fluid::sfload() so the font is not
+//    hashed on the audio thread
+//---------------------------------------------------------
+
+void SFont::openPcmCache()
+      {
+      if (pcm)
+            return;
+      foreach(const Sample* s, sample) {
+            if (s->decoded()) {
+                  pcm = new PcmCache(f.fileName(), contentHash());
+                  return;
+                  }
+            }
+      }
+
+//---------------------------------------------------------
+//   contentHash
+//    md5 of the sample headers, the chunk size and 64
+//    blocks of 4kB spread over the sample data; it
+//    identifies the decoded samples independent of path
+//    and time stamp of the file without reading the whole
+//    font. Returns an empty array if the sample data
+//    cannot be read.
+//---------------------------------------------------------
+
+QByteArray SFont::contentHash()
+      {
+      static const unsigned BLOCKS     = 64;
+      static const unsigned BLOCK_SIZE = 4096;
+
+      QCryptographicHash hash(QCryptographicHash::Md5);
+      hash.addData((const char*)&samplesize, sizeof(samplesize));
+      foreach(const Sample* s, sample)
+            s->hashHeader(&hash);
+      char buffer[BLOCK_SIZE];
+      for (unsigned i = 0; i < BLOCKS; ++i) {
+            unsigned offset = unsigned(quint64(samplesize) * i / BLOCKS);
+            unsigned n      = qMin(BLOCK_SIZE, samplesize - offset);
+            if (!readSampleData(offset, buffer, n))
+                  return QByteArray();
+            hash.addData(buffer, n);
+            }
+      return hash.result();
+      }
+#endif
+
+//---------------------------------------------------------
+//   readSampleData
+//    read size bytes of the sample data at offset
+//---------------------------------------------------------
+
+bool SFont::readSampleData(unsigned offset, char* buf, unsigned size)
+      {
+      if (offset + size > samplesize)
+            return false;
+      const uchar* map = sampleData();
+      if (map) {
+            memcpy(buf, map + offset, size);
+            return true;
+            }
+      if (!f.isOpen() || !f.seek(samplepos + offset))
+            return false;
+      return f.read(buf, size) == size;
+      }
+
+//---------------------------------------------------------
+//   cacheSample
+//    keep the unreferenced decoded sample s; drop the
+//    least recently used samples which are not played
+//    anymore if the cache is full
+//---------------------------------------------------------
+
+void SFont::cacheSample(Sample* s)
+      {
+      cache.append(s);
+      cacheBytes += s->bytes();
+      for (int i = 0; i < cache.size() && cacheBytes > SAMPLE_CACHE_BYTES;) {
+            Sample* os = cache[i];
+            if (synth->sampleInUse(os)) {
+                  ++i;
+                  continue;
+                  }
+            cache.removeAt(i);
+            cacheBytes -= os->bytes();
+            os->unload();
+            }
+      }
+
+//---------------------------------------------------------
+//   uncacheSample
+//---------------------------------------------------------
+
+void SFont::uncacheSample(Sample* s)
+      {
+      if (cache.removeOne(s))
+            cacheBytes -= s->bytes();
+      }
+
 //---------------------------------------------------------
 //   READW
 //---------------------------------------------------------
@@ -29,6 +29,7 @@
 namespace FluidS {
 
 class Preset;
+class PcmCache;
 class Sample;
 class Instrument;
 struct SFGen;
@@ -54,6 +55,14 @@ class SFont {
       QFile f;
       unsigned samplepos;           // the position in the file at which the sample data starts
       unsigned samplesize;          // the size of the sample data
+      uchar* sampleMap;             // sample data mapped into memory
+      bool sampleFileOpen;
+
+      QList<Sample*> cache;         // unreferenced decoded samples, oldest first
+      unsigned cacheBytes;
+#ifdef SOUNDFONT3
+      PcmCache* pcm;                // disk cache of decoded samples
+#endif
 
       QList<Instrument*> instruments;
       QList<Preset*> presets;
@@ -108,6 +117,16 @@ class SFont {
 
       int load_sampledata();
       unsigned int samplePos() const            { return samplepos;  }
+      const uchar* sampleData();
+      bool readSampleData(unsigned offset, char* buf, unsigned size);
+      void cacheSample(Sample*);
+      void uncacheSample(Sample*);
+#ifdef SOUNDFONT3
+      void openPcmCache();
+      PcmCache* pcmCache() const                { return pcm; }
+      QByteArray contentHash();
+#endif
+      Fluid* fluid() const                      { return synth; }
       int id() const                            { return _id; }
       void setId(int i)                         { _id = i;    }
       void setSamplepos(unsigned v)             { samplepos = v; }
@@ -124,6 +143,12 @@ class SFont {
 
 class Sample {
       bool _valid;
+      bool mapped;                  // data points into the mapped sound font file
+      int refs;                     // number of channel presets using this sample
+#ifdef SOUNDFONT3
+      unsigned int oggStart, oggEnd;      // compressed data position in the sound font
+      unsigned int oggLoopstart, oggLoopend;
+#endif
 
    public:
       SFont* sf;
@@ -152,10 +177,16 @@ class Sample {
       bool inRom() const;
       void optimize();
       void load();
+      void unload();
+      void ref();
+      void unref();
+      bool decoded() const  { return sampletype & FLUID_SAMPLETYPE_OGG_VORBIS; }
+      unsigned bytes() const { return data ? (end + 1) * sizeof(short) : 0; }
       bool valid() const    { return _valid; }
       void setValid(bool v) { _valid = v; }
 #ifdef SOUNDFONT3
       bool decompressOggVorbis(char* p, int size);
+      void hashHeader(QCryptographicHash*) const;
 #endif
       };
 
@@ -233,6 +264,7 @@ class Preset {
 
       Zone* global_zone()                       { return _global_zone; }
       void loadSamples();
+      void unloadSamples();
       QList<Zone*> getZones()                   { return zones; }
       };
 
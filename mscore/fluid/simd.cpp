@@ -0,0 +1,307 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA
+ */
+
+#include "fluid.h"
+#include "voice.h"
+#include "simd.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#endif
+
+namespace FluidS {
+
+//---------------------------------------------------------
+//   mixScalar
+//---------------------------------------------------------
+
+static void mixScalar(float* dst, const float* src, float gain, unsigned n)
+      {
+      for (unsigned i = 0; i < n; ++i)
+            dst[i] += gain * src[i];
+      }
+
+//---------------------------------------------------------
+//   mix2Scalar
+//---------------------------------------------------------
+
+static void mix2Scalar(float* dst1, float gain1, float* dst2, float gain2, const float* src, unsigned n)
+      {
+      for (unsigned i = 0; i < n; ++i) {
+            float v = src[i];
+            dst1[i] += gain1 * v;
+            dst2[i] += gain2 * v;
+            }
+      }
+
+//---------------------------------------------------------
+//   interpolate4Scalar
+//---------------------------------------------------------
+
+static unsigned interpolate4Scalar(float* buf, unsigned i, unsigned n, const short* data,
+   Phase& phase, const Phase& incr, float& amp, float ampIncr, unsigned endIndex)
+      {
+      for (; i < n && unsigned(phase.index()) <= endIndex; ++i) {
+            const float* coeffs = Voice::interp_coeff[fluid_phase_fract_to_tablerow(phase)];
+            const short* d      = data + phase.index();
+            buf[i] = amp * (coeffs[0] * d[-1]
+               + coeffs[1] * d[0]
+               + coeffs[2] * d[1]
+               + coeffs[3] * d[2]);
+            phase += incr;
+            amp   += ampIncr;
+            }
+      return i;
+      }
+
+//---------------------------------------------------------
+//   interpolate7Scalar
+//---------------------------------------------------------
+
+static unsigned interpolate7Scalar(float* buf, unsigned i, unsigned n, const short* data,
+   Phase& phase, const Phase& incr, float& amp, float ampIncr, unsigned endIndex)
+      {
+      for (; i < n && unsigned(phase.index()) <= endIndex; ++i) {
+            const float* coeffs = Voice::sinc_table7[fluid_phase_fract_to_tablerow(phase)];
+            const short* d      = data + phase.index();
+            buf[i] = amp * (coeffs[0] * (float)d[-3]
+               + coeffs[1] * (float)d[-2]
+               + coeffs[2] * (float)d[-1]
+               + coeffs[3] * (float)d[0]
+               + coeffs[4] * (float)d[1]
+               + coeffs[5] * (float)d[2]
+               + coeffs[6] * (float)d[3]);
+            phase += incr;
+            amp   += ampIncr;
+            }
+      return i;
+      }
+
+const DspKernels scalarDspKernels = {
+      "scalar", mixScalar, mix2Scalar, interpolate4Scalar, interpolate7Scalar
+      };
+
+DspKernels dspKernels = scalarDspKernels;
+
+#ifdef __SSE2__
+
+//---------------------------------------------------------
+//   sinc8
+//    sinc_table7 padded for two four sample loads at
+//    index-3 and index; the second load starts with the
+//    center sample again, so its first coefficient is 0
+//---------------------------------------------------------
+
+static float sinc8[FLUID_INTERP_MAX][8] __attribute__((aligned(16)));
+
+//---------------------------------------------------------
+//   load4
+//    four 16 bit samples as float
+//---------------------------------------------------------
+
+static inline __m128 load4(const short* p)
+      {
+      __m128i v = _mm_loadl_epi64((const __m128i*)p);
+      return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+      }
+
+//---------------------------------------------------------
+//   ampRamp
+//    amp for four consecutive output samples
+//---------------------------------------------------------
+
+static inline __m128 ampRamp(float amp, float ampIncr)
+      {
+      return _mm_add_ps(_mm_set1_ps(amp),
+         _mm_mul_ps(_mm_set1_ps(ampIncr), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)));
+      }
+
+//---------------------------------------------------------
+//   sum4
+//    horizontal sums of s0..s3
+//---------------------------------------------------------
+
+static inline __m128 sum4(__m128 s0, __m128 s1, __m128 s2, __m128 s3)
+      {
+      _MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+      return _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3));
+      }
+
+//---------------------------------------------------------
+//   mixSse
+//---------------------------------------------------------
+
+static void mixSse(float* dst, const float* src, float gain, unsigned n)
+      {
+      __m128 g = _mm_set1_ps(gain);
+      unsigned i = 0;
+      for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(g, _mm_loadu_ps(src + i))));
+      for (; i < n; ++i)
+            dst[i] += gain * src[i];
+      }
+
+//---------------------------------------------------------
+//   mix2Sse
+//---------------------------------------------------------
+
+static void mix2Sse(float* dst1, float gain1, float* dst2, float gain2, const float* src, unsigned n)
+      {
+      __m128 g1 = _mm_set1_ps(gain1);
+      __m128 g2 = _mm_set1_ps(gain2);
+      unsigned i = 0;
+      for (; i + 4 <= n; i += 4) {
+            __m128 v = _mm_loadu_ps(src + i);
+            _mm_storeu_ps(dst1 + i, _mm_add_ps(_mm_loadu_ps(dst1 + i), _mm_mul_ps(g1, v)));
+            _mm_storeu_ps(dst2 + i, _mm_add_ps(_mm_loadu_ps(dst2 + i), _mm_mul_ps(g2, v)));
+            }
+      for (; i < n; ++i) {
+            float v = src[i];
+            dst1[i] += gain1 * v;
+            dst2[i] += gain2 * v;
+            }
+      }
+
+//---------------------------------------------------------
+//   interpolate4Sse
+//    four output samples per step
+//---------------------------------------------------------
+
+static unsigned interpolate4Sse(float* buf, unsigned i, unsigned n, const short* data,
+   Phase& phase, const Phase& incr, float& amp, float ampIncr, unsigned endIndex)
+      {
+      while (i + 4 <= n) {
+            Phase p0(phase);
+            Phase p1(p0); p1 += incr;
+            Phase p2(p1); p2 += incr;
+            Phase p3(p2); p3 += incr;
+            if (unsigned(p3.index()) > endIndex)
+                  break;
+            __m128 s0 = _mm_mul_ps(load4(data + p0.index() - 1),
+               _mm_loadu_ps(Voice::interp_coeff[fluid_phase_fract_to_tablerow(p0)]));
+            __m128 s1 = _mm_mul_ps(load4(data + p1.index() - 1),
+               _mm_loadu_ps(Voice::interp_coeff[fluid_phase_fract_to_tablerow(p1)]));
+            __m128 s2 = _mm_mul_ps(load4(data + p2.index() - 1),
+               _mm_loadu_ps(Voice::interp_coeff[fluid_phase_fract_to_tablerow(p2)]));
+            __m128 s3 = _mm_mul_ps(load4(data + p3.index() - 1),
+               _mm_loadu_ps(Voice::interp_coeff[fluid_phase_fract_to_tablerow(p3)]));
+            _mm_storeu_ps(buf + i, _mm_mul_ps(ampRamp(amp, ampIncr), sum4(s0, s1, s2, s3)));
+            phase = p3;
+            phase += incr;
+            amp   += 4.0f * ampIncr;
+            i     += 4;
+            }
+      return interpolate4Scalar(buf, i, n, data, phase, incr, amp, ampIncr, endIndex);
+      }
+
+//---------------------------------------------------------
+//   dot7
+//---------------------------------------------------------
+
+static inline __m128 dot7(const short* data, const Phase& p)
+      {
+      const float* c = sinc8[fluid_phase_fract_to_tablerow(p)];
+      const short* d = data + p.index();
+      return _mm_add_ps(_mm_mul_ps(load4(d - 3), _mm_load_ps(c)),
+         _mm_mul_ps(load4(d), _mm_load_ps(c + 4)));
+      }
+
+//---------------------------------------------------------
+//   interpolate7Sse
+//    four output samples per step
+//---------------------------------------------------------
+
+static unsigned interpolate7Sse(float* buf, unsigned i, unsigned n, const short* data,
+   Phase& phase, const Phase& incr, float& amp, float ampIncr, unsigned endIndex)
+      {
+      while (i + 4 <= n) {
+            Phase p0(phase);
+            Phase p1(p0); p1 += incr;
+            Phase p2(p1); p2 += incr;
+            Phase p3(p2); p3 += incr;
+            if (unsigned(p3.index()) > endIndex)
+                  break;
+            __m128 s = sum4(dot7(data, p0), dot7(data, p1), dot7(data, p2), dot7(data, p3));
+            _mm_storeu_ps(buf + i, _mm_mul_ps(ampRamp(amp, ampIncr), s));
+            phase = p3;
+            phase += incr;
+            amp   += 4.0f * ampIncr;
+            i     += 4;
+            }
+      return interpolate7Scalar(buf, i, n, data, phase, incr, amp, ampIncr, endIndex);
+      }
+
+#endif
+
+//---------------------------------------------------------
+//   cpuHasAvx
+//    the cpu supports avx and the os saves the ymm
+//    registers
+//---------------------------------------------------------
+
+static bool cpuHasAvx()
+      {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+      unsigned a, b, c, d;
+      if (!__get_cpuid(1, &a, &b, &c, &d))
+            return false;
+      if (!(c & (1 << 27)) || !(c & (1 << 28)))     // osxsave, avx
+            return false;
+      unsigned lo, hi;
+      __asm__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+      return (lo & 6) == 6;
+#else
+      return false;
+#endif
+      }
+
+//---------------------------------------------------------
+//   initDspKernels
+//    select the fastest kernels the cpu supports;
+//    called once after the interpolation tables are
+//    initialized
+//---------------------------------------------------------
+
+void initDspKernels()
+      {
+      dspKernels = scalarDspKernels;
+#ifdef __SSE2__
+      for (int i = 0; i < FLUID_INTERP_MAX; ++i) {
+            for (int k = 0; k < 4; ++k)
+                  sinc8[i][k] = Voice::sinc_table7[i][k];
+            sinc8[i][4] = 0.0;
+            for (int k = 4; k < 7; ++k)
+                  sinc8[i][k+1] = Voice::sinc_table7[i][k];
+            }
+      dspKernels.name         = "sse2";
+      dspKernels.mix          = mixSse;
+      dspKernels.mix2         = mix2Sse;
+      dspKernels.interpolate4 = interpolate4Sse;
+      dspKernels.interpolate7 = interpolate7Sse;
+#endif
+      if (cpuHasAvx())
+            avxDspKernels(&dspKernels);
+      }
+}
+
@@ -0,0 +1,81 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA
+ */
+
+#ifndef _FLUID_SIMD_H
+#define _FLUID_SIMD_H
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace FluidS {
+
+struct Phase;
+
+//---------------------------------------------------------
+//   DspKernels
+//    inner loops of voice rendering and mixing
+//
+//    interpolate4/7 render the part of a voice buffer
+//    which needs no special handling of loop or sample
+//    ends: they fill buf from index i while i < n and
+//    the phase index is <= endIndex and return the new i
+//---------------------------------------------------------
+
+struct DspKernels {
+      const char* name;
+
+      // dst[i] += gain * src[i]
+      void (*mix)(float* dst, const float* src, float gain, unsigned n);
+      // dst1[i] += gain1 * src[i], dst2[i] += gain2 * src[i]
+      void (*mix2)(float* dst1, float gain1, float* dst2, float gain2, const float* src, unsigned n);
+
+      unsigned (*interpolate4)(float* buf, unsigned i, unsigned n, const short* data,
+         Phase& phase, const Phase& incr, float& amp, float ampIncr, unsigned endIndex);
+      unsigned (*interpolate7)(float* buf, unsigned i, unsigned n, const short* data,
+         Phase& phase, const Phase& incr, float& amp, float ampIncr, unsigned endIndex);
+      };
+
+extern DspKernels dspKernels;
+extern const DspKernels scalarDspKernels;
+
+extern void initDspKernels();
+extern bool avxDspKernels(DspKernels*);
+
+//---------------------------------------------------------
+//   DenormalGuard
+//    flush denormal results of sse arithmetic to zero while
+//    in scope; the recursive filters of voices and reverb
+//    decay into denormals which are very slow on x86
+//---------------------------------------------------------
+
+class DenormalGuard {
+#ifdef __SSE__
+      unsigned int mxcsr;
+
+   public:
+      DenormalGuard()  { mxcsr = _mm_getcsr(); _mm_setcsr(mxcsr | 0x8000); }     // FTZ
+      ~DenormalGuard() { _mm_setcsr(mxcsr); }
+#endif
+      };
+}
+
+#endif
+
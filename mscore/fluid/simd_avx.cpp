@@ -0,0 +1,99 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License
+ * as published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307, USA
+ */
+
+//
+//    avx versions of the mixing kernels
+//
+//    On x86 this file is built with -mavx into its own library
+//    without the precompiled header: its code must only be
+//    reached after initDspKernels() found avx support, so it
+//    must not instantiate inline functions or static objects of
+//    other headers; the linker could pick the avx instances for
+//    the whole program.
+//
+
+#include "simd.h"
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+namespace FluidS {
+
+#ifdef __AVX__
+
+//---------------------------------------------------------
+//   mixAvx
+//---------------------------------------------------------
+
+static void mixAvx(float* dst, const float* src, float gain, unsigned n)
+      {
+      __m256 g = _mm256_set1_ps(gain);
+      unsigned i = 0;
+      for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i),
+               _mm256_mul_ps(g, _mm256_loadu_ps(src + i))));
+      for (; i < n; ++i)
+            dst[i] += gain * src[i];
+      }
+
+//---------------------------------------------------------
+//   mix2Avx
+//---------------------------------------------------------
+
+static void mix2Avx(float* dst1, float gain1, float* dst2, float gain2, const float* src, unsigned n)
+      {
+      __m256 g1 = _mm256_set1_ps(gain1);
+      __m256 g2 = _mm256_set1_ps(gain2);
+      unsigned i = 0;
+      for (; i + 8 <= n; i += 8) {
+            __m256 v = _mm256_loadu_ps(src + i);
+            _mm256_storeu_ps(dst1 + i, _mm256_add_ps(_mm256_loadu_ps(dst1 + i), _mm256_mul_ps(g1, v)));
+            _mm256_storeu_ps(dst2 + i, _mm256_add_ps(_mm256_loadu_ps(dst2 + i), _mm256_mul_ps(g2, v)));
+            }
+      for (; i < n; ++i) {
+            float v = src[i];
+            dst1[i] += gain1 * v;
+            dst2[i] += gain2 * v;
+            }
+      }
+
+#endif
+
+//---------------------------------------------------------
+//   avxDspKernels
+//    install the avx kernels; returns false if this file
+//    was not compiled for avx
+//---------------------------------------------------------
+
+bool avxDspKernels(DspKernels* k)
+      {
+#ifdef __AVX__
+      k->name = "avx";
+      k->mix  = mixAvx;
+      k->mix2 = mix2Avx;
+      return true;
+#else
+      (void)k;
+      return false;
+#endif
+      }
+}
+
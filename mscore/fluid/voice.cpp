@@ -23,6 +23,7 @@
 #include "sfont.h"
 #include "gen.h"
 #include "voice.h"
+#include "simd.h"
 
 namespace FluidS {
 
@@ -1725,29 +1726,21 @@ void Voice::effects(int count, float* left, float* right, float* reverb, float*
        */
       if ((-0.5 < pan) && (pan < 0.5)) {
             /* The voice is centered. Use amp_left twice. */
-            for (int i = 0; i < count; i++) {
-                  float v = amp_left * dsp_buf[i];
-                  left[i]  += v;
-                  right[i] += v;
-                  }
+            dspKernels.mix2(left, amp_left, right, amp_left, dsp_buf, count);
             }
       else {     /* The voice is not centered. Stereo samples have one side zero. */
-            if (amp_left != 0.0) {
-                  for (int i = 0; i < count; i++)
-                        left[i] += amp_left * dsp_buf[i];
-                  }
-
-            if (amp_right != 0.0) {
-                  for (int i = 0; i < count; i++)
-                        right[i] += amp_right * dsp_buf[i];
-                  }
+            if (amp_left != 0.0)
+                  dspKernels.mix(left, dsp_buf, amp_left, count);
+            if (amp_right != 0.0)
+                  dspKernels.mix(right, dsp_buf, amp_right, count);
             }
 
-      for (int i = 0; i < count; i++) {
-            float v = dsp_buf[i];
-            reverb[i] += amp_reverb * v;
-            chorus[i] += amp_chorus * v;
-            }
+      if (amp_reverb != 0.0 && amp_chorus != 0.0)
+            dspKernels.mix2(reverb, amp_reverb, chorus, amp_chorus, dsp_buf, count);
+      else if (amp_reverb != 0.0)
+            dspKernels.mix(reverb, dsp_buf, amp_reverb, count);
+      else if (amp_chorus != 0.0)
+            dspKernels.mix(chorus, dsp_buf, amp_chorus, count);
       }
 
 }
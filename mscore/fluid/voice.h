@@ -63,16 +63,17 @@ enum fluid_voice_envelope_index_t {
 
 class Voice
       {
-      static float interp_coeff_linear[FLUID_INTERP_MAX][2];
-      static float interp_coeff[FLUID_INTERP_MAX][4];
-      static float sinc_table7[FLUID_INTERP_MAX][7];
-
       Fluid* _fluid;
       double _noteTuning;             // +/- in midicent
 
       void effects(int count, float* left, float* right, float* reverb, float* chorus);
 
    public:
+      // interpolation tables, also used by the simd kernels
+      static float interp_coeff_linear[FLUID_INTERP_MAX][2];
+      static float interp_coeff[FLUID_INTERP_MAX][4];
+      static float sinc_table7[FLUID_INTERP_MAX][7];
+
 	unsigned int id;                // the id is incremented for every new noteon.
 					        // it's used for noteoff's
 	unsigned char status;
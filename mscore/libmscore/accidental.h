@@ -58,6 +58,7 @@ class Accidental : public Element {
       Accidental(Score* s);
       virtual Accidental* clone() const     { return new Accidental(*this); }
       virtual ElementType type() const      { return ACCIDENTAL; }
+      ELEMENT_POOL(ACCIDENTAL)
       virtual const QString subtypeName() const;
       const char* subtypeUserName() const;
       virtual void setSubtype(const QString& s);
@@ -239,10 +239,10 @@ void Articulation::write(Xml& xml) const
             xml.tagE(QString("channel name=\"%1\"").arg(_channelName));
       switch(_direction) {
             case UP:
-                  xml.tag("direction", QVariant("up"));
+                  xml.tag("direction", "up");
                   break;
             case DOWN:
-                  xml.tag("direction", QVariant("down"));
+                  xml.tag("direction", "down");
                   break;
             case AUTO:
                   break;
@@ -68,6 +68,7 @@ class Articulation : public Element {
 
       virtual Articulation* clone() const   { return new Articulation(*this); }
       virtual ElementType type() const      { return ARTICULATION; }
+      ELEMENT_POOL(ARTICULATION)
 
       virtual void setSubtype(int);
       virtual const QString subtypeName() const;
@@ -1160,10 +1160,10 @@ void Beam::write(Xml& xml) const
       Element::writeProperties(xml);
       switch(_direction) {
             case UP:
-                  xml.tag("StemDirection", QVariant("up"));
+                  xml.tag("StemDirection", "up");
                   break;
             case DOWN:
-                  xml.tag("StemDirection", QVariant("down"));
+                  xml.tag("StemDirection", "down");
                   break;
             case AUTO:
                   break;
@@ -85,6 +85,7 @@ class Beam : public Element {
       ~Beam();
       virtual Beam* clone() const         { return new Beam(*this); }
       virtual ElementType type() const    { return BEAM; }
+      ELEMENT_POOL(BEAM)
       virtual QPointF pagePos() const;  ///< position in page coordinates
 
       virtual bool isEditable() const { return true; }
@@ -18,48 +18,16 @@
 #include "element.h"
 
 //---------------------------------------------------------
-//   InsertItemBspTreeVisitor
+//   intersects
+//    like QRectF::intersects() but also true for
+//    empty rectangles (lines)
 //---------------------------------------------------------
 
-class InsertItemBspTreeVisitor : public BspTreeVisitor
+static inline bool intersects(const QRectF& a, const QRectF& b)
       {
-   public:
-      const Element* item;
-
-      inline void visit(QList<const Element*> *items) { items->prepend(item); }
-      };
-
-//---------------------------------------------------------
-//   RemoveItemBspTreeVisitor
-//---------------------------------------------------------
-
-class RemoveItemBspTreeVisitor : public BspTreeVisitor
-      {
-   public:
-      const Element* item;
-
-      inline void visit(QList<const Element*> *items) { items->removeAll(item); }
-      };
-
-//---------------------------------------------------------
-//   FindItemBspTreeVisitor
-//---------------------------------------------------------
-
-class FindItemBspTreeVisitor : public BspTreeVisitor
-      {
-   public:
-      QList<const Element*>* foundItems;
-
-      void visit(QList<const Element*>* items) {
-            for (int i = 0; i < items->size(); ++i) {
-                  const Element* item = items->at(i);
-                  if (!item->itemDiscovered) {
-                        item->itemDiscovered = 1;
-                        foundItems->prepend(item);
-                        }
-                  }
-            }
-      };
+      return a.left() <= b.right() && a.right() >= b.left()
+         && a.top() <= b.bottom() && a.bottom() >= b.top();
+      }
 
 //---------------------------------------------------------
 //   BspTree
@@ -68,17 +36,9 @@ class FindItemBspTreeVisitor : public BspTreeVisitor
 BspTree::BspTree()
    : leafCnt(0)
       {
-      insertVisitor = new InsertItemBspTreeVisitor;
-      removeVisitor = new RemoveItemBspTreeVisitor;
-      findVisitor   = new FindItemBspTreeVisitor;
-      depth = 0;
-      }
-
-BspTree::~BspTree()
-      {
-      delete insertVisitor;
-      delete removeVisitor;
-      delete findVisitor;
+      depth        = 0;
+      stamp        = 0;
+      removedItems = 0;
       }
 
 //---------------------------------------------------------
@@ -92,18 +52,23 @@ static inline int intmaxlog(int n)
 
 //---------------------------------------------------------
 //   initialize
+//    n - expected number of items
 //---------------------------------------------------------
 
 void BspTree::initialize(const QRectF& rect, int n)
       {
+      clear();
       depth      = intmaxlog(n);
       this->rect = rect;
-      leafCnt    = 0;
 
       nodes.resize((1 << (depth+1)) - 1);
-      leaves.resize(1 << depth);
-      leaves.fill(QList<const Element*>());
       initialize(rect, depth, 0);
+      leafStart.fill(0, leafCnt + 1);
+
+      itemRects.reserve(n);
+      itemElements.reserve(n);
+      itemGroups.reserve(n);
+      itemStamps.reserve(n);
       }
 
 //---------------------------------------------------------
@@ -114,17 +79,41 @@ void BspTree::clear()
       {
       leafCnt = 0;
       nodes.clear();
-      leaves.clear();
+      itemRects.clear();
+      itemElements.clear();
+      itemGroups.clear();
+      itemStamps.clear();
+      leafStart.clear();
+      leafItems.clear();
+      pending.clear();
+      stamp        = 0;
+      removedItems = 0;
       }
 
 //---------------------------------------------------------
 //   insert
+//    group is an arbitrary key which allows to remove
+//    all items of a group at once (see removeGroup())
+//---------------------------------------------------------
+
+void BspTree::insert(const Element* element, const void* group)
+      {
+      pending.append(itemElements.size());
+      itemRects.append(element->abbox());
+      itemElements.append(element);
+      itemGroups.append(group);
+      itemStamps.append(0);
+      }
+
+//---------------------------------------------------------
+//   removeItem
 //---------------------------------------------------------
 
-void BspTree::insert(const Element* element)
+void BspTree::removeItem(int item)
       {
-      insertVisitor->item = element;
-      climbTree(insertVisitor, element->abbox());
+      itemElements[item] = 0;
+      itemGroups[item]   = 0;
+      ++removedItems;
       }
 
 //---------------------------------------------------------
@@ -133,29 +122,107 @@ void BspTree::insert(const Element* element)
 
 void BspTree::remove(const Element* element)
       {
-      removeVisitor->item = element;
-      climbTree(removeVisitor, element->abbox());
+      const Element** el = itemElements.data();
+      int n = itemElements.size();
+      for (int i = 0; i < n; ++i) {
+            if (el[i] == element)
+                  removeItem(i);
+            }
       }
 
 //---------------------------------------------------------
-//   remove
+//   removeGroup
 //---------------------------------------------------------
 
-#if 0
-void BspTree::remove(const QSet<const Element*>& items)
+void BspTree::removeGroup(const void* group)
       {
-      for (int i = 0; i < leaves.size(); ++i) {
-            QList<const Element*> newItemList;
-            QList<const Element*>& oldItemList = leaves[i];
-            for (int j = 0; j < oldItemList.size(); ++j) {
-                  const Element* item = oldItemList.at(j);
-                  if (!items.contains(item))
-                        newItemList << item;
+      const void** gl = itemGroups.data();
+      int n = itemGroups.size();
+      for (int i = 0; i < n; ++i) {
+            if (gl[i] == group && itemElements[i])
+                  removeItem(i);
+            }
+      }
+
+//---------------------------------------------------------
+//   needPack
+//    pending items are searched linearly; repack if
+//    there are too many of them or too many holes
+//---------------------------------------------------------
+
+bool BspTree::needPack() const
+      {
+      int n = itemElements.size();
+      return (pending.size() > 32 + n / 16) || (removedItems > 32 + n / 2);
+      }
+
+//---------------------------------------------------------
+//   pack
+//    drop removed items and sort all items into the leaves
+//---------------------------------------------------------
+
+void BspTree::pack()
+      {
+      if (nodes.isEmpty())
+            return;
+      if (removedItems) {
+            int n = 0;
+            for (int i = 0; i < itemElements.size(); ++i) {
+                  if (itemElements[i] == 0)
+                        continue;
+                  itemRects[n]    = itemRects[i];
+                  itemElements[n] = itemElements[i];
+                  itemGroups[n]   = itemGroups[i];
+                  ++n;
+                  }
+            itemRects.resize(n);
+            itemElements.resize(n);
+            itemGroups.resize(n);
+            removedItems = 0;
+            }
+      int n = itemElements.size();
+      itemStamps.fill(0, n);
+      stamp = 0;
+
+      //
+      // collect (leaf, item) pairs and count items per leaf
+      //
+      QVector<int> pairs;
+      pairs.reserve(n * 4);
+      leafStart.fill(0, leafCnt + 1);
+      QVarLengthArray<int, 64> ll;
+      for (int i = 0; i < n; ++i) {
+            ll.clear();
+            findLeaves(&ll, itemRects[i], 0);
+            for (int k = 0; k < ll.size(); ++k) {
+                  pairs.append(ll[k]);
+                  pairs.append(i);
+                  ++leafStart[ll[k] + 1];
                   }
-            leaves[i] = newItemList;
             }
+      for (int i = 0; i < leafCnt; ++i)
+            leafStart[i + 1] += leafStart[i];
+
+      leafItems.resize(leafStart[leafCnt]);
+      QVector<int> fill(leafStart);
+      for (int i = 0; i < pairs.size(); i += 2)
+            leafItems[fill[pairs[i]]++] = pairs[i + 1];
+      pending.clear();
+      }
+
+//---------------------------------------------------------
+//   visitItem
+//---------------------------------------------------------
+
+inline void BspTree::visitItem(QList<const Element*>* foundItems, int item, const QRectF* rect)
+      {
+      if (itemStamps[item] == stamp)
+            return;
+      itemStamps[item] = stamp;
+      const Element* e = itemElements[item];
+      if (e && (rect == 0 || intersects(itemRects[item], *rect)))
+            foundItems->append(e);
       }
-#endif
 
 //---------------------------------------------------------
 //   items
@@ -164,8 +231,24 @@ void BspTree::remove(const QSet<const Element*>& items)
 QList<const Element*> BspTree::items(const QRectF& rect)
       {
       QList<const Element*> tmp;
-      findVisitor->foundItems = &tmp;
-      climbTree(findVisitor, rect);
+      if (nodes.isEmpty())
+            return tmp;
+      if (needPack())
+            pack();
+      if (++stamp == 0) {
+            itemStamps.fill(0);
+            stamp = 1;
+            }
+      QVarLengthArray<int, 64> ll;
+      findLeaves(&ll, rect, 0);
+      const int* li = leafItems.constData();
+      for (int k = 0; k < ll.size(); ++k) {
+            int leaf = ll[k];
+            for (int i = leafStart[leaf]; i < leafStart[leaf + 1]; ++i)
+                  visitItem(&tmp, li[i], &rect);
+            }
+      foreach(int item, pending)
+            visitItem(&tmp, item, &rect);
       return tmp;
       }
 
@@ -175,14 +258,23 @@ QList<const Element*> BspTree::items(const QRectF& rect)
 
 QList<const Element*> BspTree::items(const QPointF& pos)
       {
+      QList<const Element*> l;
+      if (nodes.isEmpty())
+            return l;
+      if (needPack())
+            pack();
+      if (++stamp == 0) {
+            itemStamps.fill(0);
+            stamp = 1;
+            }
       QList<const Element*> tmp;
-      findVisitor->foundItems = &tmp;
-      climbTree(findVisitor, pos);
+      int leaf = findLeaf(pos, 0);
+      for (int i = leafStart[leaf]; i < leafStart[leaf + 1]; ++i)
+            visitItem(&tmp, leafItems[i], 0);
+      foreach(int item, pending)
+            visitItem(&tmp, item, 0);
 
-      QList<const Element*> l;
-      for (int i = 0; i < tmp.size(); ++i) {
-            const Element* e = tmp.at(i);
-            e->itemDiscovered = 0;
+      foreach(const Element* e, tmp) {
             if (e->contains(pos))
                   l.append(e);
             }
@@ -200,11 +292,12 @@ QString BspTree::debug(int index) const
       QString tmp;
       if (node->type == Node::Leaf) {
             QRectF rect = rectForIndex(index);
-            if (!leaves[node->leafIndex].isEmpty()) {
+            int n = leafStart[node->leafIndex + 1] - leafStart[node->leafIndex];
+            if (n) {
                   tmp += QString::fromLatin1("[%1, %2, %3, %4] contains %5 items\n")
                    .arg(rect.left()).arg(rect.top())
                    .arg(rect.width()).arg(rect.height())
-                   .arg(leaves[node->leafIndex].size());
+                   .arg(n);
                   }
             }
       else {
@@ -272,72 +365,59 @@ void BspTree::initialize(const QRectF& rect, int depth, int index)
       }
 
 //---------------------------------------------------------
-//   climbTree
+//   findLeaf
 //---------------------------------------------------------
 
-void BspTree::climbTree(BspTreeVisitor* visitor, const QPointF& pos, int index)
+int BspTree::findLeaf(const QPointF& pos, int index) const
       {
-      if (nodes.isEmpty())
-            return;
-
-      Node* node = &nodes[index];
-      int childIndex = firstChildIndex(index);
+      for (;;) {
+            const Node* node = &nodes[index];
+            int childIndex = firstChildIndex(index);
 
-      switch (node->type) {
-            case Node::Leaf:
-                  visitor->visit(&leaves[node->leafIndex]);
-                  break;
-            case Node::Vertical:
-                  if (pos.x() < node->offset)
-                        climbTree(visitor, pos, childIndex);
-                  else
-                        climbTree(visitor, pos, childIndex + 1);
-                  break;
-            case Node::Horizontal:
-                  if (pos.y() < node->offset)
-                        climbTree(visitor, pos, childIndex);
-                  else
-                        climbTree(visitor, pos, childIndex + 1);
-                  break;
+            switch (node->type) {
+                  case Node::Leaf:
+                        return node->leafIndex;
+                  case Node::Vertical:
+                        index = pos.x() < node->offset ? childIndex : childIndex + 1;
+                        break;
+                  case Node::Horizontal:
+                        index = pos.y() < node->offset ? childIndex : childIndex + 1;
+                        break;
+                  }
             }
       }
 
 //---------------------------------------------------------
-//   climbTree
+//   findLeaves
 //---------------------------------------------------------
 
-void BspTree::climbTree(BspTreeVisitor* visitor, const QRectF& rect, int index)
+void BspTree::findLeaves(QVarLengthArray<int, 64>* leaves, const QRectF& rect, int index) const
       {
-      if (nodes.isEmpty())
-            return;
-
-      Node* node = &nodes[index];
+      const Node* node = &nodes[index];
       int childIndex = firstChildIndex(index);
 
       switch (node->type) {
             case Node::Leaf:
-                  visitor->visit(&leaves[node->leafIndex]);
+                  leaves->append(node->leafIndex);
                   break;
             case Node::Vertical:
                   if (rect.left() < node->offset) {
-                        climbTree(visitor, rect, childIndex);
+                        findLeaves(leaves, rect, childIndex);
                         if (rect.right() >= node->offset)
-                              climbTree(visitor, rect, childIndex + 1);
-                        }
-                  else {
-                        climbTree(visitor, rect, childIndex + 1);
+                              findLeaves(leaves, rect, childIndex + 1);
                         }
+                  else
+                        findLeaves(leaves, rect, childIndex + 1);
                   break;
             case Node::Horizontal:
-                  int childIndex = firstChildIndex(index);
                   if (rect.top() < node->offset) {
-                        climbTree(visitor, rect, childIndex);
+                        findLeaves(leaves, rect, childIndex);
                         if (rect.bottom() >= node->offset)
-                              climbTree(visitor, rect, childIndex + 1);
-                        }
-                  else {
-                        climbTree(visitor, rect, childIndex + 1);
+                              findLeaves(leaves, rect, childIndex + 1);
                         }
+                  else
+                        findLeaves(leaves, rect, childIndex + 1);
+                  break;
             }
       }
 
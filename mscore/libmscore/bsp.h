@@ -17,16 +17,17 @@
 #ifndef __BSP_H__
 #define __BSP_H__
 
-class BspTreeVisitor;
-class InsertItemBspTreeVisitor;
-class RemoveItemBspTreeVisitor;
-class FindItemBspTreeVisitor;
-
 class Element;
 
 //---------------------------------------------------------
 //   BspTree
 //    binary space partitioning
+//
+//    Items are kept in flat arrays indexed by item number.
+//    The leaves store item numbers in one packed array
+//    (compressed rows); items inserted after the last
+//    pack() are kept in a pending list until the next
+//    query repacks the tree.
 //---------------------------------------------------------
 
 class BspTree
@@ -43,37 +44,45 @@ class BspTree
    private:
       uint depth;
       void initialize(const QRectF& rect, int depth, int index);
-      void climbTree(BspTreeVisitor* visitor, const QPointF& pos, int index = 0);
-      void climbTree(BspTreeVisitor* visitor, const QRectF& rect, int index = 0);
-
-      void findItems(QList<const Element*>* foundItems, const QRectF& rect, int index);
-      void findItems(QList<const Element*>* foundItems, const QPointF& pos, int index);
+      void findLeaves(QVarLengthArray<int, 64>* leaves, const QRectF& rect, int index) const;
+      int findLeaf(const QPointF& pos, int index) const;
+      void visitItem(QList<const Element*>* foundItems, int item, const QRectF* rect);
+      void removeItem(int item);
       QRectF rectForIndex(int index) const;
 
       QVector<Node> nodes;
-      QVector<QList<const Element*> > leaves;
       int leafCnt;
       QRectF rect;
 
-      InsertItemBspTreeVisitor* insertVisitor;
-      RemoveItemBspTreeVisitor* removeVisitor;
-      FindItemBspTreeVisitor* findVisitor;
+      QVector<QRectF> itemRects;          // bounding box at insertion time
+      QVector<const Element*> itemElements;     // zero if removed
+      QVector<const void*> itemGroups;
+      QVector<uint> itemStamps;           // query stamp to filter duplicates
+      uint stamp;
+      int removedItems;
+
+      QVector<int> leafStart;             // items of leaf i are leafItems[leafStart[i]]
+      QVector<int> leafItems;             //    up to leafItems[leafStart[i+1]-1]
+      QVector<int> pending;               // items not yet in leafItems
+
+      bool needPack() const;
 
    public:
       BspTree();
-      ~BspTree();
 
       void initialize(const QRectF& rect, int depth);
       void clear();
+      void pack();
 
-      void insert(const Element* item);
+      void insert(const Element* item, const void* group = 0);
       void remove(const Element* item);
-//      void remove(const QSet<const Element*>& items);
+      void removeGroup(const void* group);
 
       QList<const Element*> items(const QRectF& rect);
       QList<const Element*> items(const QPointF& pos);
 
       int leafCount() const                       { return leafCnt; }
+      int itemCount() const                       { return itemElements.size() - removedItems; }
       inline int firstChildIndex(int index) const { return index * 2 + 1; }
 
       inline int parentIndex(int index) const {
@@ -83,15 +92,4 @@ class BspTree
       QString debug(int index) const;
       };
 
-//---------------------------------------------------------
-//   BspTreeVisitor
-//---------------------------------------------------------
-
-class BspTreeVisitor
-      {
-   public:
-      virtual ~BspTreeVisitor() {}
-      virtual void visit(QList<const Element*>* items) = 0;
-      };
-
 #endif
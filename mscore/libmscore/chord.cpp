@@ -637,8 +637,8 @@ void Chord::write(Xml& xml) const
       if (_hook && (!_hook->visible() || !_hook->userOff().isNull() || (_hook->color() != MScore::defaultColor)))
             _hook->write(xml);
       switch(_stemDirection) {
-            case UP:   xml.tag("StemDirection", QVariant("up")); break;
-            case DOWN: xml.tag("StemDirection", QVariant("down")); break;
+            case UP:   xml.tag("StemDirection", "up"); break;
+            case DOWN: xml.tag("StemDirection", "down"); break;
             case AUTO: break;
             }
       foreach (const Note* n, _notes)
@@ -66,6 +66,7 @@ class LedgerLine : public Line {
       LedgerLine &operator=(const LedgerLine&);
       virtual LedgerLine* clone() const { return new LedgerLine(*this); }
       virtual ElementType type() const  { return LEDGER_LINE; }
+      ELEMENT_POOL(LEDGER_LINE)
       virtual QPointF pagePos() const;      ///< position in page coordinates
       Chord* chord() const { return (Chord*)parent(); }
       virtual void layout();
@@ -117,6 +118,7 @@ class Chord : public ChordRest {
 
       virtual void setScore(Score* s);
       virtual ElementType type() const { return CHORD; }
+      ELEMENT_POOL(CHORD)
 
       virtual void write(Xml& xml) const;
       void read(QDomElement, const QList<Tuplet*>&, QList<Slur*>*);
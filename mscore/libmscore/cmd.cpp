@@ -148,8 +148,12 @@ void Score::end1()
             _updateAll = true;
             _needLayout = true;
             }
-      if (_needLayout)
-            doLayout();
+      if (_needLayout) {
+            if (layoutAll || !doLayoutRange())
+                  doLayout();
+            }
+      else
+            rebuildBspTree();       // elements may have been moved (dragged) without relayout
       if (_updateAll) {
             foreach(MuseScoreView* v, viewer)
                   v->updateAll();
@@ -165,6 +169,7 @@ void Score::end1()
       layoutAll   = false;
       _updateAll  = false;
       startLayout = 0;
+      endLayout   = 0;
       }
 
 //---------------------------------------------------------
@@ -371,6 +376,7 @@ printf("add pitch %d %d\n", pitch, addFlag);
             duration = _is.cr()->duration();
       else
             duration = _is.duration().fraction();
+      setLayoutAll(false);    // only the measures touched by setNoteRest() need relayout
       Segment* seg   = setNoteRest(_is.segment(), track, nval, duration, stemDirection);
       Note* note     = 0;
       if (seg) {
@@ -414,6 +420,7 @@ printf("add pitch %d %d\n", pitch, addFlag);
 void Score::cmdAddInterval(int val, const QList<Note*>& nl)
       {
       startCmd();
+      setLayoutAll(false);
       foreach(Note* on, nl) {
             Note* note = new Note(*on);
             Chord* chord = on->chord();
@@ -16,6 +16,7 @@
 
 #include "xml.h"
 #include "mscore.h"
+#include "pool.h"
 
 /**
  \file
@@ -341,3 +341,38 @@ QString midiMetaName(int meta)
             }
       return QString(s);
       }
+
+//---------------------------------------------------------
+//   lowerBound
+//    return index of first event at or after utick
+//---------------------------------------------------------
+
+int EventTimeline::lowerBound(int utick) const
+      {
+      int lo = 0;
+      int hi = size();
+      const PlayEvent* p = constData();
+      while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (p[mid].utick < utick)
+                  lo = mid + 1;
+            else
+                  hi = mid;
+            }
+      return lo;
+      }
+
+//---------------------------------------------------------
+//   utick
+//    utick of event idx; the end position maps to the
+//    last event
+//---------------------------------------------------------
+
+int EventTimeline::utick(int idx) const
+      {
+      if (isEmpty())
+            return 0;
+      if (idx >= size())
+            idx = size() - 1;
+      return at(idx).utick;
+      }
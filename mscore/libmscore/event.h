@@ -201,6 +201,47 @@ class EventList : public QList<Event> {
 
 class EventMap : public QMap<int, Event> {};
 
+//---------------------------------------------------------
+//   TickEvent
+//    event rendered for one measure, tick without
+//    repeat offset
+//---------------------------------------------------------
+
+struct TickEvent {
+      int tick;
+      Event event;
+      TickEvent() {}
+      TickEvent(int t, const Event& e) : tick(t), event(e) {}
+      };
+
+typedef QVector<TickEvent> TickEventList;
+
+//---------------------------------------------------------
+//   PlayEvent
+//    time is the play time in seconds for a relative
+//    tempo of 1.0, with tempo changes and repeats applied
+//---------------------------------------------------------
+
+struct PlayEvent {
+      int utick;
+      qreal time;
+      Event event;
+      PlayEvent() {}
+      PlayEvent(int t, qreal tm, const Event& e) : utick(t), time(tm), event(e) {}
+      };
+
+//---------------------------------------------------------
+//   EventTimeline
+//    flat playlist sorted by utick; the sequencer only
+//    advances an index into it
+//---------------------------------------------------------
+
+class EventTimeline : public QVector<PlayEvent> {
+   public:
+      int lowerBound(int utick) const;
+      int utick(int idx) const;
+      };
+
 typedef EventList::iterator iEvent;
 typedef EventList::const_iterator ciEvent;
 
@@ -15,34 +15,50 @@
 
 //---------------------------------------------------------
 //   clear
+//    only valid if neither reader nor writer is active
 //---------------------------------------------------------
 
 void FifoBase::clear()
-	{
-	ridx    = 0;
-      widx    = 0;
-      counter = 0;
+      {
+      ridx = 0;
+      widx = 0;
+      pushed.fetchAndStoreRelease(0);
+      popped.fetchAndStoreRelease(0);
+      }
+
+//---------------------------------------------------------
+//   count
+//    number of objects in fifo
+//---------------------------------------------------------
+
+int FifoBase::count() const
+      {
+      // fetchAndAdd(0) is the Qt4 way to load with
+      // acquire semantics
+      int w = const_cast<QAtomicInt&>(pushed).fetchAndAddAcquire(0);
+      int r = const_cast<QAtomicInt&>(popped).fetchAndAddAcquire(0);
+      return int(unsigned(w) - unsigned(r));
       }
 
 //---------------------------------------------------------
 //   push
+//    called by writer after the object at widx is
+//    written
 //---------------------------------------------------------
 
 void FifoBase::push()
       {
       widx = (widx + 1) % maxCount;
-//      q_atomic_increment(&counter);
-      ++counter;
+      pushed.fetchAndAddRelease(1);
       }
 
 //---------------------------------------------------------
 //   pop
+//    called by reader after the object at ridx is read
 //---------------------------------------------------------
 
 void FifoBase::pop()
       {
       ridx = (ridx + 1) % maxCount;
-      // q_atomic_decrement(&counter);
-      --counter;
+      popped.fetchAndAddRelease(1);
       }
-
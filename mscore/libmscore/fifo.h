@@ -14,34 +14,42 @@
 #ifndef __FIFO_H__
 #define __FIFO_H__
 
+static const int FIFO_CACHE_LINE = 64;
+
 //---------------------------------------------------------
 //   FifoBase
-//    - works only for one reader/writer
-//    - reader writes ridx
-//    - writer writes widx
-//    - reader decrements counter
-//    - writer increments counter
-//    - counter increment/decrement must be atomic
+//    lock free single reader/single writer ring buffer
+//    - writer owns widx and counts pushed objects
+//    - reader owns ridx and counts popped objects
+//    - counters are published with release and read
+//      with acquire semantics, so the message slot is
+//      complete before the other side sees it
+//    - reader and writer data live in separate cache
+//      lines
 //---------------------------------------------------------
 
 class FifoBase {
+      char _pad0[FIFO_CACHE_LINE];
 
    protected:
-      int ridx;               // read index
-      int widx;               // write index
-      volatile int counter;   // objects in fifo
       int maxCount;
+      int widx;               // write index
+      QAtomicInt pushed;      // objects written, changed by writer only
+      char _pad1[FIFO_CACHE_LINE];
+      int ridx;               // read index
+      QAtomicInt popped;      // objects read, changed by reader only
+      char _pad2[FIFO_CACHE_LINE];
 
       void push();
       void pop();
 
    public:
-      FifoBase()              { clear(); }
+      FifoBase()              { maxCount = 0; clear(); }
       virtual ~FifoBase()     {}
       void clear();
-      int count() const       { return counter; }
-      bool isEmpty() const    { return counter == 0; }
-      bool isFull() const     { return maxCount == counter; }
+      int count() const;
+      bool isEmpty() const    { return count() == 0; }
+      bool isFull() const     { return count() == maxCount; }
       };
 
 #endif
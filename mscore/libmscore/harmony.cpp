@@ -523,7 +523,7 @@ const ChordDescription* Harmony::descr() const
 
 bool Harmony::isEmpty() const
       {
-      return textList.isEmpty() && doc()->isEmpty();
+      return textList.isEmpty() && Text::isEmpty();
       }
 
 //---------------------------------------------------------
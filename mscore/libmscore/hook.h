@@ -26,6 +26,7 @@ class Hook : public Symbol {
       Hook(Score*);
       virtual Hook* clone() const      { return new Hook(*this); }
       virtual ElementType type() const { return HOOK; }
+      ELEMENT_POOL(HOOK)
       virtual void setSubtype(int v);
       };
 
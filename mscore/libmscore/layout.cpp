@@ -42,6 +42,7 @@
 #include "layoutbreak.h"
 #include "mscore.h"
 #include "accidental.h"
+#include "trace.h"
 
 //---------------------------------------------------------
 //   rebuildBspTree
@@ -355,17 +356,120 @@ void Score::layoutChords1(Segment* segment, int staffIdx)
             }
       }
 
+//---------------------------------------------------------
+//   firstSegmentAt
+//    return first segment of type st in measure m or
+//    in one of the following measures
+//---------------------------------------------------------
+
+static Segment* firstSegmentAt(Measure* m, SegmentTypes st)
+      {
+      Segment* s = m->first();
+      if (s && !(s->subtype() & st))
+            s = s->next1(st);
+      return s;
+      }
+
+//---------------------------------------------------------
+//   beamJoinsPrevious
+//    return true if a beam in measure m is (or will be)
+//    continued from the previous measure
+//---------------------------------------------------------
+
+static bool beamJoinsPrevious(Measure* m, int tracks)
+      {
+      for (int track = 0; track < tracks; ++track) {
+            for (Segment* s = m->first(SegGrace | SegChordRest); s; s = s->next(SegGrace | SegChordRest)) {
+                  ChordRest* cr = static_cast<ChordRest*>(s->element(track));
+                  if (cr == 0)
+                        continue;
+                  if (beamModeMid(cr->beamMode()))
+                        return true;
+                  if (cr->beam() && cr->beam()->elements().front() != cr)
+                        return true;
+                  break;
+                  }
+            }
+      return false;
+      }
+
+//---------------------------------------------------------
+//   StaffLayoutTask
+//    layout stage job for one staff; all staves are
+//    processed in parallel
+//---------------------------------------------------------
+
+struct StaffLayoutTask {
+      Score* score;
+      int staffIdx;
+      Measure* fm;
+      Measure* lm;
+      };
+
+static void layoutStaffStage1(StaffLayoutTask& t)
+      {
+      TRACE("layoutStaffStage1");
+      Measure* stop = t.lm->nextMeasure();
+      for (Measure* m = t.fm; m && m != stop; m = m->nextMeasure())
+            m->layoutStage1(t.staffIdx);
+      }
+
+static void layoutStaffStage2(StaffLayoutTask& t)
+      {
+      TRACE("layoutStaffStage2");
+      t.score->layoutStage2(t.staffIdx, t.fm, t.lm);
+      }
+
+//---------------------------------------------------------
+//   staffLayoutTasks
+//---------------------------------------------------------
+
+static QList<StaffLayoutTask> staffLayoutTasks(Score* score, Measure* fm, Measure* lm)
+      {
+      QList<StaffLayoutTask> tasks;
+      int n = score->nstaves();
+      for (int staffIdx = 0; staffIdx < n; ++staffIdx) {
+            StaffLayoutTask t;
+            t.score    = score;
+            t.staffIdx = staffIdx;
+            t.fm       = fm;
+            t.lm       = lm;
+            tasks.append(t);
+            }
+      return tasks;
+      }
+
+//---------------------------------------------------------
+//   runStaffLayoutTasks
+//    run f for every staff; use the global thread pool
+//    if there is more than one staff
+//---------------------------------------------------------
+
+static void runStaffLayoutTasks(Score* score, Measure* fm, Measure* lm, void (*f)(StaffLayoutTask&))
+      {
+      QList<StaffLayoutTask> tasks = staffLayoutTasks(score, fm, lm);
+      if (tasks.size() > 1 && QThreadPool::globalInstance()->maxThreadCount() > 1)
+            QtConcurrent::blockingMap(tasks, f);
+      else {
+            for (int i = 0; i < tasks.size(); ++i)
+                  f(tasks[i]);
+            }
+      }
+
 //-------------------------------------------------------------------
 //    layoutStage1
 //    - compute note head lines and accidentals
 //    - mark multi measure rest breaks if in multi measure rest mode
+//    only measures fm - lm are processed
 //-------------------------------------------------------------------
 
-void Score::layoutStage1()
+void Score::layoutStage1(Measure* fm, Measure* lm)
       {
-      int idx = 0;
-      for (Measure* m = firstMeasure(); m; m = m->nextMeasure()) {
-            ++idx;
+      TRACE("layoutStage1");
+      runStaffLayoutTasks(this, fm, lm, layoutStaffStage1);
+
+      Measure* stop = lm->nextMeasure();
+      for (Measure* m = fm; m && m != stop; m = m->nextMeasure()) {
             m->layoutStage1();
             foreach(Spanner* spanner, m->spannerFor()) {
                   if (spanner->type() == VOLTA) {
@@ -389,20 +493,34 @@ void Score::layoutStage1()
 //---------------------------------------------------------
 //   layoutStage2
 //    auto - beamer
+//    fm - lm must not be crossed by a beam
 //---------------------------------------------------------
 
-void Score::layoutStage2()
+void Score::layoutStage2(Measure* fm, Measure* lm)
       {
-      int tracks = nstaves() * VOICES;
+      TRACE("layoutStage2");
+      runStaffLayoutTasks(this, fm, lm, layoutStaffStage2);
+      }
 
-      for (int track = 0; track < tracks; ++track) {
+//---------------------------------------------------------
+//   layoutStage2
+//    auto - beamer for all voices of staff staffIdx
+//---------------------------------------------------------
+
+void Score::layoutStage2(int staffIdx, Measure* fm, Measure* lm)
+      {
+      int strack    = staffIdx * VOICES;
+      int etrack    = strack + VOICES;
+      Measure* stop = lm->nextMeasure();
+
+      for (int track = strack; track < etrack; ++track) {
             ChordRest* a1    = 0;      // start of (potential) beam
             Beam* beam       = 0;      // current beam
             Measure* measure = 0;
 
             BeamMode bm = BEAM_AUTO;
             SegmentTypes st = SegGrace | SegChordRest;
-            for (Segment* segment = firstSegment(st); segment; segment = segment->next1(st)) {
+            for (Segment* segment = firstSegmentAt(fm, st); segment && segment->measure() != stop; segment = segment->next1(st)) {
                   ChordRest* cr = static_cast<ChordRest*>(segment->element(track));
                   if (cr == 0)
                         continue;
@@ -572,10 +690,12 @@ void Score::layoutStage2()
 //   layoutStage3
 //---------------------------------------------------------
 
-void Score::layoutStage3()
+void Score::layoutStage3(Measure* fm, Measure* lm)
       {
+      TRACE("layoutStage3");
+      Measure* stop = lm->nextMeasure();
       for (int staffIdx = 0; staffIdx < nstaves(); ++staffIdx) {
-            for (Segment* segment = firstSegment(); segment; segment = segment->next1()) {
+            for (Segment* segment = fm->first(); segment && segment->measure() != stop; segment = segment->next1()) {
                   if ((segment->subtype() == SegChordRest) || (segment->subtype() == SegGrace)) {
                         layoutChords1(segment, staffIdx);
                         }
@@ -592,6 +712,7 @@ void Score::layoutStage3()
 
 void Score::doLayout()
       {
+      TRACE("doLayout");
       {
       QWriteLocker locker(&_layoutLock);
 
@@ -643,15 +764,6 @@ void Score::doLayout()
                   st->setUpdateKeymap(false);
             }
 
-#if 0 // DEBUG
-      if (startLayout) {
-            startLayout->setDirty();
-            if (doReLayout()) {
-                  startLayout = 0;
-                  return;
-                  }
-            }
-#endif
       if (_staves.isEmpty() || first() == 0) {
             // score is empty
             foreach(Page* page, _pages)
@@ -666,27 +778,205 @@ void Score::doLayout()
             return;
             }
 
-      layoutStage1();   // compute note head lines and accidentals
-      layoutStage2();   // beam notes, finally decide if chord is up/down
-      layoutStage3();   // compute note head horizontal positions
+      Measure* fm = firstMeasure();
+      Measure* lm = lastMeasure();
+      if (fm) {
+            layoutStage1(fm, lm);   // compute note head lines and accidentals
+            layoutStage2(fm, lm);   // beam notes, finally decide if chord is up/down
+            layoutStage3(fm, lm);   // compute note head horizontal positions
+            }
 
       layoutSystems();  // create list of systems
       layoutPages();    // create list of pages
 
-      //---------------------------------------------------
-      //   place Spanner & beams
-      //---------------------------------------------------
+      if (fm)
+            layoutSpanner(fm, lm);
+
+      rebuildBspTree();
+
+      }     // unlock mutex
+      foreach(MuseScoreView* v, viewer)
+            v->layoutChanged();
+      }
 
+//---------------------------------------------------------
+//   doLayoutRange
+//    incremental layout of the measures startLayout -
+//    endLayout:
+//    - only the systems containing changed measures are
+//      laid out again; this stops as soon as the system
+//      breaks are the same as in the previous layout
+//    - pages are reflowed starting with the first system
+//      which changed its height
+//    return false if a full layout is needed
+//---------------------------------------------------------
+
+bool Score::doLayoutRange()
+      {
+      TRACE("doLayoutRange");
+      {
+      QWriteLocker locker(&_layoutLock);
+
+      if (layoutFlags
+         || _systems.isEmpty()
+         || styleB(ST_createMultiMeasureRests)
+         || styleB(ST_hideEmptyStaves))
+            return false;
+      foreach(Staff* st, _staves) {
+            if (st->updateKeymap())
+                  return false;
+            }
+      Measure* fm = startLayout;
+      Measure* lm = endLayout;
+
+      //
+      // extend range to whole beams
+      //
       int tracks = nstaves() * VOICES;
-      for (int track = 0; track < tracks; ++track) {
-            for (Segment* segment = firstSegment(); segment; segment = segment->next1()) {
-                  Element* e = segment->element(track);
-                  if (e && e->isChordRest()) {
-                        ChordRest* cr = static_cast<ChordRest*>(e);
+      while (fm->prevMeasure() && beamJoinsPrevious(fm, tracks))
+            fm = fm->prevMeasure();
+      for (Measure* m = lm->nextMeasure(); m && beamJoinsPrevious(m, tracks); m = m->nextMeasure())
+            lm = m;
+
+      int idx = _systems.indexOf(fm->system());
+      if (idx == -1 || !_systems.contains(lm->system()))
+            return false;           // measure was never laid out
+      while (idx > 0 && _systems[idx]->sameLine())
+            --idx;
+
+      layoutStage1(fm, lm);
+      layoutStage2(fm, lm);
+      layoutStage3(fm, lm);
+
+      //
+      // remember old system state to detect what changed
+      //
+      int n = _systems.size();
+      QList<qreal> oldHeight;
+      QList<QPointF> oldPos;
+      QList<QList<Spanner*> > oldSpanner;
+      for (int i = idx; i < n; ++i) {
+            System* system = _systems[i];
+            oldHeight.append(system->height());
+            oldPos.append(system->ipos());
+            QList<Spanner*> sl;
+            foreach(SpannerSegment* ss, system->spannerSegments())
+                  sl.append(ss->spanner());
+            oldSpanner.append(sl);
+            }
+
+      bool inSync = layoutSystems(idx, lm);
+      int end     = inSync ? curSystem : _systems.size();
+
+      //
+      // spanner segments of relayouted systems are gone and have
+      // to be recreated, even if the spanner starts outside of the range
+      //
+      QSet<Spanner*> spanner;
+      for (int i = idx; i < qMin(end, n); ++i) {
+            foreach(Spanner* s, oldSpanner[i - idx])
+                  spanner.insert(s);
+            }
+
+      //
+      // find first system which changed height
+      //
+      int changed = inSync ? -1 : qMin(end, n);
+      for (int i = idx; i < qMin(end, n); ++i) {
+            if (_systems[i]->height() != oldHeight[i - idx]) {
+                  changed = i;
+                  break;
+                  }
+            }
+      for (int i = idx; i < qMin(end, n); ++i)
+            _systems[i]->setPos(oldPos[i - idx]);
+      if (changed != -1) {
+            int pageIdx = -1;
+            if (changed < _systems.size())
+                  pageIdx = _pages.indexOf(_systems[changed]->page());
+            if (pageIdx == -1)            // new system
+                  pageIdx = _pages.size() - 1;
+            layoutPages(qMax(pageIdx, 0));
+            }
+
+      //
+      // place spanner & beams of all relayouted systems
+      //
+      fm = _systems[idx]->firstMeasure() ? _systems[idx]->firstMeasure() : fm;
+      for (int i = end - 1; i >= idx; --i) {
+            Measure* m = _systems[i]->lastMeasure();
+            if (m) {
+                  if (m->tick() > lm->tick())
+                        lm = m;
+                  break;
+                  }
+            }
+      layoutSpanner(fm, lm);
+      foreach(Spanner* s, spanner)
+            s->layout();
+
+      //
+      // if no page was reflowed only the items of the relayouted
+      // systems and of systems with touched spanner change
+      //
+      if (changed != -1)
+            rebuildBspTree();
+      else {
+            QSet<System*> systems;
+            for (int i = idx; i <= end && i < _systems.size(); ++i)
+                  systems.insert(_systems[i]);
+            for (Measure* m = fm; m && m != lm->nextMeasure(); m = m->nextMeasure()) {
+                  foreach(Spanner* s, m->spannerFor())
+                        spanner.insert(s);
+                  for (Segment* seg = m->first(); seg; seg = seg->next()) {
+                        foreach(Spanner* s, seg->spannerFor())
+                              spanner.insert(s);
+                        }
+                  }
+            foreach(Spanner* s, spanner) {
+                  foreach(SpannerSegment* ss, s->spannerSegments()) {
+                        if (ss->system())
+                              systems.insert(ss->system());
+                        }
+                  }
+            foreach(System* system, systems) {
+                  if (system->page())
+                        system->page()->updateBspTree(system);
+                  }
+            }
+
+      }     // unlock mutex
+      foreach(MuseScoreView* v, viewer)
+            v->layoutChanged();
+      return true;
+      }
+
+//---------------------------------------------------------
+//   layoutSpanner
+//    place spanner & beams of measures fm - lm
+//---------------------------------------------------------
+
+void Score::layoutSpanner(Measure* fm, Measure* lm)
+      {
+      TRACE("layoutSpanner");
+      Measure* stop = lm->nextMeasure();
+      int tracks    = nstaves() * VOICES;
+
+      //
+      // walk the segments once and visit the tracks of each segment
+      // in storage order; tracks do not depend on each other here
+      // and the packed type tags spare the virtual type() calls
+      // for empty and uninteresting tracks
+      //
+      for (Segment* segment = fm->first(); segment && segment->measure() != stop; segment = segment->next1()) {
+            for (int track = 0; track < tracks; ++track) {
+                  ElementType type = segment->elementType(track);
+                  if (type == CHORD || type == REST) {
+                        ChordRest* cr = static_cast<ChordRest*>(segment->element(track));
                         if (cr->beam() && cr->beam()->elements().front() == cr)
                               cr->beam()->layout();
 
-                        if (cr->type() == CHORD) {
+                        if (type == CHORD) {
                               Chord* c = static_cast<Chord*>(cr);
                               if (!c->beam())
                                     c->layoutStem();
@@ -699,28 +989,26 @@ void Score::doLayout()
                               }
                         cr->layoutArticulations();
                         }
-                  else if (e && e->type() == BAR_LINE)
-                        e->layout();
-                  if (track == tracks-1) {
-                        foreach(Spanner* s, segment->spannerFor())
-                              s->layout();
-                        foreach(Element* e, segment->annotations())
-                              e->layout();
-                        }
+                  else if (type == BAR_LINE)
+                        segment->element(track)->layout();
                   }
             }
 
-      for (Measure* m = firstMeasure(); m; m = m->nextMeasure()) {
+      //
+      // spanner and annotations need the chords of all tracks
+      //
+      for (Segment* segment = fm->first(); segment && segment->measure() != stop; segment = segment->next1()) {
+            foreach(Spanner* s, segment->spannerFor())
+                  s->layout();
+            foreach(Element* e, segment->annotations())
+                  e->layout();
+            }
+
+      for (Measure* m = fm; m && m != stop; m = m->nextMeasure()) {
             m->layout2();
             foreach(Spanner* s, m->spannerFor())
                   s->layout();
             }
-
-      rebuildBspTree();
-
-      }     // unlock mutex
-      foreach(MuseScoreView* v, viewer)
-            v->layoutChanged();
       }
 
 //---------------------------------------------------------
@@ -1167,123 +1455,6 @@ void Score::remove(Element* el)
             }
       }
 
-//---------------------------------------------------------
-//   reLayout
-//---------------------------------------------------------
-
-void Score::reLayout(Measure* m)
-      {
-//      _needLayout = true;
-      startLayout = m;
-      }
-
-//---------------------------------------------------------
-//   doReLayout
-//    return true, if relayout was successful; if false
-//    a full layout must be done starting at "startLayout"
-//---------------------------------------------------------
-
-bool Score::doReLayout()
-      {
-#if 0
-      if (startLayout->type() == MEASURE)
-            static_cast<Measure*>(startLayout)->layout0();
-#endif
-      System* system  = startLayout->system();
-      qreal sysWidth  = system->width();
-      qreal minWidth = system->leftMargin();
-
-      //
-      //  check if measures still fit in system
-      //
-      MeasureBase* m = 0;
-      foreach(m, system->measures()) {
-            qreal ww;
-            if (m->type() == HBOX)
-                  ww = point(static_cast<Box*>(m)->boxWidth());
-            else {            // MEASURE
-                  Measure* measure = static_cast<Measure*>(m);
-//TODOXX                  measure->layout0();
-//TODO            measure->layoutBeams1();
-
-                  measure->layoutX(1.0);
-                  ww      = measure->layoutWidth().stretchable;
-                  qreal stretch = measure->userStretch() * styleD(ST_measureSpacing);
-
-                  ww *= stretch;
-                  if (ww < point(styleS(ST_minMeasureWidth)))
-                        ww = point(styleS(ST_minMeasureWidth));
-                  }
-            minWidth += ww;
-            }
-      if (minWidth > sysWidth)            // measure does not fit: do full layout
-            return false;
-
-      //
-      // check if another measure will fit into system
-      //
-      m = m->next();
-      if (m && m->subtype() == MEASURE) {
-            Measure* measure = static_cast<Measure*>(m);
-            measure->layoutX(1.0);
-            qreal ww      = measure->layoutWidth().stretchable;
-            qreal stretch = measure->userStretch() * styleD(ST_measureSpacing);
-
-            ww *= stretch;
-            if (ww < point(styleS(ST_minMeasureWidth)))
-                  ww = point(styleS(ST_minMeasureWidth));
-            if ((minWidth + ww) <= sysWidth)    // if another measure fits, do full layout
-                  return false;
-            }
-      //
-      // stretch measures
-      //
-      minWidth    = system->leftMargin();
-      qreal totalWeight = 0.0;
-      foreach (MeasureBase* mb, system->measures()) {
-            if (mb->type() == HBOX)
-                  minWidth += point(static_cast<Box*>(mb)->boxWidth());
-            else {
-                  Measure* m   = static_cast<Measure*>(mb);
-                  minWidth    += m->layoutWidth().stretchable;
-                  totalWeight += m->ticks() * m->userStretch();
-                  }
-            }
-
-      qreal rest = (sysWidth - minWidth) / totalWeight;
-
-      bool firstMeasure = true;
-      QPointF pos;
-      foreach(MeasureBase* mb, system->measures()) {
-            qreal ww = 0.0;
-            if (mb->type() == MEASURE) {
-                  if (firstMeasure) {
-                        pos.rx() += system->leftMargin();
-                        firstMeasure = false;
-                        }
-                  mb->setPos(pos);
-                  Measure* m    = static_cast<Measure*>(mb);
-                  qreal weight = m->ticks() * m->userStretch();
-                  ww            = m->layoutWidth().stretchable + rest * weight;
-                  m->layout(ww);
-                  }
-            else if (mb->type() == HBOX) {
-                  mb->setPos(pos);
-                  ww = point(static_cast<Box*>(mb)->boxWidth());
-                  mb->layout();
-                  }
-            pos.rx() += ww;
-            }
-
-      foreach(MeasureBase* mb, system->measures()) {
-            if (mb->type() == MEASURE)
-                  static_cast<Measure*>(mb)->layout2();
-            }
-
-      rebuildBspTree();
-      return true;
-      }
-
 //---------------------------------------------------------
 //   layoutFingering
 //    - place numbers above a note execpt for the last
@@ -1655,14 +1826,52 @@ QList<System*> Score::layoutSystemRow(qreal rowWidth,
 
 void Score::layoutSystems()
       {
-      curMeasure              = first();
-      curSystem               = 0;
+      layoutSystems(0, 0);
+      }
+
+//---------------------------------------------------------
+//   layoutSystems
+//    create list of systems starting with system idx;
+//    if stop is given, return true as soon as the
+//    measure stop is placed and the following system
+//    starts with the same measure as before
+//---------------------------------------------------------
+
+bool Score::layoutSystems(int idx, Measure* stop)
+      {
+      TRACE("layoutSystems");
+      curSystem               = idx;
       bool firstSystem        = true;
       bool startWithLongNames = true;
 
+      if (idx == 0)
+            curMeasure = first();
+      else {
+            curMeasure = _systems[idx]->measures().front();
+            for (int i = idx - 1; i >= 0; --i) {
+                  if (_systems[i]->isVbox())
+                        continue;
+                  Measure* lm = _systems[i]->lastMeasure();
+                  firstSystem = lm && lm->sectionBreak();
+                  startWithLongNames = firstSystem && lm->sectionBreak()->startWithLongNames();
+                  break;
+                  }
+            }
+
+      QList<MeasureBase*> oldStart;
+      if (stop) {
+            for (int i = idx; i < _systems.size(); ++i)
+                  oldStart.append(_systems[i]->measures().isEmpty() ? 0 : _systems[i]->measures().front());
+            }
+
       qreal w  = pageFormat()->printableWidth() * DPI;
 
       while (curMeasure) {
+            if (stop && (curMeasure->tick() > stop->tick())) {
+                  int i = curSystem - idx;
+                  if (i < oldStart.size() && oldStart[i] == curMeasure && !_systems[curSystem]->sameLine())
+                        return true;
+                  }
             ElementType t = curMeasure->type();
             if (t == VBOX || t == TBOX || t == FBOX) {
                   System* system = getNextSystem(false, true);
@@ -1698,6 +1907,7 @@ void Score::layoutSystems()
       // TODO: make undoable:
       while (_systems.size() > curSystem)
             _systems.takeLast();
+      return false;
       }
 
 //---------------------------------------------------------
@@ -1765,11 +1975,13 @@ struct SystemRow {
 
 //---------------------------------------------------------
 //   layoutPages
-//    create list of pages
+//    create list of pages starting with page startPage;
+//    previous pages are not changed
 //---------------------------------------------------------
 
-void Score::layoutPages()
+void Score::layoutPages(int startPage)
       {
+      TRACE("layoutPages");
       const qreal _spatium            = spatium();
       const qreal slb                 = styleS(ST_staffLowerBorder).val() * _spatium;
       const qreal sub                 = styleS(ST_staffUpperBorder).val() * _spatium;
@@ -1779,7 +1991,15 @@ void Score::layoutPages()
 
       qreal lm, tm, ey;
 
-      curPage            = 0;
+      int startSystem = 0;
+      if (startPage > 0 && startPage < _pages.size() && !_pages[startPage]->systems()->isEmpty())
+            startSystem = _systems.indexOf(_pages[startPage]->systems()->front());
+      if (startSystem <= 0) {
+            startPage   = 0;
+            startSystem = 0;
+            }
+
+      curPage            = startPage;
       Page* page         = getEmptyPage();
 
       lm                 = page->lm();
@@ -1791,7 +2011,7 @@ void Score::layoutPages()
       System* lastSystem = 0;
       int gaps           = 0;
 
-      for (int i = 0; i < nSystems; ++i) {
+      for (int i = startSystem; i < nSystems; ++i) {
             SystemRow sr;
             for (;;) {
                   System* system = _systems[i];
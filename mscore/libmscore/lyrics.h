@@ -42,6 +42,7 @@ class Lyrics : public Text {
       ~Lyrics();
       virtual Lyrics* clone() const    { return new Lyrics(*this); }
       virtual ElementType type() const { return LYRICS; }
+      ELEMENT_POOL(LYRICS)
       virtual QPointF pagePos() const;
       virtual void scanElements(void* data, void (*func)(void*, Element*), bool all=true);
       virtual bool acceptDrop(MuseScoreView*, const QPointF&, int, int) const;
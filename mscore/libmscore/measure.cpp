@@ -75,6 +75,7 @@
 #include "tupletmap.h"
 #include "spannermap.h"
 #include "accidental.h"
+#include "trace.h"
 
 //---------------------------------------------------------
 //   MStaff
@@ -133,6 +134,7 @@ Measure::Measure(Score* s)
       _endBarLineType        = NORMAL_BAR;
       _mmEndBarLineType      = NORMAL_BAR;
       _multiMeasure          = 0;
+      _eventsRevision        = -1;
       }
 
 //---------------------------------------------------------
@@ -165,6 +167,7 @@ Measure::Measure(const Measure& m)
       _multiMeasure          = m._multiMeasure;
       _playbackCount         = m._playbackCount;
       _endBarLineColor       = m._endBarLineColor;
+      _eventsRevision        = -1;
       }
 
 //---------------------------------------------------------
@@ -174,6 +177,7 @@ Measure::Measure(const Measure& m)
 void Measure::setScore(Score* score)
       {
       MeasureBase::setScore(score);
+      invalidateEvents();
       for (Segment* s = first(); s; s = s->next())
             s->setScore(score);
       foreach(Tuplet* t, _tuplets)
@@ -586,7 +590,8 @@ void Measure::layout2()
 Chord* Measure::findChord(int tick, int track, int gl)
       {
       int graces = 0;
-      for (Segment* seg = last(); seg; seg = seg->prev()) {
+      Segment* ns = _segments.lowerBound(tick + 1 - this->tick());    // first segment after tick
+      for (Segment* seg = ns ? ns->prev() : last(); seg; seg = seg->prev()) {
             if (seg->tick() < tick)
                   return 0;
             if (seg->tick() == tick) {
@@ -611,14 +616,13 @@ Chord* Measure::findChord(int tick, int track, int gl)
 
 ChordRest* Measure::findChordRest(int tick, int track)
       {
-      for (Segment* seg = first(); seg; seg = seg->next()) {
+      for (Segment* seg = _segments.lowerBound(tick - this->tick()); seg; seg = seg->next()) {
             if (seg->tick() > tick)
                   return 0;
             if (seg->tick() == tick) {
                   Element* el = seg->element(track);
-                  if (el && (el->type() == CHORD || el->type() == REST)) {
+                  if (el && (el->type() == CHORD || el->type() == REST))
                         return (ChordRest*)el;
-                        }
                   }
             }
       return 0;
@@ -630,7 +634,7 @@ ChordRest* Measure::findChordRest(int tick, int track)
 
 Segment* Measure::tick2segment(int tick, bool grace) const
       {
-      for (Segment* s = first(); s; s = s->next()) {
+      for (Segment* s = _segments.lowerBound(tick - this->tick()); s; s = s->next()) {
             if (s->tick() == tick) {
                   if (grace && (s->segmentType() == SegGrace))
                         return s;
@@ -653,15 +657,7 @@ Segment* Measure::tick2segment(int tick, bool grace) const
 
 Segment* Measure::findSegment(SegmentType st, int t)
       {
-      Segment* s;
-      for (s = first(); s && s->tick() < t; s = s->next())
-            ;
-
-      for (Segment* ss = s; ss && ss->tick() == t; ss = ss->next()) {
-            if (ss->subtype() == st)
-                  return ss;
-            }
-      return 0;
+      return _segments.find(st, t - tick());
       }
 
 //---------------------------------------------------------
@@ -734,8 +730,7 @@ Segment* Measure::getSegment(SegmentType st, int t, int gl)
       Segment* s;
 
       // find the first segment at tick >= t
-      for (s = first(); s && s->tick() < t; s = s->next())
-            ;
+      s = _segments.lowerBound(t - tick());
 
       // find the first SegChordRest segment at tick = t
       // while counting the SegGrace segments
@@ -863,8 +858,7 @@ void Measure::add(Element* el)
                   else {
                         Segment* s;
                         if (st == SegGrace) {
-                              for (s = first(); s && s->tick() < t; s = s->next())
-                                    ;
+                              s = _segments.lowerBound(seg->rtick());
                               if (s && (s->tick() > t)) {
                                     seg->setParent(this);
                                     _segments.insert(seg, s);
@@ -877,8 +871,7 @@ void Measure::add(Element* el)
                                     }
                               }
                         else {
-                              for (s = first(); s && s->tick() < t; s = s->next())
-                                    ;
+                              s = _segments.lowerBound(seg->rtick());
                               if (s) {
                                     if (st == SegChordRest) {
                                           while (s && s->subtype() != st && s->tick() == t) {
@@ -2725,6 +2718,7 @@ static qreal sff(qreal x, qreal xMin, SpringMap& springs)
 
 void Measure::layoutX(qreal stretch)
       {
+      TRACE("Measure::layoutX");
       if (!_dirty && (stretch == 1.0))
             return;
       int nstaves = _score->nstaves();
@@ -3085,65 +3079,76 @@ void Measure::layoutX(qreal stretch)
 
 //---------------------------------------------------------
 //   layoutStage1
+//    compute multi measure rest breaks
 //---------------------------------------------------------
 
 void Measure::layoutStage1()
       {
       setDirty();
-      for (int staffIdx = 0; staffIdx < score()->nstaves(); ++staffIdx) {
-//            KeySigEvent key = score()->staff(staffIdx)->keymap()->key(tick());
-
-            setBreakMMRest(false);
-            if (score()->styleB(ST_createMultiMeasureRests)) {
-                  if ((repeatFlags() & RepeatStart) || (prevMeasure() && (prevMeasure()->repeatFlags() & RepeatEnd)))
-                        setBreakMMRest(true);
-                  else if (!breakMMRest()) {
-                        for (Segment* s = first(); s; s = s->next()) {
-                              foreach(Element* e, s->annotations()) {
-                                    if (
-                                       ((e->type() == TEXT) && (e->subtype() == TEXT_REHEARSAL_MARK))
-                                       || (e->type() == TEMPO_TEXT)
-                                       ) {
-                                          setBreakMMRest(true);
-                                          break;
-                                          }
-                                    }
-                              foreach(Spanner* sp, s->spannerFor()) {
-                                    if (sp->type() == VOLTA) {
-                                          setBreakMMRest(true);
-                                          break;
-                                          }
+      setBreakMMRest(false);
+      if (score()->styleB(ST_createMultiMeasureRests)) {
+            if ((repeatFlags() & RepeatStart) || (prevMeasure() && (prevMeasure()->repeatFlags() & RepeatEnd)))
+                  setBreakMMRest(true);
+            else {
+                  for (Segment* s = first(); s; s = s->next()) {
+                        foreach(Element* e, s->annotations()) {
+                              if (
+                                 ((e->type() == TEXT) && (e->subtype() == TEXT_REHEARSAL_MARK))
+                                 || (e->type() == TEMPO_TEXT)
+                                 ) {
+                                    setBreakMMRest(true);
+                                    break;
                                     }
-                              foreach(Spanner* sp, s->spannerBack()) {
-                                    if (sp->type() == VOLTA) {
-                                          setBreakMMRest(true);
-                                          break;
-                                          }
+                              }
+                        foreach(Spanner* sp, s->spannerFor()) {
+                              if (sp->type() == VOLTA) {
+                                    setBreakMMRest(true);
+                                    break;
                                     }
-                              if (breakMMRest())      // optimize
+                              }
+                        foreach(Spanner* sp, s->spannerBack()) {
+                              if (sp->type() == VOLTA) {
+                                    setBreakMMRest(true);
                                     break;
+                                    }
                               }
+                        if (breakMMRest())      // optimize
+                              break;
                         }
                   }
-
-            int track = staffIdx * VOICES;
-
-            for (Segment* segment = first(); segment; segment = segment->next()) {
+            }
+      if (breakMMRest())
+            return;
+      int tracks = score()->nstaves() * VOICES;
+      for (Segment* segment = first(); segment; segment = segment->next()) {
+            if (segment->subtype() != SegKeySig
+               && segment->subtype() != SegStartRepeatBarLine
+               && segment->subtype() != SegTimeSig)
+                  continue;
+            for (int track = 0; track < tracks; track += VOICES) {
                   Element* e = segment->element(track);
-
-                  if (segment->subtype() == SegKeySig
-                     || segment->subtype() == SegStartRepeatBarLine
-                     || segment->subtype() == SegTimeSig) {
-                        if (e && !e->generated())
-                              setBreakMMRest(true);
+                  if (e && !e->generated()) {
+                        setBreakMMRest(true);
+                        return;
                         }
-
-                  if (segment->subtype() & (SegChordRest | SegGrace))
-                        layoutChords0(segment, staffIdx * VOICES);
                   }
             }
       }
 
+//---------------------------------------------------------
+//   layoutStage1
+//    compute note head lines and stem directions of
+//    staff staffIdx; only elements of this staff are
+//    changed, so staves can be processed in parallel
+//---------------------------------------------------------
+
+void Measure::layoutStage1(int staffIdx)
+      {
+      int track = staffIdx * VOICES;
+      for (Segment* segment = first(SegChordRest | SegGrace); segment; segment = segment->next(SegChordRest | SegGrace))
+            layoutChords0(segment, track);
+      }
+
 //---------------------------------------------------------
 //   updateAccidentals
 //    recompute accidentals,
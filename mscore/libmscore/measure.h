@@ -22,6 +22,7 @@
 #include "measurebase.h"
 #include "fraction.h"
 #include "segmentlist.h"
+#include "event.h"
 
 class Xml;
 class Beam;
@@ -40,6 +41,7 @@ class TieMap;
 class SpannerMap;
 class AccidentalState;
 class Spanner;
+class Part;
 
 //---------------------------------------------------------
 //   MStaff
@@ -126,6 +128,9 @@ class Measure : public MeasureBase {
 
       QColor _endBarLineColor;
 
+      int _eventsRevision;                      // Score::eventsRevision() of _midiEvents
+      QHash<const Part*, TickEventList> _midiEvents;  // rendered events per part
+
       void push_back(Segment* e);
       void push_front(Segment* e);
 
@@ -260,8 +265,11 @@ class Measure : public MeasureBase {
       void layoutChords10(Segment* segment, int startTrack, AccidentalState*);
       void updateAccidentals(Segment* segment, int staffIdx, AccidentalState*);
       void layoutStage1();
+      void layoutStage1(int staffIdx);
       int playbackCount() const      { return _playbackCount; }
       void setPlaybackCount(int val) { _playbackCount = val; }
+      const TickEventList& midiEvents(const Part*);
+      void invalidateEvents()        { _eventsRevision = -1; }
       QRectF staffabbox(int staffIdx) const;
 
       QList<Spanner*> spannerFor() const  { return _spannerFor;        }
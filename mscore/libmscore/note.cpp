@@ -609,8 +609,8 @@ void Note::write(Xml& xml) const
                         _dots[i]->write(xml);
                   }
             switch(_dotPosition) {
-                  case UP:   xml.tag("dotPosition", QVariant("up")); break;
-                  case DOWN: xml.tag("dotPosition", QVariant("down")); break;
+                  case UP:   xml.tag("dotPosition", "up"); break;
+                  case DOWN: xml.tag("dotPosition", "down"); break;
                   case AUTO: break;
                   }
             }
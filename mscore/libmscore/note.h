@@ -64,6 +64,7 @@ class NoteDot : public Symbol {
       NoteDot &operator=(const NoteHead&);
       virtual NoteDot* clone() const  { return new NoteDot(*this); }
       virtual ElementType type() const { return NOTEDOT; }
+      ELEMENT_POOL(NOTEDOT)
       int idx() const      { return _idx; }
       void setIdx(int val) { _idx = val; }
       };
@@ -137,6 +138,7 @@ class Note : public Element {
       ~Note();
       virtual Note* clone() const      { return new Note(*this); }
       virtual ElementType type() const { return NOTE; }
+      ELEMENT_POOL(NOTE)
       virtual QPointF pagePos() const;      ///< position in page coordinates
       virtual QPointF canvasPos() const;    ///< position in page coordinates
       virtual void layout();
@@ -31,6 +31,7 @@
 #include "system.h"
 #include "painter.h"
 #include "mscore.h"
+#include "trace.h"
 
 #define MM(x) ((x)/INCH)
 
@@ -629,24 +630,61 @@ void PageFormat::writeMusicXML(Xml& xml, qreal conversion )
       xml.etag();
       }
 
+//---------------------------------------------------------
+//   collectSystemElements
+//---------------------------------------------------------
+
+void Page::collectSystemElements(System* s, QList<Element*>* el) const
+      {
+      foreach(MeasureBase* m, s->measures())
+            m->scanElements(el, collectElements, false);
+      s->scanElements(el, collectElements, false);
+      }
+
 //---------------------------------------------------------
 //   doRebuildBspTree
+//    items are grouped by system to allow for
+//    updateBspTree()
 //---------------------------------------------------------
 
 void Page::doRebuildBspTree()
       {
+      TRACE("rebuildBspTree");
       QList<Element*> el;
+      QList<int> systemStart;
       foreach(System* s, _systems) {
-            foreach(MeasureBase* m, s->measures()) {
-                  m->scanElements(&el, collectElements, false);
-                  }
+            systemStart.append(el.size());
+            collectSystemElements(s, &el);
             }
-      scanElements(&el, collectElements, false);
+      systemStart.append(el.size());
+      el.append(this);
 
       int n = el.size();
       bspTree.initialize(abbox(), n);
-      for (int i = 0; i < n; ++i)
-            bspTree.insert(el.at(i));
+      for (int i = 0; i < _systems.size(); ++i) {
+            for (int k = systemStart[i]; k < systemStart[i+1]; ++k)
+                  bspTree.insert(el.at(k), _systems[i]);
+            }
+      bspTree.insert(this);
+      bspTree.pack();
+      bspTreeValid = true;
+      }
+
+//---------------------------------------------------------
+//   updateBspTree
+//    replace the items of system s after a partial
+//    relayout which did not move other systems
+//---------------------------------------------------------
+
+void Page::updateBspTree(System* s)
+      {
+      if (!bspTreeValid)
+            return;
+      bspTree.removeGroup(s);
+      QList<Element*> el;
+      collectSystemElements(s, &el);
+      foreach(Element* e, el)
+            bspTree.insert(e, s);
       }
 
 //---------------------------------------------------------
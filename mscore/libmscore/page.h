@@ -109,6 +109,7 @@ class Page : public Element {
 
       QString replaceTextMacros(const QString&) const;
       void doRebuildBspTree();
+      void collectSystemElements(System*, QList<Element*>*) const;
 
    public:
       Page(Score*);
@@ -141,6 +142,7 @@ class Page : public Element {
       QList<const Element*> items(const QRectF& r);
       QList<const Element*> items(const QPointF& p);
       void rebuildBspTree() { bspTreeValid = false; }
+      void updateBspTree(System*);
       virtual QPointF pagePos() const { return QPointF(); }     ///< position in page coordinates
       };
 
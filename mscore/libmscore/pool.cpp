@@ -0,0 +1,162 @@
+//=============================================================================
+//  MuseScore
+//  Music Composition & Notation
+//  $Id:$
+//
+//  Copyright (C) 2011 Werner Schweer
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2
+//  as published by the Free Software Foundation and appearing in
+//  the file LICENCE.GPL
+//=============================================================================
+
+#include "pool.h"
+#include "element.h"
+
+static const int POOL_GRANULE  = 16;            // size class step
+static const int POOL_MAXSIZE  = 512;           // larger objects use the global heap
+static const int POOL_CLASSES  = POOL_MAXSIZE / POOL_GRANULE;
+static const int POOL_CHUNK    = 64 * 1024;
+
+struct FreeItem {
+      FreeItem* next;
+      };
+
+//
+// plain data, zero initialized before any static constructor
+// can create an element
+//
+static FreeItem* freeList[POOL_CLASSES];
+static qint64 curBytes[MAXTYPE];                // bytes in use per element type
+static qint64 maxBytes[MAXTYPE];                // peak of curBytes
+static qint64 totalAllocs[MAXTYPE];             // number of allocations per type
+static qint64 chunkBytes;                       // bytes taken from the heap
+
+//---------------------------------------------------------
+//   poolMutex
+//    elements are also created from parallel layout
+//---------------------------------------------------------
+
+static QMutex* poolMutex()
+      {
+      static QMutex mutex;
+      return &mutex;
+      }
+
+//---------------------------------------------------------
+//   refill
+//    cut a new chunk into items of size class sc
+//---------------------------------------------------------
+
+static void refill(int sc)
+      {
+      int size = (sc + 1) * POOL_GRANULE;
+      int n    = POOL_CHUNK / size;
+      char* p  = static_cast<char*>(::operator new(POOL_CHUNK));
+      chunkBytes += POOL_CHUNK;
+      for (int i = 0; i < n; ++i) {
+            FreeItem* item = reinterpret_cast<FreeItem*>(p + i * size);
+            item->next     = freeList[sc];
+            freeList[sc]   = item;
+            }
+      }
+
+//---------------------------------------------------------
+//   alloc
+//---------------------------------------------------------
+
+void* ElementPool::alloc(size_t size, ElementType type)
+      {
+      QMutexLocker locker(poolMutex());
+      curBytes[type] += size;
+      if (curBytes[type] > maxBytes[type])
+            maxBytes[type] = curBytes[type];
+      ++totalAllocs[type];
+
+      if (size > size_t(POOL_MAXSIZE))
+            return ::operator new(size);
+      int sc = (int(size) - 1) / POOL_GRANULE;
+      if (freeList[sc] == 0)
+            refill(sc);
+      FreeItem* item = freeList[sc];
+      freeList[sc]   = item->next;
+      return item;
+      }
+
+//---------------------------------------------------------
+//   free
+//    memory stays in the pool for reuse
+//---------------------------------------------------------
+
+void ElementPool::free(void* p, size_t size, ElementType type)
+      {
+      if (p == 0)
+            return;
+      QMutexLocker locker(poolMutex());
+      curBytes[type] -= size;
+      if (size > size_t(POOL_MAXSIZE)) {
+            ::operator delete(p);
+            return;
+            }
+      int sc         = (int(size) - 1) / POOL_GRANULE;
+      FreeItem* item = static_cast<FreeItem*>(p);
+      item->next     = freeList[sc];
+      freeList[sc]   = item;
+      }
+
+//---------------------------------------------------------
+//   dumpStatistics
+//---------------------------------------------------------
+
+void ElementPool::dumpStatistics()
+      {
+      QMutexLocker locker(poolMutex());
+      printf("ElementPool: %lld bytes in chunks\n", chunkBytes);
+      printf("  %-20s %12s %12s %12s\n", "type", "allocs", "bytes", "peak bytes");
+      for (int i = 0; i < MAXTYPE; ++i) {
+            if (totalAllocs[i] == 0)
+                  continue;
+            printf("  %-20s %12lld %12lld %12lld\n", Element::name(ElementType(i)),
+               totalAllocs[i], curBytes[i], maxBytes[i]);
+            }
+      }
+
+
+//---------------------------------------------------------
+//   allocations
+//    number of allocations of all element types
+//---------------------------------------------------------
+
+qint64 ElementPool::allocations()
+      {
+      QMutexLocker locker(poolMutex());
+      qint64 n = 0;
+      for (int i = 0; i < MAXTYPE; ++i)
+            n += totalAllocs[i];
+      return n;
+      }
+
+//---------------------------------------------------------
+//   bytesInUse
+//---------------------------------------------------------
+
+qint64 ElementPool::bytesInUse()
+      {
+      QMutexLocker locker(poolMutex());
+      qint64 n = 0;
+      for (int i = 0; i < MAXTYPE; ++i)
+            n += curBytes[i];
+      return n;
+      }
+
+//---------------------------------------------------------
+//   chunkMemory
+//    bytes taken from the heap for pool chunks
+//---------------------------------------------------------
+
+qint64 ElementPool::chunkMemory()
+      {
+      QMutexLocker locker(poolMutex());
+      return chunkBytes;
+      }
@@ -0,0 +1,49 @@
+//=============================================================================
+//  MuseScore
+//  Music Composition & Notation
+//  $Id:$
+//
+//  Copyright (C) 2011 Werner Schweer
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2
+//  as published by the Free Software Foundation and appearing in
+//  the file LICENCE.GPL
+//=============================================================================
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include "mscore.h"
+
+//---------------------------------------------------------
+//   ElementPool
+//    size class allocator for the small score elements
+//    which are created in large numbers (notes, chords,
+//    segments...). Memory is carved from big chunks and
+//    freed objects are kept in per size free lists for
+//    reuse. Also counts bytes per element type.
+//---------------------------------------------------------
+
+class ElementPool {
+   public:
+      static void* alloc(size_t size, ElementType type);
+      static void free(void* p, size_t size, ElementType type);
+      static void dumpStatistics();
+      static qint64 allocations();
+      static qint64 bytesInUse();
+      static qint64 chunkMemory();
+      };
+
+//---------------------------------------------------------
+//   ELEMENT_POOL
+//    route new/delete of an element class through the
+//    ElementPool
+//---------------------------------------------------------
+
+#define ELEMENT_POOL(t) \
+      static void* operator new(size_t size)            { return ElementPool::alloc(size, t); } \
+      static void operator delete(void* p, size_t size) { ElementPool::free(p, size, t);      }
+
+#endif
+
@@ -44,6 +44,7 @@
 #include "tremolo.h"
 #include "noteevent.h"
 #include "segment.h"
+#include "trace.h"
 
 //---------------------------------------------------------
 //   updateChannel
@@ -103,7 +104,7 @@ void Score::updateChannel()
 //   playNote
 //---------------------------------------------------------
 
-static void playNote(EventMap* events, const Note* note, int channel, int pitch,
+static void playNote(TickEventList* events, const Note* note, int channel, int pitch,
    int velo, int onTime, int offTime)
       {
       velo = note->customizeVelocity(velo);
@@ -113,22 +114,22 @@ static void playNote(EventMap* events, const Note* note, int channel, int pitch,
       ev.setVelo(velo);
       ev.setTuning(note->tuning());
       ev.setNote(note);
-      events->insertMulti(onTime, ev);
+      events->append(TickEvent(onTime, ev));
       ev.setVelo(0);
-      events->insertMulti(offTime, ev);
+      events->append(TickEvent(offTime, ev));
       }
 
 //---------------------------------------------------------
 //   collectNote
 //---------------------------------------------------------
 
-static void collectNote(EventMap* events, int channel, const Note* note, int velo, int tickOffset)
+static void collectNote(TickEventList* events, int channel, const Note* note, int velo)
       {
       if (note->hidden() || note->tieBack())       // do not play overlapping notes
             return;
 
       int pitch   = note->ppitch();
-      int tick    = note->chord()->tick() + tickOffset;
+      int tick    = note->chord()->tick();
       int onTime  = tick + note->onTimeOffset() + note->onTimeUserOffset();
       int offTime = tick + note->playTicks() + note->offTimeOffset() + note->offTimeUserOffset() - 1;
 
@@ -170,7 +171,7 @@ static void collectNote(EventMap* events, int channel, const Note* note, int vel
                         ev.setController(CTRL_PITCH);
                         int midiPitch = (pitch * 16384) / 300;
                         ev.setValue(midiPitch);
-                        events->insertMulti(tick, ev);
+                        events->append(TickEvent(tick, ev));
                         }
                   if (pitch != points[pt+1].pitch) {
                         int pitchDelta = points[pt+1].pitch - pitch;
@@ -186,7 +187,7 @@ static void collectNote(EventMap* events, int channel, const Note* note, int vel
 
                               int midiPitch = (p * 16384) / 1200;
                               ev.setValue(midiPitch);
-                              events->insertMulti(tick + tick3, ev);
+                              events->append(TickEvent(tick + tick3, ev));
                               }
                         tick1 = tick2;
                         }
@@ -197,7 +198,7 @@ static void collectNote(EventMap* events, int channel, const Note* note, int vel
             ev.setChannel(channel);
             ev.setController(CTRL_PITCH);
             ev.setValue(0);
-            events->insertMulti(tick + ticks, ev);
+            events->append(TickEvent(tick + ticks, ev));
             }
 #endif
       }
@@ -214,9 +215,11 @@ struct OttavaShiftSegment {
 
 //---------------------------------------------------------
 //   collectMeasureEvents
+//    render events of part in measure m; ticks are
+//    score ticks, the repeat offset is added later
 //---------------------------------------------------------
 
-static void collectMeasureEvents(EventMap* events, Measure* m, Part* part, int tickOffset)
+static void collectMeasureEvents(TickEventList* events, Measure* m, const Part* part)
       {
       int firstStaffIdx = m->score()->staffIdx(part);
       int nextStaffIdx  = firstStaffIdx + part->nstaves();
@@ -263,7 +266,7 @@ static void collectMeasureEvents(EventMap* events, Measure* m, Part* part, int t
                                     ChordRest* cr = static_cast<ChordRest*>(seg2->element(track));
                                     if (cr && cr->type() == CHORD) {
                                           Chord* c2 = static_cast<Chord*>(cr);
-                                          int tick = chord->tick() + tickOffset;
+                                          int tick = chord->tick();
                                           for (int i = 0; i < repeats; ++i) {
                                                 foreach (const Note* note, chord->notes()) {
                                                       int channel = instr->channel(note->subchannel()).channel;
@@ -282,7 +285,7 @@ static void collectMeasureEvents(EventMap* events, Measure* m, Part* part, int t
                                     }
                               else if (chord->tremoloChordType() == TremoloSingle) {
                                     for (int i = 0; i < repeats; ++i) {
-                                          int tick = chord->tick() + tickOffset + i * tl.ticks();
+                                          int tick = chord->tick() + i * tl.ticks();
                                           foreach (const Note* note, chord->notes()) {
                                                 int channel = instr->channel(note->subchannel()).channel;
                                                 playNote(events, note, channel, note->ppitch(), velocity, tick, tick + tl.ticks() - 1);
@@ -295,7 +298,7 @@ static void collectMeasureEvents(EventMap* events, Measure* m, Part* part, int t
                         else {
                               foreach(const Note* note, chord->notes()) {
                                     int channel = instr->channel(note->subchannel()).channel;
-                                    collectNote(events, channel, note, velocity, tickOffset);
+                                    collectNote(events, channel, note, velocity);
                                     }
                               }
                         }
@@ -313,7 +316,7 @@ static void collectMeasureEvents(EventMap* events, Measure* m, Part* part, int t
                      || e->staffIdx() >= nextStaffIdx)
                         continue;
                   const StaffText* st = static_cast<const StaffText*>(e);
-                  int tick = s->tick() + tickOffset;
+                  int tick = s->tick();
 
                   Instrument* instr = e->staff()->part()->instr(tick);
                   foreach (const ChannelActions& ca, *st->channelActions()) {
@@ -327,7 +330,7 @@ static void collectMeasureEvents(EventMap* events, Measure* m, Part* part, int t
                                     Event event(nel->events[i]);
                                     event.setOntime(tick);
                                     event.setChannel(channel);
-                                    events->insertMulti(tick, event);
+                                    events->append(TickEvent(tick, event));
                                     }
                               }
                         }
@@ -345,7 +348,7 @@ static void collectMeasureEvents(EventMap* events, Measure* m, Part* part, int t
                                           event.setValue(k);
                                           event.setOntime(tick);
                                           event.setChannel(channel);
-                                          events->insertMulti(tick, event);
+                                          events->append(TickEvent(tick, event));
                                           }
                                     }
                               Event event(ME_CONTROLLER);
@@ -353,10 +356,10 @@ static void collectMeasureEvents(EventMap* events, Measure* m, Part* part, int t
                               event.setValue(96 + i);
                               event.setOntime(tick);
                               event.setChannel(channel);
-                              events->insertMulti(tick, event);
+                              events->append(TickEvent(tick, event));
 
                               event.setValue(64 + i);
-                              events->insertMulti(tick, event);
+                              events->append(TickEvent(tick, event));
                               }
                         }
                   }
@@ -374,13 +377,43 @@ void Score::renderPart(EventMap* events, Part* part)
             int endTick    = startTick + rs->len;
             int tickOffset = rs->utick - rs->tick;
             for (Measure* m = tick2measure(startTick); m; m = m->nextMeasure()) {
-                  collectMeasureEvents(events, m, part, tickOffset);
+                  foreach(const TickEvent& te, m->midiEvents(part)) {
+                        int tick = te.tick + tickOffset;
+                        if (tickOffset && te.event.type() != ME_NOTEON) {
+                              Event event(te.event);
+                              event.setOntime(tick);
+                              events->insertMulti(tick, event);
+                              }
+                        else
+                              events->insertMulti(tick, te.event);
+                        }
                   if (m->tick() + m->ticks() >= endTick)
                         break;
                   }
             }
       }
 
+//---------------------------------------------------------
+//   midiEvents
+//    return the rendered events of part in this measure;
+//    they are rendered again only if the measure or the
+//    whole score was invalidated since the last call
+//---------------------------------------------------------
+
+const TickEventList& Measure::midiEvents(const Part* part)
+      {
+      if (_eventsRevision != _score->eventsRevision()) {
+            _midiEvents.clear();
+            _eventsRevision = _score->eventsRevision();
+            }
+      QHash<const Part*, TickEventList>::iterator i = _midiEvents.find(part);
+      if (i == _midiEvents.end()) {
+            i = _midiEvents.insert(part, TickEventList());
+            collectMeasureEvents(&i.value(), this, part);
+            }
+      return i.value();
+      }
+
 //---------------------------------------------------------
 //   updateRepeatList
 //---------------------------------------------------------
@@ -406,7 +439,7 @@ void Score::updateRepeatList(bool expandRepeats)
             repeatList()->unwind();
       if (debugMode)
             repeatList()->dump();
-      setPlaylistDirty(true);
+      _playlistDirty = true;
       }
 
 //---------------------------------------------------------
@@ -416,6 +449,7 @@ void Score::updateRepeatList(bool expandRepeats)
 
 void Score::toEList(EventMap* events)
       {
+      TRACE("toEList");
       updateRepeatList(_playRepeats);
       _foundPlayPosAfterRepeats = false;
       updateChannel();
@@ -453,6 +487,23 @@ void Score::toEList(EventMap* events)
             }
       }
 
+//---------------------------------------------------------
+//   toEList
+//    export score to the flat playback timeline; play
+//    times are computed for a relative tempo of 1.0
+//---------------------------------------------------------
+
+void Score::toEList(EventTimeline* timeline)
+      {
+      EventMap events;
+      toEList(&events);
+      timeline->clear();
+      timeline->reserve(events.size());
+      qreal relTempo = tempomap()->relTempo();
+      for (EventMap::const_iterator i = events.constBegin(); i != events.constEnd(); ++i)
+            timeline->append(PlayEvent(i.key(), utick2utime(i.key()) * relTempo, i.value()));
+      }
+
 //---------------------------------------------------------
 //   updateHairpin
 //---------------------------------------------------------
@@ -546,6 +597,7 @@ void Score::removeHairpin(Hairpin* h)
 
 void Score::updateVelo()
       {
+      invalidateEvents();
       //
       //    collect Dynamics & Ottava & Hairpins
       //
@@ -45,6 +45,7 @@ class Rest : public ChordRest {
       Rest(Score*, const Duration&);
       virtual Rest* clone() const      { return new Rest(*this); }
       virtual ElementType type() const { return REST; }
+      ELEMENT_POOL(REST)
 
       virtual void draw(Painter*) const;
       virtual void write(Xml& xml) const;
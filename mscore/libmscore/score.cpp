@@ -269,8 +269,10 @@ void Score::init()
       _creationDate   = QDate::currentDate();
       _revisions      = new Revisions;
       _symIdx         = 0;
+      _textLayoutCache = new TextLayoutCache;
       _pageNumberOffset = 0;
       startLayout     = 0;
+      endLayout       = 0;
       _undo           = new UndoStack();
       _repeatList     = new RepeatList(this);
       foreach(StaffType* st, ::staffTypes)
@@ -295,6 +297,7 @@ void Score::init()
       _showPageborders = false;
       _printing       = false;
       _playlistDirty  = false;
+      _eventsRevision = 0;
       _autosaveDirty  = false;
       _dirty          = false;
       _saved          = false;
@@ -380,6 +383,7 @@ Score::~Score()
       delete _repeatList;
       foreach(StaffType* st, _staffTypes)
             delete st;
+      delete _textLayoutCache;
       }
 
 //---------------------------------------------------------
@@ -484,6 +488,7 @@ void Score::insertTime(int /*tick*/, int /*len*/)
 
 void Score::fixTicks()
       {
+      invalidateEvents();
       int number = 0;
       int tick   = 0;
       Measure* fm = firstMeasure();
@@ -761,6 +766,107 @@ bool Score::playlistDirty()
       return val;
       }
 
+//---------------------------------------------------------
+//   invalidateEvents
+//    the cached midi events of all measures are out
+//    of date (velocities, channels, measure ticks...)
+//---------------------------------------------------------
+
+void Score::invalidateEvents()
+      {
+      ++_eventsRevision;
+      _playlistDirty = true;
+      }
+
+//---------------------------------------------------------
+//   invalidateEvents
+//    measure m has changed; notes of the previous
+//    measure may be tied into m
+//---------------------------------------------------------
+
+void Score::invalidateEvents(Measure* m)
+      {
+      m->invalidateEvents();
+      Measure* pm = m->prevMeasure();
+      if (pm)
+            pm->invalidateEvents();
+      _playlistDirty = true;
+      }
+
+//---------------------------------------------------------
+//   elementMeasure
+//---------------------------------------------------------
+
+static Measure* elementMeasure(Element* e)
+      {
+      while (e && e->type() != MEASURE)
+            e = e->parent();
+      return static_cast<Measure*>(e);
+      }
+
+//---------------------------------------------------------
+//   invalidateTieChain
+//    the first note of a tie chain plays the length of
+//    the whole chain and the other notes are skipped;
+//    invalidate the measures of all notes tied to note
+//---------------------------------------------------------
+
+static void invalidateTieChain(Score* score, Note* note)
+      {
+      while (note->tieBack() && note->tieBack()->startNote())
+            note = note->tieBack()->startNote();
+      while (note) {
+            Measure* m = elementMeasure(note);
+            if (m)
+                  score->invalidateEvents(m);
+            Tie* tie = note->tieFor();
+            note = tie ? tie->endNote() : 0;
+            }
+      }
+
+//---------------------------------------------------------
+//   invalidateEvents
+//    element e was added, removed or changed
+//---------------------------------------------------------
+
+void Score::invalidateEvents(Element* e)
+      {
+      switch(e->type()) {
+            case DYNAMIC:
+            case HAIRPIN:
+            case OTTAVA:
+            case STAFF_TEXT:
+            case INSTRUMENT_CHANGE:
+                  invalidateEvents();
+                  return;
+            case TIE:
+                  {
+                  // on add and remove the tie is not (or no
+                  // longer) linked in, so walk both ends
+                  Tie* tie = static_cast<Tie*>(e);
+                  if (tie->startNote())
+                        invalidateTieChain(this, tie->startNote());
+                  if (tie->endNote())
+                        invalidateTieChain(this, tie->endNote());
+                  }
+                  break;
+            case NOTE:
+                  invalidateTieChain(this, static_cast<Note*>(e));
+                  break;
+            case CHORD:
+                  foreach(Note* n, static_cast<Chord*>(e)->notes())
+                        invalidateTieChain(this, n);
+                  break;
+            default:
+                  break;
+            }
+      Measure* m = elementMeasure(e);
+      if (m)
+            invalidateEvents(m);
+      else
+            invalidateEvents();
+      }
+
 //---------------------------------------------------------
 //   spell
 //---------------------------------------------------------
@@ -915,12 +1021,25 @@ void Score::setInputTrack(int v)
 
 void Score::setLayout(Measure* m)
       {
-      if (m)
-            m->setDirty();
-      if (startLayout && startLayout != m)
-            setLayoutAll(true);
-      else
+      if (m == 0)
+            return;
+      m->setDirty();
+      invalidateEvents(m);
+      if (startLayout == 0) {
+            startLayout = m;
+            endLayout   = m;
+            }
+      else if (m->tick() < startLayout->tick())
             startLayout = m;
+      else if (m->tick() > endLayout->tick())
+            endLayout = m;
+
+      if (parentScore() == 0) {
+            foreach(Excerpt* excerpt, _excerpts) {
+                  Score* score = excerpt->score();
+                  score->setLayout(score->tick2measure(m->tick()));
+                  }
+            }
       }
 
 //---------------------------------------------------------
@@ -938,6 +1057,7 @@ void Score::appendPart(Part* p)
 
 void Score::rebuildMidiMapping()
       {
+      invalidateEvents();
       _midiMapping.clear();
       int port    = 0;
       int channel = 0;
@@ -1395,6 +1515,7 @@ void Score::addElement(Element* element)
                this, element, element->name(), element->parent(),
                element->parent() ? element->parent()->name() : "");
             }
+      invalidateEvents(element);
       ElementType et = element->type();
       if (et == TREMOLO) {
             Chord* chord = static_cast<Chord*>(element->parent());
@@ -1517,6 +1638,7 @@ void Score::removeElement(Element* element)
       if (debugMode)
             printf("   Score(%p)::removeElement %p(%s) parent %p(%s)\n",
                this, element, element->name(), parent, parent ? parent->name() : "");
+      invalidateEvents(element);
 
       // special for MEASURE, HBOX, VBOX
       // their parent is not static
@@ -2191,6 +2313,7 @@ void Score::splitStaff(int staffIdx, int splitPoint)
       rebuildMidiMapping();
       _instrumentsChanged = true;
       startLayout = 0;
+      endLayout   = 0;
       doLayout();
 
       //
@@ -2335,6 +2458,7 @@ void Score::cmdRemovePart(Part* part)
 
 void Score::insertPart(Part* part, int idx)
       {
+      invalidateEvents();
       int staff = 0;
       for (QList<Part*>::iterator i = _parts.begin(); i != _parts.end(); ++i) {
             if (staff >= idx) {
@@ -2352,6 +2476,7 @@ void Score::insertPart(Part* part, int idx)
 
 void Score::removePart(Part* part)
       {
+      invalidateEvents();
       _parts.removeAt(_parts.indexOf(part));
       }
 
@@ -2361,6 +2486,7 @@ void Score::removePart(Part* part)
 
 void Score::insertStaff(Staff* staff, int idx)
       {
+      invalidateEvents();
       _staves.insert(idx, staff);
       staff->part()->insertStaff(staff);
       }
@@ -2431,6 +2557,7 @@ void Score::cmdRemoveStaff(int staffIdx)
 
 void Score::removeStaff(Staff* staff)
       {
+      invalidateEvents();
       _staves.removeAll(staff);
       staff->part()->removeStaff(staff);
       }
@@ -2924,6 +3051,7 @@ void Score::setInputState(Element* e)
 
 void Score::deselect(Element* el)
       {
+      QMutexLocker locker(&_layoutMutex);    // may be called from layout threads
       refresh |= el->abbox();
       _selection.remove(el);
       }
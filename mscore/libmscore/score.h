@@ -42,6 +42,7 @@ class Selection;
 class Segment;
 class Rest;
 class Xml;
+class XmlReader;
 class Articulation;
 class Note;
 class Chord;
@@ -57,6 +58,7 @@ class Volta;
 class MidiEvent;
 class Excerpt;
 class EventMap;
+class EventTimeline;
 class Harmony;
 struct Channel;
 class Tuplet;
@@ -83,6 +85,7 @@ class MuseScoreView;
 class LinkedElements;
 class Fingering;
 class Painter;
+class TextLayoutCache;
 
 extern bool showRubberBand;
 
@@ -208,6 +211,22 @@ struct Layer {
       uint tags;
       };
 
+//---------------------------------------------------------
+//   ArchiveEntry
+//    one serialized file of a compressed score
+//---------------------------------------------------------
+
+struct ArchiveEntry {
+      QString name;
+      QByteArray data;
+      bool compress;
+      bool png;
+
+      ArchiveEntry() {}
+      ArchiveEntry(const QString& n, const QByteArray& d, bool c = true, bool p = false)
+         : name(n), data(d), compress(c), png(p) {}
+      };
+
 //---------------------------------------------------------
 //   Score
 //---------------------------------------------------------
@@ -215,6 +234,7 @@ struct Layer {
 class Score {
       Score* _parentScore;          // set if score is an excerpt (part)
       QReadWriteLock _layoutLock;
+      QMutex _layoutMutex;          ///< protects score data written from parallel layout stages
       QList<MuseScoreView*> viewer;
 
       QDate _creationDate;
@@ -233,6 +253,7 @@ class Score {
       // generated objects during layout:
       //
       int _symIdx;                  // used symbol set, derived from style
+      TextLayoutCache* _textLayoutCache;  ///< shared layout of plain text elements
       QList<Page*> _pages;          // pages are build from systems
       QList<System*> _systems;      // measures are akkumulated to systems
 
@@ -269,7 +290,8 @@ class Score {
 
       QRectF refresh;
       bool _updateAll;
-      Measure* startLayout;   ///< start a relayout at this measure
+      Measure* startLayout;   ///< first measure of relayout range
+      Measure* endLayout;     ///< last measure of relayout range
       bool layoutAll;         ///< do a complete relayout
       LayoutFlags layoutFlags;
       bool _playNote;         ///< play selected note after command
@@ -291,6 +313,7 @@ class Score {
 
       bool _printing;   ///< True if we are drawing to a printer
       bool _playlistDirty;
+      int _eventsRevision;    ///< bumped if rendered midi events of all measures are invalid
       bool _autosaveDirty;
       bool _dirty;      ///< Score data was modified.
       bool _saved;      ///< True if project was already saved; only on first
@@ -368,14 +391,15 @@ class Score {
       QList<System*> layoutSystemRow(qreal w, bool, bool);
       void processSystemHeader(Measure* m, bool);
       System* getNextSystem(bool, bool);
-      bool doReLayout();
+      bool doLayoutRange();
+      bool layoutSystems(int idx, Measure* stop);
       Measure* skipEmptyMeasures(Measure*, System*);
 
-      void layoutStage1();
-      void layoutStage2();
-      void layoutStage3();
+      void layoutStage1(Measure* fm, Measure* lm);
+      void layoutStage2(Measure* fm, Measure* lm);
+      void layoutStage3(Measure* fm, Measure* lm);
+      void layoutSpanner(Measure* fm, Measure* lm);
       void transposeKeys(int staffStart, int staffEnd, int tickStart, int tickEnd, int semitones);
-      void reLayout(Measure*);
 
       void checkSlurs();
       void checkTuplets();
@@ -385,6 +409,9 @@ class Score {
       void updateVelo();
       void addAudioTrack();
       void parseVersion(const QString&);
+      void readInit();
+      void readScoreElement(QDomElement);
+      void readEnd(QDomElement);
       QList<Fraction> splitGapToMeasureBoundaries(ChordRest*, Fraction);
       void pasteChordRest(ChordRest* cr, int tick);
       void init();
@@ -407,6 +434,8 @@ class Score {
       void removeStaff(Staff*);
       void addMeasure(MeasureBase*, MeasureBase*);
       void readStaff(QDomElement);
+      void readStaff(XmlReader&);
+      void readStaffElement(QDomElement, int staff, MeasureBase**);
 
       void cmdInsertPart(Part*, int);
       void cmdRemovePart(Part*);
@@ -426,7 +455,12 @@ class Score {
 
       void write(Xml&);
       bool read(QDomElement);
+      bool read(XmlReader&);
       bool read1(QDomElement);
+      bool read1(QIODevice*);
+      bool read1(XmlReader&, QIODevice*);
+      QByteArray snapshot();
+      bool readSnapshot(const QByteArray&);
 
       QList<Staff*>& staves()                { return _staves; }
       const QList<Staff*>& staves() const    { return _staves; }
@@ -558,8 +592,11 @@ class Score {
 
       void saveFile(QFileInfo& info);
       void saveFile(QIODevice* f, bool msczFormat);
+      void saveFile(Xml&);
       void saveCompressedFile(QFileInfo&);
       void saveCompressedFile(QIODevice*, QFileInfo&);
+      QList<ArchiveEntry> archiveEntries(QFileInfo&);
+      static void writeArchive(QIODevice*, const QList<ArchiveEntry>&, int level = 9);
       bool exportFile();
 
       void print(Painter* printer, int page);
@@ -585,6 +622,10 @@ class Score {
 
       bool playlistDirty();
       void setPlaylistDirty(bool val) { _playlistDirty = val; }
+      int eventsRevision() const      { return _eventsRevision; }
+      void invalidateEvents();
+      void invalidateEvents(Measure*);
+      void invalidateEvents(Element*);
 
       void cmd(const QAction*);
       int fileDivision(int t) const { return (t * MScore::division + _fileDivision/2) / _fileDivision; }
@@ -644,6 +685,7 @@ class Score {
 
       void pasteStaff(QDomElement, ChordRest* dst);
       void toEList(EventMap* events);
+      void toEList(EventTimeline* events);
       void renderPart(EventMap* events, Part*);
       int mscVersion() const    { return _mscVersion; }
       void setMscVersion(int v) { _mscVersion = v; }
@@ -769,10 +811,11 @@ class Score {
 
       void doLayout();
       void layoutSystems();
-      void layoutPages();
+      void layoutPages(int startPage = 0);
       Page* getEmptyPage();
 
       void layoutChords1(Segment* segment, int staffIdx);
+      void layoutStage2(int staffIdx, Measure* fm, Measure* lm);
       SyntiState& syntiState()                           { return _syntiState;         }
       void setSyntiState(const SyntiState& s);
 
@@ -783,6 +826,7 @@ class Score {
 
       void addLayoutFlags(LayoutFlags val)               { layoutFlags |= val; }
       int symIdx() const                                 { return _symIdx; }
+      TextLayoutCache* textLayoutCache() const           { return _textLayoutCache; }
       void updateHairpin(Hairpin*);       // add/modify hairpin to pitchOffset list
       void removeHairpin(Hairpin*);       // remove hairpin from pitchOffset list
       Volta* searchVolta(int tick) const;
@@ -39,6 +39,7 @@
 #include "omr/omrpage.h"
 #include "sig.h"
 #include "undo.h"
+#include "trace.h"
 
 //---------------------------------------------------------
 //   write
@@ -145,60 +146,85 @@ void Score::readStaff(QDomElement e)
       curTick         = 0;
       curTrack        = staff * VOICES;
 
-      for (e = e.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
-            QString tag(e.tagName());
+      for (e = e.firstChildElement(); !e.isNull(); e = e.nextSiblingElement())
+            readStaffElement(e, staff, &mb);
+      }
 
-            if (tag == "Measure") {
-                  Measure* measure = 0;
-                  if (staff == 0) {
-                        measure = new Measure(this);
-                        measure->setTick(curTick);
-                        add(measure);
-                        if (_mscVersion < 115) {
-                              const SigEvent& ev = sigmap()->timesig(measure->tick());
-                              measure->setLen(ev.timesig());
-                              measure->setTimesig(ev.nominal());
-                              }
-                        else {
-                              //
-                              // inherit timesig from previous measure
-                              //
-                              Measure* m = measure->prevMeasure();
-                              Fraction f(m ? m->timesig() : Fraction(4,4));
-                              measure->setLen(f);
-                              measure->setTimesig(f);
-                              }
+void Score::readStaff(XmlReader& r)
+      {
+      MeasureBase* mb = first();
+      QString id      = r.attributes().value("id").toString();
+      int staff       = (id.isEmpty() ? 1 : id.toInt()) - 1;
+      curTick         = 0;
+      curTrack        = staff * VOICES;
+
+      while (r.readNextStartElement()) {
+            QDomDocument doc;
+            readStaffElement(r.readDomElement(&doc), staff, &mb);
+            }
+      }
+
+//---------------------------------------------------------
+//   readStaffElement
+//    read one measure or frame of staff "staff"; *mbp
+//    walks through the measures created by the first staff
+//---------------------------------------------------------
+
+void Score::readStaffElement(QDomElement e, int staff, MeasureBase** mbp)
+      {
+      MeasureBase*& mb = *mbp;
+      QString tag(e.tagName());
+
+      if (tag == "Measure") {
+            Measure* measure = 0;
+            if (staff == 0) {
+                  measure = new Measure(this);
+                  measure->setTick(curTick);
+                  add(measure);
+                  if (_mscVersion < 115) {
+                        const SigEvent& ev = sigmap()->timesig(measure->tick());
+                        measure->setLen(ev.timesig());
+                        measure->setTimesig(ev.nominal());
                         }
                   else {
-                        while (mb) {
-                              if (mb->type() != MEASURE) {
-                                    mb = mb->next();
-                                    }
-                              else {
-                                    measure = (Measure*)mb;
-                                    mb      = mb->next();
-                                    break;
-                                    }
+                        //
+                        // inherit timesig from previous measure
+                        //
+                        Measure* m = measure->prevMeasure();
+                        Fraction f(m ? m->timesig() : Fraction(4,4));
+                        measure->setLen(f);
+                        measure->setTimesig(f);
+                        }
+                  }
+            else {
+                  while (mb) {
+                        if (mb->type() != MEASURE) {
+                              mb = mb->next();
                               }
-                        if (measure == 0) {
-                              printf("Score::readStaff(): missing measure!\n");
-                              measure = new Measure(this);
-                              measure->setTick(curTick);
-                              add(measure);
+                        else {
+                              measure = (Measure*)mb;
+                              mb      = mb->next();
+                              break;
                               }
                         }
-                  measure->read(e, staff);
-                  curTick = measure->tick() + measure->ticks();
-                  }
-            else if (tag == "HBox" || tag == "VBox" || tag == "TBox" || tag == "FBox") {
-                  MeasureBase* mb = static_cast<MeasureBase*>(Element::name2Element(tag, this));
-                  mb->read(e);
-                  mb->setTick(curTick);
-                  add(mb);
+                  if (measure == 0) {
+                        printf("Score::readStaff(): missing measure!\n");
+                        measure = new Measure(this);
+                        measure->setTick(curTick);
+                        add(measure);
+                        }
                   }
-            else
-                  domError(e);
+            measure->read(e, staff);
+            curTick = measure->tick() + measure->ticks();
+            }
+      else if (tag == "HBox" || tag == "VBox" || tag == "TBox" || tag == "FBox") {
+            MeasureBase* mb = static_cast<MeasureBase*>(Element::name2Element(tag, this));
+            mb->read(e);
+            mb->setTick(curTick);
+            add(mb);
             }
+      else
+            domError(e);
       }
 
 //---------------------------------------------------------
@@ -355,15 +381,28 @@ void Score::saveCompressedFile(QFileInfo& info)
 
 void Score::saveCompressedFile(QIODevice* f, QFileInfo& info)
       {
-      Zip uz;
-      if (!uz.createArchive(f))
-            throw (QString("Cannot create compressed musescore file: " + uz.errorString()));
+      TRACE("saveCompressedFile");
+      QList<ArchiveEntry> entries = archiveEntries(info);
+      try {
+            writeArchive(f, entries);
+            }
+      catch (QString s) {
+            throw(s + QString(" '%1'").arg(info.filePath()));
+            }
+      }
 
-      QDateTime dt;
-      if (debugMode)
-            dt = QDateTime(QDate(2007, 9, 10), QTime(12, 0));
-      else
-            dt = QDateTime::currentDateTime();
+//---------------------------------------------------------
+//   archiveEntries
+//    serialize the score and its images into the entries
+//    of a compressed musescore file; the result does not
+//    reference the score and can be written by
+//    writeArchive() in another thread
+//---------------------------------------------------------
+
+QList<ArchiveEntry> Score::archiveEntries(QFileInfo& info)
+      {
+      QReadLocker locker(&_layoutLock);
+      QList<ArchiveEntry> entries;
 
       QString fn = info.completeBaseName() + ".mscx";
       QBuffer cbuf;
@@ -388,10 +427,8 @@ void Score::saveCompressedFile(QIODevice* f, QFileInfo& info)
 
       xml.etag();
       xml.etag();
-      cbuf.seek(0);
-      if (!uz.createEntry("META-INF/container.xml", cbuf, dt))
-            throw(QString("Cannot add container.xml to zipfile '%1': ").arg(info.filePath())
-               + uz.errorString());
+      cbuf.close();
+      entries.append(ArchiveEntry("META-INF/container.xml", cbuf.data()));
 
       // save images
       idx = 1;
@@ -402,8 +439,6 @@ void Score::saveCompressedFile(QIODevice* f, QFileInfo& info)
             QFileInfo fi(srcPath);
             QString suffix = fi.suffix();
             QString dstPath = QString("Pictures/pic%1.%2").arg(idx).arg(suffix);
-            QBuffer cbuf;
-            QByteArray ba;
             if (!ip->loaded()) {
                   QFile inFile(srcPath);
                   if (!inFile.open(QIODevice::ReadOnly))
@@ -412,12 +447,8 @@ void Score::saveCompressedFile(QIODevice* f, QFileInfo& info)
                   inFile.close();
                   ip->setLoaded(true);
                   }
-            cbuf.setBuffer(&(ip->buffer().buffer()));
-            if (!cbuf.open(QIODevice::ReadOnly))
-                  throw(QString("cannot open buffer cbuf"));
-            if (!uz.createEntry(dstPath, cbuf, dt, false, false, 0))
-                  throw(QString("Cannot add <%1> to zipfile as <%1>\n").arg(srcPath).arg(dstPath));
-            cbuf.close();
+            // images are stored uncompressed
+            entries.append(ArchiveEntry(dstPath, ip->buffer().buffer(), false));
             ip->setPath(dstPath);   // image now has local path
             ++idx;
             }
@@ -434,11 +465,7 @@ void Score::saveCompressedFile(QIODevice* f, QFileInfo& info)
                   QImage image = page->image();
                   if (!image.save(&cbuf, "PNG"))
                         throw(QString("cannot create image"));
-                  if (!cbuf.open(QIODevice::ReadOnly))
-                        throw(QString("cannot open buffer cbuf"));
-                  if (!uz.createEntry(path, cbuf, dt, false, true))
-                        throw(QString("Cannot add <%1> to zipfile\n").arg(path));
-                  cbuf.close();
+                  entries.append(ArchiveEntry(path, cbuf.data(), true, true));
                   }
             }
 #endif
@@ -446,11 +473,39 @@ void Score::saveCompressedFile(QIODevice* f, QFileInfo& info)
       QBuffer dbuf;
       dbuf.open(QIODevice::ReadWrite);
       saveFile(&dbuf, true);
-      dbuf.seek(0);
-      if (!uz.createEntry(fn, dbuf, dt))
-            throw(QString("Cannot add %1 to zipfile '%2'").arg(fn).arg(info.filePath()));
-      if (!uz.closeArchive())
-            throw(QString("Cannot close zipfile '%1'").arg(info.filePath()));
+      dbuf.close();
+      entries.append(ArchiveEntry(fn, dbuf.data()));
+      return entries;
+      }
+
+//---------------------------------------------------------
+//   writeArchive
+//    write entries as zip archive into the opened file f;
+//    compressed entries use the zlib level "level" and
+//    are compressed in parallel
+//---------------------------------------------------------
+
+void Score::writeArchive(QIODevice* f, const QList<ArchiveEntry>& entries, int level)
+      {
+      QDateTime dt;
+      if (debugMode)
+            dt = QDateTime(QDate(2007, 9, 10), QTime(12, 0));
+      else
+            dt = QDateTime::currentDateTime();
+
+      // Zip has large buffers; keep it off the stack of
+      // thread pool threads
+      QScopedPointer<Zip> uz(new Zip);
+      if (!uz->createArchive(f))
+            throw (QString("Cannot create compressed musescore file: " + uz->errorString()));
+      uz->setLevel(level);
+      QList<ZipData> data;
+      foreach(const ArchiveEntry& e, entries)
+            data.append(ZipData(e.name, e.data, e.compress ? -1 : 0, e.png));
+      if (!uz->createEntries(data, dt))
+            throw(QString("Cannot add entries to zipfile: ") + uz->errorString());
+      if (!uz->closeArchive())
+            throw(QString("Cannot close zipfile"));
       }
 
 //---------------------------------------------------------
@@ -533,6 +588,18 @@ void Score::saveFile(QIODevice* f, bool msczFormat)
       {
       Xml xml(f);
       xml.writeOmr = msczFormat;
+      saveFile(xml);
+      }
+
+//---------------------------------------------------------
+//   saveFile
+//    write the score file to xml which may be in
+//    snapshot mode
+//---------------------------------------------------------
+
+void Score::saveFile(Xml& xml)
+      {
+      TRACE("saveFile");
       xml.header();
       xml.stag("museScore version=\"" MSC_VERSION "\"");
       xml.tag("programVersion", VERSION);
@@ -550,6 +617,7 @@ void Score::saveFile(QIODevice* f, bool msczFormat)
 
 bool Score::loadCompressedMsc(QString name)
       {
+      TRACE("loadCompressedMsc");
       QString ext(".mscz");
 
       info.setFile(name);
@@ -623,22 +691,18 @@ bool Score::loadCompressedMsc(QString name)
             return false;
             }
 
-      QBuffer dbuf;
-      dbuf.open(QIODevice::WriteOnly);
-      uz.extractFile(rootfile, &dbuf);
-
-      QDomDocument doc;
-      if (!doc.setContent(dbuf.data(), false, &err, &line, &column)) {
-            QString col, ln;
-            col.setNum(column);
-            ln.setNum(line);
-            QString error = err + "\n at line " + ln + " column " + col;
-            printf("error: %s\n", qPrintable(error));
+      // the score is inflated while it is parsed
+      QIODevice* dev = uz.openFile(rootfile);
+      if (dev == 0) {
+            MScore::lastError = QString("cannot read <%1>: ").arg(rootfile) + uz.errorString();
+            printf("error: %s\n", qPrintable(MScore::lastError));
             return false;
             }
-      dbuf.close();
       docName = info.completeBaseName();
-      bool retval = read1(doc.documentElement());
+      bool retval = read1(dev);
+      delete dev;
+      if (!retval)
+            printf("error: %s\n", qPrintable(MScore::lastError));
 
 #ifdef OMR
       //
@@ -674,6 +738,7 @@ bool Score::loadCompressedMsc(QString name)
 
 bool Score::loadMsc(QString name)
       {
+      TRACE("loadMsc");
       QString ext(".mscx");
 
       info.setFile(name);
@@ -687,17 +752,10 @@ bool Score::loadMsc(QString name)
             return false;
             }
 
-      QDomDocument doc;
-      int line, column;
-      QString err;
-      if (!doc.setContent(&f, false, &err, &line, &column)) {
-            QString s = QT_TRANSLATE_NOOP("file", "error reading file %1 at line %2 column %3: %4\n");
-            MScore::lastError = s.arg(f.fileName()).arg(line).arg(column).arg(err);
-            return false;
-            }
-      f.close();
       docName = f.fileName();
-      return read1(doc.documentElement());
+      bool rv = read1(&f);
+      f.close();
+      return rv;
       }
 
 //---------------------------------------------------------
@@ -752,6 +810,94 @@ void Score::parseVersion(const QString& val)
             printf("2cannot parse <%s>\n", VERSION);
       }
 
+//---------------------------------------------------------
+//   read1
+//    read score file from device in one pass; files
+//    older than 1.17 are read through a QDomDocument
+//    return true on success
+//---------------------------------------------------------
+
+bool Score::read1(QIODevice* dev)
+      {
+      XmlReader r(dev);
+      return read1(r, dev);
+      }
+
+//---------------------------------------------------------
+//   read1
+//    dev is the device read by r for the fallback to
+//    QDomDocument; it is 0 for snapshots, which are always
+//    written in the current version
+//---------------------------------------------------------
+
+bool Score::read1(XmlReader& r, QIODevice* dev)
+      {
+      QString err;
+      int line = 0, column = 0;
+
+      _elinks.clear();
+      while (r.readNextStartElement()) {
+            if (r.name() == "museScore") {
+                  QString version = r.attributes().value("version").toString();
+                  QStringList sl = version.split('.');
+                  int v = sl[0].toInt() * 100 + (sl.size() > 1 ? sl[1].toInt() : 0);
+                  if (v < 117) {
+                        if (dev == 0) {
+                              err = QString("unsupported version %1").arg(version);
+                              break;
+                              }
+                        QDomDocument doc;
+                        dev->seek(0);
+                        if (!doc.setContent(dev, false, &err, &line, &column))
+                              break;
+                        return read1(doc.documentElement());
+                        }
+                  _mscVersion = v;
+                  if (_mscVersion > MSCVERSION) {
+                        // incompatible version
+                        MScore::lastError =
+                           QT_TRANSLATE_NOOP("score", "Cannot read this score:\n"
+                           "your version of MuseScore is too old.");
+                        return false;
+                        }
+                  while (r.readNextStartElement()) {
+                        if (r.name() == "programVersion")
+                              parseVersion(r.readElementText());
+                        else if (r.name() == "programRevision")
+                              r.skipCurrentElement();
+                        else if (r.name() == "Score")
+                              read(r);
+                        else if (r.name() == "Revision") {
+                              QDomDocument doc;
+                              Revision* revision = new Revision;
+                              revision->read(r.readDomElement(&doc));
+                              _revisions->add(revision);
+                              }
+                        else
+                              r.unknown();
+                        }
+                  }
+            else
+                  r.unknown();
+            }
+      if (r.hasError()) {
+            err    = r.errorString();
+            line   = r.lineNumber();
+            column = r.columnNumber();
+            }
+      if (!err.isEmpty()) {
+            QString s = QT_TRANSLATE_NOOP("file", "error reading file %1 at line %2 column %3: %4\n");
+            MScore::lastError = s.arg(docName).arg(line).arg(column).arg(err);
+            return false;
+            }
+      int id = 1;
+      foreach(LinkedElements* le, _elinks)
+            le->setLid(id++);
+      _elinks.clear();
+      _mscVersion = MSCVERSION;     // for later drag & drop usage
+      return true;
+      }
+
 //---------------------------------------------------------
 //   read1
 //    return true on success
@@ -812,209 +958,270 @@ bool Score::read1(QDomElement e)
 //---------------------------------------------------------
 
 bool Score::read(QDomElement dScore)
+      {
+      TRACE("Score::read");
+      readInit();
+      dScore = dScore.firstChildElement();
+      for (QDomElement ee = dScore; !ee.isNull(); ee = ee.nextSiblingElement()) {
+            curTrack = -1;
+            readScoreElement(ee);
+            }
+      readEnd(dScore);
+      return true;
+      }
+
+//---------------------------------------------------------
+//   read
+//    streaming version; staves are read measure by
+//    measure, so only the dom of one measure is in memory
+//---------------------------------------------------------
+
+bool Score::read(XmlReader& r)
+      {
+      TRACE("Score::read");
+      readInit();
+      while (r.readNextStartElement()) {
+            curTrack = -1;
+            if (r.name() == "Staff")
+                  readStaff(r);
+            else if (r.name() == "Score") {     // recursion
+                  Score* s = new Score(style());
+                  s->setParentScore(this);
+                  s->read(r);
+                  addExcerpt(s);
+                  }
+            else {
+                  QDomDocument doc;
+                  readScoreElement(r.readDomElement(&doc));
+                  }
+            }
+      readEnd(QDomElement());
+      return !r.hasError();
+      }
+
+//---------------------------------------------------------
+//   readInit
+//---------------------------------------------------------
+
+void Score::readInit()
       {
       _fileDivision = 384;   // for compatibility with old mscore files
       slurs.clear();
 
       if (parentScore())
             setMscVersion(parentScore()->mscVersion());
-      dScore = dScore.firstChildElement();
-      for (QDomElement ee = dScore; !ee.isNull(); ee = ee.nextSiblingElement()) {
-            curTrack = -1;
-            QString tag(ee.tagName());
-            QString val(ee.text());
-            int i = val.toInt();
-            if (tag == "Staff")
-                  readStaff(ee);
-            else if (tag == "KeySig") {
-                  KeySig* ks = new KeySig(this);
-                  ks->read(ee);
-                  customKeysigs.append(ks);
-                  }
-            else if (tag == "StaffType") {
-                  int idx        = ee.attribute("idx").toInt();
-                  StaffType* ost = _staffTypes.value(idx);
-                  StaffType* st;
-                  if (ost)
-                        st = ost;
-                  else {
-                        QString group  = ee.attribute("group", "pitched");
-                        if (group == "percussion")
-                              st  = new StaffTypePercussion();
-                        else if (group == "tablature")
-                              st  = new StaffTypeTablature();
-                        else
-                              st  = new StaffTypePitched();
-                        }
-                  st->read(ee);
-                  if (idx < _staffTypes.size())
-                        _staffTypes[idx] = st;
+      }
+
+//---------------------------------------------------------
+//   readScoreElement
+//    read one child element of <Score>
+//---------------------------------------------------------
+
+void Score::readScoreElement(QDomElement ee)
+      {
+      QString tag(ee.tagName());
+      QString val(ee.text());
+      int i = val.toInt();
+      if (tag == "Staff")
+            readStaff(ee);
+      else if (tag == "KeySig") {
+            KeySig* ks = new KeySig(this);
+            ks->read(ee);
+            customKeysigs.append(ks);
+            }
+      else if (tag == "StaffType") {
+            int idx        = ee.attribute("idx").toInt();
+            StaffType* ost = _staffTypes.value(idx);
+            StaffType* st;
+            if (ost)
+                  st = ost;
+            else {
+                  QString group  = ee.attribute("group", "pitched");
+                  if (group == "percussion")
+                        st  = new StaffTypePercussion();
+                  else if (group == "tablature")
+                        st  = new StaffTypeTablature();
                   else
-                        _staffTypes.append(st);
-                  }
-            else if (tag == "siglist")
-                  _sigmap->read(ee, _fileDivision);
-            else if (tag == "tempolist")        // obsolete
-                  ;           // tempomap()->read(ee, _fileDivision);
-            else if (tag == "programVersion")
-                  parseVersion(val);
-            else if (tag == "programRevision")
-                  ;
-            else if (tag == "Mag" || tag == "MagIdx" || tag == "xoff" || tag == "yoff") {
-                  // obsolete
-                  ;
+                        st  = new StaffTypePitched();
                   }
-            else if (tag == "Omr") {
+            st->read(ee);
+            if (idx < _staffTypes.size())
+                  _staffTypes[idx] = st;
+            else
+                  _staffTypes.append(st);
+            }
+      else if (tag == "siglist")
+            _sigmap->read(ee, _fileDivision);
+      else if (tag == "tempolist")        // obsolete
+            ;           // tempomap()->read(ee, _fileDivision);
+      else if (tag == "programVersion")
+            parseVersion(val);
+      else if (tag == "programRevision")
+            ;
+      else if (tag == "Mag" || tag == "MagIdx" || tag == "xoff" || tag == "yoff") {
+            // obsolete
+            ;
+            }
+      else if (tag == "Omr") {
 #ifdef OMR
-                  _omr = new Omr(this);
-                  _omr->read(ee);
+            _omr = new Omr(this);
+            _omr->read(ee);
 #endif
+            }
+      else if (tag == "showOmr")
+            _showOmr = i;
+      else if (tag == "LayerTag") {
+            int id = ee.attribute("id").toInt();
+            QString tag = ee.attribute("tag");
+            if (id >= 0 && id < 32) {
+                  _layerTags[id] = tag;
+                  _layerTagComments[id] = val;
                   }
-            else if (tag == "showOmr")
-                  _showOmr = i;
-            else if (tag == "LayerTag") {
-                  int id = ee.attribute("id").toInt();
-                  QString tag = ee.attribute("tag");
-                  if (id >= 0 && id < 32) {
-                        _layerTags[id] = tag;
-                        _layerTagComments[id] = val;
-                        }
-                  }
-            else if (tag == "Layer") {
-                  Layer layer;
-                  layer.name = ee.attribute("name");
-                  layer.tags = ee.attribute("mask").toUInt();
-                  _layer.append(layer);
-                  }
-            else if (tag == "currentLayer")
-                  _currentLayer = val.toInt();
-            else if (tag == "SyntiSettings") {
-                  _syntiState.clear();
-                  _syntiState.read(ee);
-                  //
-                  // check for soundfont,
-                  // add default soundfont if none found
-                  // (for compatibility with old scores)
-                  //
-                  bool hasSoundfont = false;
-                  foreach(const SyntiParameter& sp, _syntiState) {
-                        if (sp.name() == "soundfont") {
-                              QFileInfo fi(sp.sval());
-                              if(fi.exists())
-                                    hasSoundfont = true;
-                              }
+            }
+      else if (tag == "Layer") {
+            Layer layer;
+            layer.name = ee.attribute("name");
+            layer.tags = ee.attribute("mask").toUInt();
+            _layer.append(layer);
+            }
+      else if (tag == "currentLayer")
+            _currentLayer = val.toInt();
+      else if (tag == "SyntiSettings") {
+            _syntiState.clear();
+            _syntiState.read(ee);
+            //
+            // check for soundfont,
+            // add default soundfont if none found
+            // (for compatibility with old scores)
+            //
+            bool hasSoundfont = false;
+            foreach(const SyntiParameter& sp, _syntiState) {
+                  if (sp.name() == "soundfont") {
+                        QFileInfo fi(sp.sval());
+                        if(fi.exists())
+                              hasSoundfont = true;
                         }
-                  if (!hasSoundfont)
-                        _syntiState.append(SyntiParameter("soundfont", MScore::soundFont));
-                  }
-            else if (tag == "Spatium")
-                  _style.setSpatium (val.toDouble() * DPMM); // obsolete, moved to Style
-            else if (tag == "page-offset")            // obsolete, moved to Score
-                  setPageNumberOffset(i);
-            else if (tag == "Division")
-                  _fileDivision = i;
-            else if (tag == "showInvisible")
-                  _showInvisible = i;
-            else if (tag == "showUnprintable")
-                  _showUnprintable = i;
-            else if (tag == "showFrames")
-                  _showFrames = i;
-            else if (tag == "showMargins")
-                  _showPageborders = i;
-            else if (tag == "Style")
-                  _style.load(ee);
-            else if (tag == "TextStyle") {      // obsolete: is now part of style
-                  TextStyle s;
-                  s.read(ee);
-                  // settings for _reloff::x and _reloff::y in old formats
-                  // is now included in style; setting them to 0 fixes most
-                  // cases of backward compatibility
-                  s.setRxoff(0);
-                  s.setRyoff(0);
-                  _style.setTextStyle(s);
-                  }
-            else if (tag == "page-layout")
-                  pageFormat()->read(ee, this);
-            else if (tag == "copyright" || tag == "rights") {
-                  Text* text = new Text(this);
-                  text->read(ee);
-                  setMetaTag("copyright", text->getText());
-                  delete text;
-                  }
-            else if (tag == "movement-number")
-                  setMetaTag("movementNumber", val);
-            else if (tag == "movement-title")
-                  setMetaTag("movementTitle", val);
-            else if (tag == "work-number")
-                  setMetaTag("workNumber", val);
-            else if (tag == "work-title")
-                  setMetaTag("workTitle", val);
-            else if (tag == "source")
-                  setMetaTag("source", val);
-            else if (tag == "metaTag") {
-                  QString name = ee.attribute("name");
-                  setMetaTag(name, val);
-                  }
-            else if (tag == "Part") {
-                  Part* part = new Part(this);
-                  part->read(ee);
-                  _parts.push_back(part);
-                  }
-            else if (tag == "Symbols")    // obsolete
-                  ;
-            else if (tag == "cursorTrack") {
-                  if (i >= 0)
-                        setInputTrack(i);
-                  }
-            else if (tag == "Slur") {
-                  Slur* slur = new Slur(this);
-                  slur->read(ee);
-                  slurs.append(slur);
-                  }
-            else if ((_mscVersion < 116) &&     // skip and process in II. pass
-               ((tag == "HairPin")
-                || (tag == "Ottava")
-                || (tag == "TextLine")
-                || (tag == "Volta")
-                || (tag == "Trill")
-                || (tag == "Pedal"))) {
-                  ;
-                  }
-            else if (tag == "Excerpt") {
-                  Excerpt* e = new Excerpt(this);
-                  e->read(ee);
-                  _excerpts.append(e);
                   }
-            else if (tag == "Beam") {
-                  Beam* beam = new Beam(this);
-                  beam->read(ee);
-                  beam->setParent(0);
-                  // _beams.append(beam);
-                  }
-            else if (tag == "Score") {          // recursion
-                  Score* s = new Score(style());
-                  s->setParentScore(this);
-                  s->read(ee);
-                  addExcerpt(s);
-                  }
-            else if (tag == "PageList") {
-                  for (QDomElement e = ee.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
-                        QString tag(e.tagName());
-                        if (e.tagName() == "Page") {
-                              Page* page = new Page(this);
-                              _pages.append(page);
-                              page->read(e);
-                              }
-                        else
-                              domError(e);
+            if (!hasSoundfont)
+                  _syntiState.append(SyntiParameter("soundfont", MScore::soundFont));
+            }
+      else if (tag == "Spatium")
+            _style.setSpatium (val.toDouble() * DPMM); // obsolete, moved to Style
+      else if (tag == "page-offset")            // obsolete, moved to Score
+            setPageNumberOffset(i);
+      else if (tag == "Division")
+            _fileDivision = i;
+      else if (tag == "showInvisible")
+            _showInvisible = i;
+      else if (tag == "showUnprintable")
+            _showUnprintable = i;
+      else if (tag == "showFrames")
+            _showFrames = i;
+      else if (tag == "showMargins")
+            _showPageborders = i;
+      else if (tag == "Style")
+            _style.load(ee);
+      else if (tag == "TextStyle") {      // obsolete: is now part of style
+            TextStyle s;
+            s.read(ee);
+            // settings for _reloff::x and _reloff::y in old formats
+            // is now included in style; setting them to 0 fixes most
+            // cases of backward compatibility
+            s.setRxoff(0);
+            s.setRyoff(0);
+            _style.setTextStyle(s);
+            }
+      else if (tag == "page-layout")
+            pageFormat()->read(ee, this);
+      else if (tag == "copyright" || tag == "rights") {
+            Text* text = new Text(this);
+            text->read(ee);
+            setMetaTag("copyright", text->getText());
+            delete text;
+            }
+      else if (tag == "movement-number")
+            setMetaTag("movementNumber", val);
+      else if (tag == "movement-title")
+            setMetaTag("movementTitle", val);
+      else if (tag == "work-number")
+            setMetaTag("workNumber", val);
+      else if (tag == "work-title")
+            setMetaTag("workTitle", val);
+      else if (tag == "source")
+            setMetaTag("source", val);
+      else if (tag == "metaTag") {
+            QString name = ee.attribute("name");
+            setMetaTag(name, val);
+            }
+      else if (tag == "Part") {
+            Part* part = new Part(this);
+            part->read(ee);
+            _parts.push_back(part);
+            }
+      else if (tag == "Symbols")    // obsolete
+            ;
+      else if (tag == "cursorTrack") {
+            if (i >= 0)
+                  setInputTrack(i);
+            }
+      else if (tag == "Slur") {
+            Slur* slur = new Slur(this);
+            slur->read(ee);
+            slurs.append(slur);
+            }
+      else if ((_mscVersion < 116) &&     // skip and process in II. pass
+         ((tag == "HairPin")
+          || (tag == "Ottava")
+          || (tag == "TextLine")
+          || (tag == "Volta")
+          || (tag == "Trill")
+          || (tag == "Pedal"))) {
+            ;
+            }
+      else if (tag == "Excerpt") {
+            Excerpt* e = new Excerpt(this);
+            e->read(ee);
+            _excerpts.append(e);
+            }
+      else if (tag == "Beam") {
+            Beam* beam = new Beam(this);
+            beam->read(ee);
+            beam->setParent(0);
+            // _beams.append(beam);
+            }
+      else if (tag == "Score") {          // recursion
+            Score* s = new Score(style());
+            s->setParentScore(this);
+            s->read(ee);
+            addExcerpt(s);
+            }
+      else if (tag == "PageList") {
+            for (QDomElement e = ee.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
+                  QString tag(e.tagName());
+                  if (e.tagName() == "Page") {
+                        Page* page = new Page(this);
+                        _pages.append(page);
+                        page->read(e);
                         }
+                  else
+                        domError(e);
                   }
-            else if (tag == "name")
-                  setName(val);
-            else
-                  domError(ee);
             }
+      else if (tag == "name")
+            setName(val);
+      else
+            domError(ee);
+      }
+
+//---------------------------------------------------------
+//   readEnd
+//    fix up score after reading; dScore is the first
+//    child of <Score> for old files which need a second
+//    pass over the dom
+//---------------------------------------------------------
 
+void Score::readEnd(QDomElement dScore)
+      {
       if (_mscVersion < 108)
             connectSlurs();
 
@@ -1237,7 +1444,6 @@ bool Score::read(QDomElement dScore)
       rebuildMidiMapping();
       updateChannel();
       updateNotes();    // only for parts needed?
-      return true;
       }
 
 //---------------------------------------------------------
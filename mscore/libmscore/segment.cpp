@@ -68,11 +68,11 @@ void Segment::setElement(int track, Element* el)
       {
       if (el) {
             el->setParent(this);
-            _elist[track] = el;
+            setTrackElement(track, el);
             empty = false;
             }
       else {
-            _elist[track] = 0;
+            setTrackElement(track, 0);
             checkEmpty();
             }
       }
@@ -112,8 +112,8 @@ Segment::Segment(Measure* m, SegmentType st, int t)
       {
       setParent(m);
       setSubtype(st);
-      setTick(t);
       init();
+      setTick(t);
       empty = true;
       }
 
@@ -144,6 +144,7 @@ Segment::Segment(const Segment& s)
                   }
             _elist.append(ne);
             }
+      _elementTypes = s._elementTypes;
       _dotPosX = s._dotPosX;
       }
 
@@ -185,12 +186,9 @@ void Segment::init()
       {
       int staves = score()->nstaves();
       int tracks = staves * VOICES;
-      _elist.reserve(tracks);
-      for (int i = 0; i < tracks; ++i)
-            _elist.push_back(0);
-      _dotPosX.reserve(staves);
-      for (int i = 0; i < staves; ++i)
-            _dotPosX.push_back(0.0);
+      _elist.fill(0, tracks);
+      _elementTypes.fill(INVALID, tracks);
+      _dotPosX.fill(0.0, staves);
       _prev = 0;
       _next = 0;
       }
@@ -324,8 +322,8 @@ ChordRest* Segment::nextChordRest(int track, bool backwards) const
 void Segment::insertStaff(int staff)
       {
       int track = staff * VOICES;
-      for (int voice = 0; voice < VOICES; ++voice)
-            _elist.insert(track, 0);
+      _elist.insert(track, VOICES, 0);
+      _elementTypes.insert(track, VOICES, INVALID);
       _dotPosX.insert(staff, 0.0);
       fixStaffIdx();
       }
@@ -337,8 +335,9 @@ void Segment::insertStaff(int staff)
 void Segment::removeStaff(int staff)
       {
       int track = staff * VOICES;
-      _elist.erase(_elist.begin() + track, _elist.begin() + track + VOICES);
-      _dotPosX.removeAt(staff);
+      _elist.remove(track, VOICES);
+      _elementTypes.remove(track, VOICES);
+      _dotPosX.remove(staff);
 
       foreach(Element* e, _annotations) {
             int staffIdx = e->staffIdx();
@@ -391,14 +390,14 @@ void Segment::add(Element* el)
       switch(el->type()) {
             case REPEAT_MEASURE:
                   measure()->setRepeatFlags(measure()->repeatFlags() | RepeatMeasureFlag);
-                  _elist[track] = el;
+                  setTrackElement(track, el);
                   empty = false;
                   break;
 
             case HAIRPIN:
                   addSpanner(static_cast<Spanner*>(el));
                   score()->updateHairpin(static_cast<Hairpin*>(el));
-                  score()->setPlaylistDirty(true);
+                  score()->invalidateEvents();
                   break;
 
             case OTTAVA:
@@ -413,7 +412,7 @@ void Segment::add(Element* el)
                         st->pitchOffsets().setPitchOffset(tick(), shift);
                         st->pitchOffsets().setPitchOffset(tick2, 0);
                         }
-                  score()->setPlaylistDirty(true);
+                  score()->invalidateEvents();
                   }
                   break;
 
@@ -459,13 +458,13 @@ void Segment::add(Element* el)
                   }
 
             case CLEF:
-                  _elist[track] = el;
+                  setTrackElement(track, el);
                   el->staff()->addClef(static_cast<Clef*>(el));
                   empty = false;
                   break;
 
             case TIMESIG:
-                  _elist[track] = el;
+                  setTrackElement(track, el);
                   el->staff()->addTimeSig(static_cast<TimeSig*>(el));
                   empty = false;
                   break;
@@ -487,7 +486,7 @@ void Segment::add(Element* el)
                         measure()->mstaff(staffIdx)->hasVoices = true;
 
             default:
-                  _elist[track] = el;
+                  setTrackElement(track, el);
                   empty = false;
                   break;
             }
@@ -510,7 +509,7 @@ void Segment::remove(Element* el)
                   ChordRest* cr = (ChordRest*)el;
                   if (cr->tuplet())
                         cr->tuplet()->remove(cr);
-                  _elist[track] = 0;
+                  setTrackElement(track, 0);
                   int staffIdx = cr->staffIdx();
                   measure()->checkMultiVoices(staffIdx);
                   }
@@ -518,7 +517,7 @@ void Segment::remove(Element* el)
 
             case REPEAT_MEASURE:
                   measure()->setRepeatFlags(measure()->repeatFlags() & ~RepeatMeasureFlag);
-                  _elist[track] = 0;
+                  setTrackElement(track, 0);
                   break;
 
             case OTTAVA:
@@ -530,14 +529,14 @@ void Segment::remove(Element* el)
                   st->pitchOffsets().remove(tick());
                   st->pitchOffsets().remove(tick2);
                   removeSpanner(static_cast<Spanner*>(el));
-                  score()->setPlaylistDirty(true);
+                  score()->invalidateEvents();
                   }
                   break;
 
             case HAIRPIN:
                   score()->removeHairpin(static_cast<Hairpin*>(el));
                   removeSpanner(static_cast<Spanner*>(el));
-                  score()->setPlaylistDirty(true);
+                  score()->invalidateEvents();
                   break;
 
             case VOLTA:
@@ -583,17 +582,17 @@ void Segment::remove(Element* el)
                   break;
 
             case CLEF:
-                  _elist[track] = 0;
+                  setTrackElement(track, 0);
                   el->staff()->removeClef(static_cast<Clef*>(el));
                   break;
 
             case TIMESIG:
-                  _elist[track] = 0;
+                  setTrackElement(track, 0);
                   el->staff()->removeTimeSig(static_cast<TimeSig*>(el));
                   break;
 
             default:
-                  _elist[track] = 0;
+                  setTrackElement(track, 0);
                   break;
             }
       checkEmpty();
@@ -635,7 +634,7 @@ void Segment::removeGeneratedElements()
       {
       for (int i = 0; i < _elist.size(); ++i) {
             if (_elist[i] && _elist[i]->generated()) {
-                  _elist[i] = 0;
+                  setTrackElement(i, 0);
                   }
             }
       checkEmpty();
@@ -647,12 +646,12 @@ void Segment::removeGeneratedElements()
 
 void Segment::sortStaves(QList<int>& dst)
       {
-      QList<Element*>   dl;
+      QVector<Element*> dl;
 
+      dl.reserve(dst.size() * VOICES);
       for (int i = 0; i < dst.size(); ++i) {
             int startTrack = dst[i] * VOICES;
             int endTrack   = startTrack + VOICES;
-            dl.reserve(VOICES);
             for (int k = startTrack; k < endTrack; ++k)
                   dl.append(_elist[k]);
             }
@@ -662,15 +661,18 @@ void Segment::sortStaves(QList<int>& dst)
 
 //---------------------------------------------------------
 //   fixStaffIdx
+//    also resyncs the type tags after staves were moved
 //---------------------------------------------------------
 
 void Segment::fixStaffIdx()
       {
-      int track = 0;
-      foreach(Element* e, _elist) {
+      int n = _elist.size();
+      _elementTypes.resize(n);
+      for (int track = 0; track < n; ++track) {
+            Element* e = _elist[track];
             if (e)
                   e->setTrack(track);
-            ++track;
+            _elementTypes[track] = e ? e->type() : INVALID;
             }
       }
 
@@ -704,7 +706,20 @@ int Segment::tick() const
 
 void Segment::setTick(int t)
       {
-      _tick = t - measure()->tick();
+      setRtick(t - measure()->tick());
+      }
+
+//---------------------------------------------------------
+//   setRtick
+//    the segment list of the measure has to know if
+//    this breaks the tick order of its segments
+//---------------------------------------------------------
+
+void Segment::setRtick(int val)
+      {
+      _tick = val;
+      if (_prev || _next)
+            measure()->segments()->tickChanged(this);
       }
 
 //---------------------------------------------------------
@@ -734,7 +749,8 @@ const QList<Lyrics*>* Segment::lyricsList(int staffIdx) const
 
 void Segment::swapElements(int i1, int i2)
       {
-      _elist.swap(i1, i2);
+      qSwap(_elist[i1], _elist[i2]);
+      qSwap(_elementTypes[i1], _elementTypes[i2]);
       if (_elist[i1])
             _elist[i1]->setTrack(i1);
       if (_elist[i2])
@@ -57,14 +57,19 @@ class Segment : public Element {
 
       mutable bool empty;           // cached value
       int _tick;
-      QList<qreal>   _dotPosX;     ///< size = staves
+      QVector<qreal> _dotPosX;     ///< size = staves
 
       QList<Spanner*> _spannerFor;
       QList<Spanner*> _spannerBack;
       QList<Element*> _annotations;
 
-      QList<Element*> _elist;      ///< Element storage, size = staves * VOICES.
+      QVector<Element*> _elist;    ///< Element storage, size = staves * VOICES.
+      QVector<uchar> _elementTypes; ///< type() of _elist elements, INVALID if empty
 
+      void setTrackElement(int track, Element* e) {
+            _elist[track]        = e;
+            _elementTypes[track] = e ? e->type() : INVALID;
+            }
       void init();
       void checkEmpty() const;
       void addSpanner(Spanner*);
@@ -78,6 +83,7 @@ class Segment : public Element {
 
       virtual Segment* clone() const    { return new Segment(*this); }
       virtual ElementType type() const  { return SEGMENT; }
+      ELEMENT_POOL(SEGMENT)
       virtual void setScore(Score*);
 
       Segment* next() const             { return _next;   }
@@ -98,7 +104,8 @@ class Segment : public Element {
       ChordRest* nextChordRest(int track, bool backwards = false) const;
 
       Element* element(int track) const    { return _elist.value(track);  }
-      const QList<Element*>& elist() const { return _elist; }
+      ElementType elementType(int track) const { return ElementType(_elementTypes.value(track)); }
+      const QVector<Element*>& elist() const { return _elist; }
 
       void removeElement(int track);
       void setElement(int track, Element* el);
@@ -128,7 +135,7 @@ class Segment : public Element {
       void setTick(int);
       int tick() const;
       int rtick() const       { return _tick; } // tickposition relative to measure start
-      void setRtick(int val)  { _tick = val; }
+      void setRtick(int val);
 
       QList<Spanner*> spannerFor() const { return _spannerFor;  }
       QList<Spanner*> spannerBack() const { return _spannerBack;       }
@@ -37,14 +37,130 @@ SegmentList SegmentList::clone() const
 
 void SegmentList::check()
       {
+#ifndef NDEBUG
       int n = 0;
-      for (Segment* s = _first; s; s = s->next())
+      for (Segment* s = _first; s; s = s->next()) {
+            if (n >= _index.size() || _index[n] != s) {
+                  printf("SegmentList::check: index out of sync at %d\n", n);
+                  abort();
+                  }
             ++n;
-      if (n != _size) {
-            printf("SegmentList::check: wrong segment segments %d count %d\n", n, _size);
+            }
+      if (n != _size || n != _index.size()) {
+            printf("SegmentList::check: wrong segment segments %d count %d index %d\n",
+               n, _size, _index.size());
             _size = n;
             abort();
             }
+      if (_sorted) {
+            for (int i = 1; i < n; ++i) {
+                  if (_index[i-1]->rtick() > _index[i]->rtick()) {
+                        printf("SegmentList::check: index not sorted at %d\n", i);
+                        abort();
+                        }
+                  }
+            }
+#endif
+      }
+
+//---------------------------------------------------------
+//   sorted
+//    return true if _index is ordered by rtick; after
+//    the order was broken check if it is restored
+//---------------------------------------------------------
+
+bool SegmentList::sorted() const
+      {
+      if (!_sorted) {
+            int n = _index.size();
+            int i = 1;
+            while (i < n && _index[i-1]->rtick() <= _index[i]->rtick())
+                  ++i;
+            _sorted = i >= n;
+            }
+      return _sorted;
+      }
+
+//---------------------------------------------------------
+//   tickChanged
+//    called after the tick of segment s changed or s
+//    was inserted
+//---------------------------------------------------------
+
+void SegmentList::tickChanged(Segment* s)
+      {
+      if ((s->prev() && s->prev()->rtick() > s->rtick())
+         || (s->next() && s->next()->rtick() < s->rtick()))
+            _sorted = false;
+      }
+
+//---------------------------------------------------------
+//   lowerBoundIdx
+//    return index of first segment with rtick >= t
+//---------------------------------------------------------
+
+int SegmentList::lowerBoundIdx(int t) const
+      {
+      if (!sorted()) {
+            int n = _index.size();
+            int i = 0;
+            while (i < n && _index[i]->rtick() < t)
+                  ++i;
+            return i;
+            }
+      int lo = 0;
+      int hi = _index.size();
+      while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (_index[mid]->rtick() < t)
+                  lo = mid + 1;
+            else
+                  hi = mid;
+            }
+      return lo;
+      }
+
+//---------------------------------------------------------
+//   indexOf
+//---------------------------------------------------------
+
+int SegmentList::indexOf(const Segment* s) const
+      {
+      if (!_sorted)
+            return _index.indexOf(const_cast<Segment*>(s));
+      int n = _index.size();
+      for (int i = lowerBoundIdx(s->rtick()); i < n && _index[i]->rtick() == s->rtick(); ++i) {
+            if (_index[i] == s)
+                  return i;
+            }
+      // s changed its tick without tickChanged()
+      return _index.indexOf(const_cast<Segment*>(s));
+      }
+
+//---------------------------------------------------------
+//   lowerBound
+//    return first segment with rtick >= t
+//---------------------------------------------------------
+
+Segment* SegmentList::lowerBound(int t) const
+      {
+      int idx = lowerBoundIdx(t);
+      return idx < _index.size() ? _index[idx] : 0;
+      }
+
+//---------------------------------------------------------
+//   find
+//    find segment of type st at rtick t
+//---------------------------------------------------------
+
+Segment* SegmentList::find(SegmentType st, int t) const
+      {
+      int n = _index.size();
+      for (int i = lowerBoundIdx(t); i < n && _index[i]->rtick() == t; ++i) {
+            if (_index[i]->subtype() == st)
+                  return _index[i];
+            }
+      return 0;
       }
 
 //---------------------------------------------------------
@@ -65,11 +181,13 @@ void SegmentList::insert(Segment* e, Segment* el)
             push_front(e);
             return;
             }
+      _index.insert(indexOf(el), e);
       ++_size;
       e->setNext(el);
       e->setPrev(el->prev());
       el->prev()->setNext(e);
       el->setPrev(e);
+      tickChanged(e);
       check();
       }
 
@@ -79,6 +197,7 @@ void SegmentList::insert(Segment* e, Segment* el)
 
 void SegmentList::remove(Segment* el)
       {
+      _index.remove(indexOf(el));
       --_size;
       if (el == _first) {
             _first = _first->next();
@@ -105,6 +224,7 @@ void SegmentList::remove(Segment* el)
 
 void SegmentList::push_back(Segment* e)
       {
+      _index.append(e);
       ++_size;
       if (_last) {
             _last->setNext(e);
@@ -117,6 +237,7 @@ void SegmentList::push_back(Segment* e)
             e->setNext(0);
             }
       _last = e;
+      tickChanged(e);
       check();
       }
 
@@ -126,6 +247,7 @@ void SegmentList::push_back(Segment* e)
 
 void SegmentList::push_front(Segment* e)
       {
+      _index.prepend(e);
       ++_size;
       if (_first) {
             _first->setPrev(e);
@@ -138,6 +260,7 @@ void SegmentList::push_front(Segment* e)
             e->setNext(0);
             }
       _first = e;
+      tickChanged(e);
       check();
       }
 
@@ -147,6 +270,7 @@ void SegmentList::push_front(Segment* e)
 
 void SegmentList::insert(Segment* seg)
       {
+      _index.insert(seg->next() ? indexOf(seg->next()) : _index.size(), seg);
       if (seg->prev())
             seg->prev()->setNext(seg);
       else
@@ -156,6 +280,7 @@ void SegmentList::insert(Segment* seg)
       else
             _last = seg;
       ++_size;
+      tickChanged(seg);
       check();
       }
 
@@ -19,16 +19,28 @@ class Segment;
 
 //---------------------------------------------------------
 //   SegmentList
+//    doubly linked list of segments; _index holds the
+//    same segments in list order for binary search by
+//    rtick. While a measure is rearranged the ticks can
+//    be out of order; then _sorted is false and searches
+//    fall back to a linear scan until the order is
+//    restored.
 //---------------------------------------------------------
 
 class SegmentList {
       Segment* _first;        ///< First item of segment list
       Segment* _last;         ///< Last item of segment list
       int _size;              ///< Number of items in segment list
+      QVector<Segment*> _index;
+      mutable bool _sorted;   ///< _index is ordered by rtick
+
+      bool sorted() const;
+      int lowerBoundIdx(int rtick) const;
+      int indexOf(const Segment*) const;
 
    public:
       SegmentList()                        { clear(); }
-      void clear()                         { _first = _last = 0; _size = 0; }
+      void clear()                         { _first = _last = 0; _size = 0; _index.clear(); _sorted = true; }
       void check();
 
       SegmentList clone() const;
@@ -39,11 +51,14 @@ class SegmentList {
 
       Segment* last() const                { return _last;        }
       Segment* firstCRSegment() const;
+      Segment* lowerBound(int rtick) const;
+      Segment* find(SegmentType, int rtick) const;
       void remove(Segment*);
       void push_back(Segment*);
       void push_front(Segment*);
       void insert(Segment*);
       void insert(Segment* e, Segment* el);
+      void tickChanged(Segment*);
       };
 
 #endif
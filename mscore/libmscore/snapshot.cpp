@@ -0,0 +1,625 @@
+//=============================================================================
+//  MuseScore
+//  Music Composition & Notation
+//  $Id:$
+//
+//  Copyright (C) 2011 Werner Schweer
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2
+//  as published by the Free Software Foundation and appearing in
+//  the file LICENCE.GPL
+//=============================================================================
+
+#include "snapshot.h"
+#include "score.h"
+#include "xml.h"
+
+//
+//    file layout:
+//       "MSCB" version token...
+//    tokens:
+//       SNAP_NAME   string                  define the next name number
+//       SNAP_START  name n (name string)*n  start tag with n attributes
+//       SNAP_TEXT   string
+//       SNAP_END                            end tag
+//    numbers are varints (7 bit groups, low first), strings
+//    are a number (length << 1 | utf16) followed by latin1
+//    bytes or little endian utf16 code units
+//
+
+enum {
+      SNAP_END, SNAP_START, SNAP_TEXT, SNAP_NAME
+      };
+
+static const char SNAPSHOT_MAGIC[] = "MSCB";
+
+//---------------------------------------------------------
+//   isWhite
+//    true if s is empty or whitespace only; such text
+//    is dropped like by QDomDocument::setContent()
+//---------------------------------------------------------
+
+static bool isWhite(const QString& s)
+      {
+      const QChar* p = s.unicode();
+      int n          = s.size();
+      for (int i = 0; i < n; ++i) {
+            if (!p[i].isSpace())
+                  return false;
+            }
+      return true;
+      }
+
+//---------------------------------------------------------
+//   SnapshotWriter
+//---------------------------------------------------------
+
+SnapshotWriter::SnapshotWriter(QByteArray& d)
+   : data(d)
+      {
+      data.reserve(64 * 1024);
+      data.append(SNAPSHOT_MAGIC, 4);
+      data.append(char(SNAPSHOT_VERSION));
+      }
+
+//---------------------------------------------------------
+//   putNumber
+//---------------------------------------------------------
+
+void SnapshotWriter::putNumber(quint32 n)
+      {
+      while (n >= 0x80) {
+            data.append(char(n | 0x80));
+            n >>= 7;
+            }
+      data.append(char(n));
+      }
+
+//---------------------------------------------------------
+//   putString
+//---------------------------------------------------------
+
+void SnapshotWriter::putString(const QStringRef& s)
+      {
+      const QChar* p = s.unicode();
+      int n          = s.size();
+      bool latin1    = true;
+      for (int i = 0; i < n; ++i) {
+            if (p[i].unicode() > 0xff) {
+                  latin1 = false;
+                  break;
+                  }
+            }
+      putNumber((n << 1) | (latin1 ? 0 : 1));
+      if (latin1) {
+            for (int i = 0; i < n; ++i)
+                  data.append(char(p[i].unicode()));
+            }
+      else {
+            for (int i = 0; i < n; ++i) {
+                  ushort c = p[i].unicode();
+                  data.append(char(c & 0xff));
+                  data.append(char(c >> 8));
+                  }
+            }
+      }
+
+//---------------------------------------------------------
+//   putName
+//    write the number of name s which must be defined
+//---------------------------------------------------------
+
+void SnapshotWriter::putName(const QString& s)
+      {
+      putNumber(names.value(s));
+      }
+
+//---------------------------------------------------------
+//   defineName
+//    write a SNAP_NAME token if s is a new name; names
+//    must be defined before the SNAP_START which uses them
+//---------------------------------------------------------
+
+void SnapshotWriter::defineName(const QString& s)
+      {
+      if (names.contains(s))
+            return;
+      names.insert(s, names.size());
+      putToken(SNAP_NAME);
+      putString(QStringRef(&s));
+      }
+
+//---------------------------------------------------------
+//   putElement
+//---------------------------------------------------------
+
+void SnapshotWriter::putElement(const QString& name, const QXmlStreamAttributes& attributes)
+      {
+      defineName(name);
+      foreach(const QXmlStreamAttribute& a, attributes)
+            defineName(a.name().toString());
+      putToken(SNAP_START);
+      putName(name);
+      putNumber(attributes.size());
+      foreach(const QXmlStreamAttribute& a, attributes) {
+            putName(a.name().toString());
+            putString(a.value());
+            }
+      }
+
+//---------------------------------------------------------
+//   parseTag
+//    split a tag as written by Xml::stag() into name and
+//    attributes; values are unescaped. Returns false if the
+//    tag uses anything but the predefined entities and
+//    character references.
+//---------------------------------------------------------
+
+bool SnapshotWriter::parseTag(const QString& tag, QString* name, QXmlStreamAttributes* attributes)
+      {
+      const QChar* p = tag.unicode();
+      const QChar* e = p + tag.size();
+      const QChar* s = p;
+      while (p < e && !p->isSpace())
+            ++p;
+      *name = QString(s, p - s);
+      while (p < e) {
+            while (p < e && p->isSpace())
+                  ++p;
+            if (p == e)
+                  break;
+            s = p;
+            while (p < e && *p != '=' && !p->isSpace())
+                  ++p;
+            if (p == e || *p != '=' || p == s)
+                  return false;
+            QString attribute(s, p - s);
+            ++p;
+            if (p == e || (*p != '"' && *p != '\''))
+                  return false;
+            QChar quote = *p++;
+            QString value;
+            for (;; ++p) {
+                  if (p == e || *p == '<')
+                        return false;
+                  if (*p == quote)
+                        break;
+                  if (*p == '&') {
+                        s = ++p;
+                        while (p < e && *p != ';')
+                              ++p;
+                        if (p == e)
+                              return false;
+                        QString entity(s, p - s);
+                        if (entity == "amp")
+                              value += '&';
+                        else if (entity == "lt")
+                              value += '<';
+                        else if (entity == "gt")
+                              value += '>';
+                        else if (entity == "apos")
+                              value += '\'';
+                        else if (entity == "quot")
+                              value += '"';
+                        else if (entity.startsWith('#')) {
+                              bool ok;
+                              uint c = entity.startsWith("#x")
+                                 ? entity.mid(2).toUInt(&ok, 16) : entity.mid(1).toUInt(&ok);
+                              if (!ok || c == 0 || c > 0x10ffff)
+                                    return false;
+                              value += QString::fromUcs4(&c, 1);
+                              }
+                        else
+                              return false;
+                        }
+                  else if (*p == '\n' || *p == '\r' || *p == '\t')
+                        value += ' ';     // attribute value normalization
+                  else
+                        value += *p;
+                  }
+            ++p;
+            attributes->append(attribute, value);
+            }
+      return !name->isEmpty();
+      }
+
+//---------------------------------------------------------
+//   startElement
+//    tag is "name" or "name attribute="value"..." as
+//    written by Xml::stag() and Xml::tagE()
+//---------------------------------------------------------
+
+void SnapshotWriter::startElement(const QString& tag)
+      {
+      QString name;
+      QXmlStreamAttributes attributes;
+      if (!parseTag(tag, &name, &attributes)) {
+            // let the xml parser sort out the unusual cases
+            QXmlStreamReader r(QString("<%1/>").arg(tag));
+            attributes.clear();
+            if (r.readNextStartElement()) {
+                  name       = r.name().toString();
+                  attributes = r.attributes();
+                  }
+            else {
+                  printf("SnapshotWriter: bad tag <%s>: %s\n",
+                     qPrintable(tag), qPrintable(r.errorString()));
+                  name = tag.left(tag.indexOf(' '));
+                  }
+            }
+      putElement(name, attributes);
+      }
+
+//---------------------------------------------------------
+//   endElement
+//---------------------------------------------------------
+
+void SnapshotWriter::endElement()
+      {
+      putToken(SNAP_END);
+      }
+
+//---------------------------------------------------------
+//   putText
+//    s is plain text, no xml
+//---------------------------------------------------------
+
+void SnapshotWriter::putText(const QString& s)
+      {
+      if (isWhite(s))
+            return;
+      putToken(SNAP_TEXT);
+      putString(QStringRef(&s));
+      }
+
+//---------------------------------------------------------
+//   putXml
+//    xml is a balanced xml fragment (text and complete
+//    elements) as written with Xml::operator<<()
+//---------------------------------------------------------
+
+void SnapshotWriter::putXml(const QByteArray& xml)
+      {
+      QXmlStreamReader r;
+      r.addData("<r>");
+      r.addData(xml);
+      r.addData("</r>");
+
+      QString text;
+      int level = 0;
+      while (!r.atEnd()) {
+            switch (r.readNext()) {
+                  case QXmlStreamReader::Characters:
+                        text += r.text();
+                        break;
+                  case QXmlStreamReader::StartElement:
+                  case QXmlStreamReader::EndElement:
+                        if (!text.isEmpty()) {
+                              putText(text);
+                              text.clear();
+                              }
+                        if (r.isStartElement()) {
+                              if (level++)
+                                    putElement(r.name().toString(), r.attributes());
+                              }
+                        else if (--level)
+                              putToken(SNAP_END);
+                        break;
+                  default:
+                        break;
+                  }
+            }
+      if (r.hasError())
+            printf("SnapshotWriter: %s in <%s>\n", qPrintable(r.errorString()), xml.constData());
+      }
+
+//---------------------------------------------------------
+//   SnapshotReader
+//    XmlReader for snapshots; the position reported on
+//    errors is the byte offset in the snapshot
+//---------------------------------------------------------
+
+class SnapshotReader : public XmlReader {
+      QByteArray data;
+      const uchar* start;
+      const uchar* p;
+      const uchar* end;
+      QVector<QString> names;
+      QString _name;
+      QXmlStreamAttributes _attributes;
+      QString _text;
+      int level;
+      QString _error;
+
+      void setError(const char* s) { if (_error.isEmpty()) _error = s; }
+      quint32 getNumber();
+      QString getString();
+      QString getName();
+      int readToken();
+
+   public:
+      SnapshotReader(const QByteArray&);
+      virtual bool readNextStartElement();
+      virtual QStringRef name() const                 { return QStringRef(&_name); }
+      virtual QXmlStreamAttributes attributes() const { return _attributes; }
+      virtual QString readElementText();
+      virtual void skipCurrentElement();
+      virtual QDomElement readDomElement(QDomDocument* doc);
+      virtual bool hasError() const                   { return !_error.isEmpty(); }
+      virtual QString errorString() const             { return _error; }
+      virtual qint64 lineNumber() const               { return 0; }
+      virtual qint64 columnNumber() const             { return p - start; }
+      };
+
+//---------------------------------------------------------
+//   SnapshotReader
+//---------------------------------------------------------
+
+SnapshotReader::SnapshotReader(const QByteArray& d)
+   : data(d)
+      {
+      start = (const uchar*)data.constData();
+      p     = start;
+      end   = start + data.size();
+      level = 0;
+      if (data.size() < 5 || memcmp(start, SNAPSHOT_MAGIC, 4) || data[4] != char(SNAPSHOT_VERSION))
+            setError("no snapshot or other snapshot version");
+      else
+            p += 5;
+      }
+
+//---------------------------------------------------------
+//   getNumber
+//---------------------------------------------------------
+
+quint32 SnapshotReader::getNumber()
+      {
+      quint32 n = 0;
+      for (int shift = 0; shift < 32; shift += 7) {
+            if (p >= end)
+                  break;
+            uchar c = *p++;
+            n |= quint32(c & 0x7f) << shift;
+            if (!(c & 0x80))
+                  return n;
+            }
+      setError("damaged number");
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   getString
+//---------------------------------------------------------
+
+QString SnapshotReader::getString()
+      {
+      quint32 n   = getNumber();
+      bool utf16  = n & 1;
+      n >>= 1;
+      if (quint32(end - p) < (utf16 ? n * 2 : n)) {
+            setError("damaged string");
+            return QString();
+            }
+      QString s;
+      if (utf16) {
+            s.resize(n);
+            QChar* d = s.data();
+            for (quint32 i = 0; i < n; ++i, p += 2)
+                  d[i] = QChar(ushort(p[0] | (p[1] << 8)));
+            }
+      else {
+            s = QString::fromLatin1((const char*)p, n);
+            p += n;
+            }
+      return s;
+      }
+
+//---------------------------------------------------------
+//   getName
+//---------------------------------------------------------
+
+QString SnapshotReader::getName()
+      {
+      quint32 n = getNumber();
+      if (n >= quint32(names.size())) {
+            setError("undefined name");
+            return QString();
+            }
+      return names[n];
+      }
+
+//---------------------------------------------------------
+//   readToken
+//    return SNAP_START (name and attributes are set),
+//    SNAP_TEXT (text is set), SNAP_END or -1 at the end of
+//    the snapshot and on errors
+//---------------------------------------------------------
+
+int SnapshotReader::readToken()
+      {
+      while (_error.isEmpty()) {
+            if (p >= end) {
+                  if (level)
+                        setError("premature end of snapshot");
+                  return -1;
+                  }
+            int token = *p++;
+            switch (token) {
+                  case SNAP_NAME:
+                        names.append(getString());
+                        break;
+                  case SNAP_START:
+                        {
+                        _name = getName();
+                        _attributes.clear();
+                        int n = getNumber();
+                        for (int i = 0; i < n && _error.isEmpty(); ++i) {
+                              QString attribute = getName();
+                              _attributes.append(attribute, getString());
+                              }
+                        ++level;
+                        }
+                        return _error.isEmpty() ? token : -1;
+                  case SNAP_TEXT:
+                        _text = getString();
+                        return _error.isEmpty() ? token : -1;
+                  case SNAP_END:
+                        if (level == 0) {
+                              setError("unbalanced end tag");
+                              return -1;
+                              }
+                        --level;
+                        return token;
+                  default:
+                        setError("damaged snapshot");
+                        return -1;
+                  }
+            }
+      return -1;
+      }
+
+//---------------------------------------------------------
+//   readNextStartElement
+//    like QXmlStreamReader: read up to the next child
+//    start tag; false at the end tag of the current element
+//---------------------------------------------------------
+
+bool SnapshotReader::readNextStartElement()
+      {
+      for (;;) {
+            switch (readToken()) {
+                  case SNAP_START:
+                        return true;
+                  case SNAP_TEXT:
+                        break;
+                  default:
+                        return false;
+                  }
+            }
+      }
+
+//---------------------------------------------------------
+//   readElementText
+//    text of the current element including the text of
+//    child elements
+//---------------------------------------------------------
+
+QString SnapshotReader::readElementText()
+      {
+      QString s;
+      int depth = 1;
+      for (;;) {
+            switch (readToken()) {
+                  case SNAP_TEXT:
+                        s += _text;
+                        break;
+                  case SNAP_START:
+                        ++depth;
+                        break;
+                  case SNAP_END:
+                        if (--depth == 0)
+                              return s;
+                        break;
+                  default:
+                        return s;
+                  }
+            }
+      }
+
+//---------------------------------------------------------
+//   skipCurrentElement
+//---------------------------------------------------------
+
+void SnapshotReader::skipCurrentElement()
+      {
+      int depth = 1;
+      for (;;) {
+            switch (readToken()) {
+                  case SNAP_TEXT:
+                        break;
+                  case SNAP_START:
+                        ++depth;
+                        break;
+                  case SNAP_END:
+                        if (--depth == 0)
+                              return;
+                        break;
+                  default:
+                        return;
+                  }
+            }
+      }
+
+//---------------------------------------------------------
+//   readDomElement
+//    same as XmlReader::readDomElement(); whitespace only
+//    text is not in the snapshot
+//---------------------------------------------------------
+
+QDomElement SnapshotReader::readDomElement(QDomDocument* doc)
+      {
+      QDomElement top = doc->createElement(_name);
+      foreach(const QXmlStreamAttribute& a, _attributes)
+            top.setAttribute(a.name().toString(), a.value().toString());
+      if (doc->documentElement().isNull())
+            doc->appendChild(top);
+
+      QDomElement cur = top;
+      int depth = 1;
+      while (depth) {
+            switch (readToken()) {
+                  case SNAP_TEXT:
+                        cur.appendChild(doc->createTextNode(_text));
+                        break;
+                  case SNAP_START:
+                        {
+                        QDomElement e = doc->createElement(_name);
+                        foreach(const QXmlStreamAttribute& a, _attributes)
+                              e.setAttribute(a.name().toString(), a.value().toString());
+                        cur.appendChild(e);
+                        cur = e;
+                        ++depth;
+                        }
+                        break;
+                  case SNAP_END:
+                        cur = cur.parentNode().toElement();
+                        --depth;
+                        break;
+                  default:
+                        return top;
+                  }
+            }
+      return top;
+      }
+
+//---------------------------------------------------------
+//   snapshot
+//    return the score as snapshot
+//---------------------------------------------------------
+
+QByteArray Score::snapshot()
+      {
+      QByteArray data;
+      SnapshotWriter w(data);
+      Xml xml(&w);
+      xml.writeOmr = false;
+      saveFile(xml);
+      xml.flush();
+      return data;
+      }
+
+//---------------------------------------------------------
+//   readSnapshot
+//    read score from snapshot; return false on error
+//---------------------------------------------------------
+
+bool Score::readSnapshot(const QByteArray& snapshot)
+      {
+      SnapshotReader r(snapshot);
+      if (r.hasError()) {
+            MScore::lastError = QT_TRANSLATE_NOOP("score", "damaged score snapshot");
+            return false;
+            }
+      return read1(r, 0);
+      }
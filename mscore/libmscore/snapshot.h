@@ -0,0 +1,65 @@
+//=============================================================================
+//  MuseScore
+//  Music Composition & Notation
+//  $Id:$
+//
+//  Copyright (C) 2011 Werner Schweer
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2
+//  as published by the Free Software Foundation and appearing in
+//  the file LICENCE.GPL
+//=============================================================================
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+//---------------------------------------------------------
+//   snapshot
+//    A snapshot is a compact binary form of the element tree
+//    of a score file: start tags with their attributes, text
+//    and end tags. Tag and attribute names are stored once
+//    and then referenced by number, numbers are stored as
+//    varints and strings as latin1 if possible.
+//
+//    Score::snapshot() runs the normal write() functions on
+//    an Xml in snapshot mode, which passes tags and text to a
+//    SnapshotWriter instead of formatting xml text.
+//    Score::readSnapshot() reads through an XmlReader which
+//    takes its elements from the snapshot, so the streaming
+//    read path is shared with .mscx files and no document
+//    dom is built.
+//
+//    Snapshots are for caches and internal copies only; a
+//    snapshot of another SNAPSHOT_VERSION is rejected.
+//---------------------------------------------------------
+
+static const int SNAPSHOT_VERSION = 1;
+
+//---------------------------------------------------------
+//   SnapshotWriter
+//    token output of Xml in snapshot mode
+//---------------------------------------------------------
+
+class SnapshotWriter {
+      QByteArray& data;
+      QHash<QString, int> names;
+
+      void putToken(int t)  { data.append(char(t)); }
+      void putNumber(quint32 n);
+      void putString(const QStringRef&);
+      void putName(const QString&);
+      void defineName(const QString&);
+      void putElement(const QString& name, const QXmlStreamAttributes&);
+      bool parseTag(const QString& tag, QString* name, QXmlStreamAttributes*);
+
+   public:
+      SnapshotWriter(QByteArray& d);
+      void startElement(const QString& tag);
+      void endElement();
+      void putText(const QString&);
+      void putXml(const QByteArray&);
+      };
+
+#endif
+
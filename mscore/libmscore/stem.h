@@ -38,6 +38,7 @@ class Stem : public Element {
 
       virtual Stem* clone() const      { return new Stem(*this); }
       virtual ElementType type() const { return STEM; }
+      ELEMENT_POOL(STEM)
       virtual void draw(Painter*) const;
       void setLen(qreal v)            { _len = v; }
       qreal stemLen() const           { return _len + point(_userLen); }
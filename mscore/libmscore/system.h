@@ -120,6 +120,7 @@ class System : public Element {
       void clear();                       ///< Clear measure list.
 
       QList<MeasureBase*>& measures()        { return ml; }
+      const QList<SpannerSegment*>& spannerSegments() const { return _spannerSegments; }
 
       QRectF bboxStaff(int staff) const      { return _staves[staff]->bbox(); }
       QList<SysStaff*>* staves()             { return &_staves;   }
@@ -27,24 +27,90 @@
 #include "painter.h"
 #include "mscore.h"
 
+static const qreal TEXT_DOC_MARGIN = 1.0;
+
 //---------------------------------------------------------
-//   Text
+//   run
+//    return layout of single line text s
 //---------------------------------------------------------
 
-Text::Text(Score* s)
-   : Element(s)
+TextRun TextLayoutCache::run(const QFont& font, const QString& s)
+      {
+      QPair<QString, QString> key(font.key(), s);
       {
-      _doc = new QTextDocument(0);
-      _doc->setDocumentMargin(1.0);
-      _doc->setUseDesignMetrics(true);
-      _doc->setUndoRedoEnabled(true);
-      _doc->documentLayout()->setProperty("cursorWidth", QVariant(2));
+      QMutexLocker locker(&mutex);
+      QHash<QPair<QString, QString>, TextRun>::const_iterator i = runs.constFind(key);
+      if (i != runs.constEnd())
+            return i.value();
+      }
 
-      QTextOption to = _doc->defaultTextOption();
+      QTextLayout tl(s, font);
+      QTextOption to = tl.textOption();
       to.setUseDesignMetrics(true);
       to.setWrapMode(QTextOption::NoWrap);
-      _doc->setDefaultTextOption(to);
+      tl.setTextOption(to);
+      tl.beginLayout();
+      QTextLine line = tl.createLine();
+      if (line.isValid())
+            line.setPosition(QPointF(TEXT_DOC_MARGIN, TEXT_DOC_MARGIN));
+      tl.endLayout();
+
+      TextRun r;
+      if (line.isValid()) {
+            r.lineRect = line.rect();
+            r.textRect = line.naturalTextRect();
+            r.baseLine = line.y() + line.ascent();
+            r.size     = QSizeF(line.naturalTextWidth() + 2 * TEXT_DOC_MARGIN,
+               line.height() + 2 * TEXT_DOC_MARGIN);
+            }
+#if QT_VERSION >= 0x040800
+      r.glyphs = tl.glyphRuns();
+#endif
+
+      QMutexLocker locker(&mutex);
+      if (runs.size() > 20000)      // style changes leave stale fonts behind
+            runs.clear();
+      runs.insert(key, r);
+      return r;
+      }
 
+//---------------------------------------------------------
+//   clear
+//---------------------------------------------------------
+
+void TextLayoutCache::clear()
+      {
+      QMutexLocker locker(&mutex);
+      runs.clear();
+      }
+
+//---------------------------------------------------------
+//   newDocument
+//---------------------------------------------------------
+
+static QTextDocument* newDocument()
+      {
+      QTextDocument* doc = new QTextDocument(0);
+      doc->setDocumentMargin(TEXT_DOC_MARGIN);
+      doc->setUseDesignMetrics(true);
+      doc->setUndoRedoEnabled(true);
+      doc->documentLayout()->setProperty("cursorWidth", QVariant(2));
+
+      QTextOption to = doc->defaultTextOption();
+      to.setUseDesignMetrics(true);
+      to.setWrapMode(QTextOption::NoWrap);
+      doc->setDefaultTextOption(to);
+      return doc;
+      }
+
+//---------------------------------------------------------
+//   Text
+//---------------------------------------------------------
+
+Text::Text(Score* s)
+   : Element(s)
+      {
+      _doc       = 0;
       _editMode  = false;
       cursorPos  = 0;
       cursor     = 0;
@@ -58,7 +124,9 @@ Text::Text(Score* s)
 Text::Text(const Text& e)
    : Element(e)
       {
-      _doc                  = e._doc->clone();
+      _doc                  = e._doc ? e._doc->clone() : 0;
+      _text                 = e._text;
+      _run                  = e._run;
       frame                 = e.frame;
       _styled               = e._styled;
       _editMode             = e._editMode;
@@ -75,17 +143,32 @@ Text::~Text()
       }
 
 //---------------------------------------------------------
-//   setText
+//   doc
+//    create the QTextDocument on demand
 //---------------------------------------------------------
 
-void Text::setText(const QString& s)
+QTextDocument* Text::doc() const
+      {
+      if (_doc == 0) {
+            _doc = newDocument();
+            initDoc(_doc, _text);
+            }
+      return _doc;
+      }
+
+//---------------------------------------------------------
+//   initDoc
+//    fill doc with unformatted text s in style font
+//---------------------------------------------------------
+
+void Text::initDoc(QTextDocument* doc, const QString& s) const
       {
       Align align = style().align();
-      _doc->clear();
+      doc->clear();
       QFont font(style().font(spatium()));
-      _doc->setDefaultFont(font);
+      doc->setDefaultFont(font);
 
-      QTextCursor cursor(_doc);
+      QTextCursor cursor(doc);
       cursor.setVisualNavigation(true);
       cursor.movePosition(QTextCursor::Start);
       Qt::Alignment a;
@@ -103,6 +186,21 @@ void Text::setText(const QString& s)
       tf.setFont(font);
       cursor.setBlockCharFormat(tf);
       cursor.insertText(s);
+      }
+
+//---------------------------------------------------------
+//   setText
+//---------------------------------------------------------
+
+void Text::setText(const QString& s)
+      {
+      if (cursor)             // edit mode works on the document
+            initDoc(_doc, s);
+      else {
+            delete _doc;
+            _doc  = 0;
+            _text = s;
+            }
       textChanged();
       }
 
@@ -117,18 +215,32 @@ void Text::setText(const QTextDocumentFragment& f)
 
 void Text::setHtml(const QString& s)
       {
+      if (_doc == 0)
+            _doc = newDocument();
       _doc->clear();
       _doc->setHtml(s);
+      _text = QString();
       textChanged();
       }
 
+//---------------------------------------------------------
+//   clear
+//---------------------------------------------------------
+
+void Text::clear()
+      {
+      if (_doc)
+            _doc->clear();
+      _text = QString();
+      }
+
 //---------------------------------------------------------
 //   getText
 //---------------------------------------------------------
 
 QString Text::getText() const
       {
-      return _doc->toPlainText();
+      return _doc ? _doc->toPlainText() : _text;
       }
 
 //---------------------------------------------------------
@@ -137,7 +249,11 @@ QString Text::getText() const
 
 QString Text::getHtml() const
       {
-      return _doc->toHtml("utf-8");
+      if (_doc)
+            return _doc->toHtml("utf-8");
+      QScopedPointer<QTextDocument> d(newDocument());
+      initDoc(d.data(), _text);
+      return d->toHtml("utf-8");
       }
 
 //---------------------------------------------------------
@@ -253,7 +369,8 @@ void Text::setSubtype(const QString& s)
 
 void Text::layout()
       {
-      _doc->setDefaultFont(style().font(score()->spatium()));
+      if (_doc)
+            _doc->setDefaultFont(style().font(score()->spatium()));
       qreal w = -1.0;
       qreal x = 0.0;
       qreal y = 0.0;
@@ -267,10 +384,12 @@ void Text::layout()
                   }
             }
 
-      QTextOption to = _doc->defaultTextOption();
-      to.setUseDesignMetrics(true);
-      to.setWrapMode(w <= 0.0 ? QTextOption::NoWrap : QTextOption::WrapAtWordBoundaryOrAnywhere);
-      _doc->setDefaultTextOption(to);
+      if (_doc) {
+            QTextOption to = _doc->defaultTextOption();
+            to.setUseDesignMetrics(true);
+            to.setWrapMode(w <= 0.0 ? QTextOption::NoWrap : QTextOption::WrapAtWordBoundaryOrAnywhere);
+            _doc->setDefaultTextOption(to);
+            }
       layout(w, x, y);
       adjustReadPos();
       }
@@ -281,24 +400,36 @@ void Text::layout()
 
 void Text::layout(qreal layoutWidth, qreal x, qreal y)
       {
-      QTextOption to = _doc->defaultTextOption();
-      to.setUseDesignMetrics(true);
-      to.setWrapMode(layoutWidth < 0.0 ? QTextOption::NoWrap : QTextOption::WrapAtWordBoundaryOrAnywhere);
-      _doc->setDefaultTextOption(to);
+      // wrapped and multi line text needs the document layout
+      if (_doc == 0 && (layoutWidth >= 0.0 || _text.contains(QChar('\n'))))
+            doc();
 
-      if (layoutWidth < 0.0)
-            layoutWidth = _doc->idealWidth();
-      _doc->setTextWidth(layoutWidth);
+      if (_doc) {
+            QTextOption to = _doc->defaultTextOption();
+            to.setUseDesignMetrics(true);
+            to.setWrapMode(layoutWidth < 0.0 ? QTextOption::NoWrap : QTextOption::WrapAtWordBoundaryOrAnywhere);
+            _doc->setDefaultTextOption(to);
+
+            if (layoutWidth < 0.0)
+                  layoutWidth = _doc->idealWidth();
+            _doc->setTextWidth(layoutWidth);
+            }
+      else
+            _run = score()->textLayoutCache()->run(font(), _text);
 
       if (hasFrame()) {
             frame = QRectF();
-            for (QTextBlock tb = _doc->begin(); tb.isValid(); tb = tb.next()) {
-                  QTextLayout* tl = tb.layout();
-                  int n = tl->lineCount();
-                  for (int i = 0; i < n; ++i)
-                        // frame |= tl->lineAt(0).naturalTextRect().translated(tl->position());
-                        frame |= tl->lineAt(0).rect().translated(tl->position());
+            if (_doc) {
+                  for (QTextBlock tb = _doc->begin(); tb.isValid(); tb = tb.next()) {
+                        QTextLayout* tl = tb.layout();
+                        int n = tl->lineCount();
+                        for (int i = 0; i < n; ++i)
+                              // frame |= tl->lineAt(0).naturalTextRect().translated(tl->position());
+                              frame |= tl->lineAt(0).rect().translated(tl->position());
+                        }
                   }
+            else
+                  frame = _run.lineRect;
             if (circle()) {
                   if (frame.width() > frame.height()) {
                         frame.setY(frame.y() + (frame.width() - frame.height()) * -.5);
@@ -314,10 +445,10 @@ void Text::layout(qreal layoutWidth, qreal x, qreal y)
             w = frameWidth() * DPMM;
             setbbox(frame.adjusted(-w, -w, w, w));
             }
-      else {
-            setbbox(QRectF(QPointF(0.0, 0.0), _doc->size()));
-            }
-      _doc->setModified(false);
+      else
+            setbbox(QRectF(QPointF(0.0, 0.0), _doc ? _doc->size() : _run.size));
+      if (_doc)
+            _doc->setModified(false);
       style().layout(this);      // process alignment
 
       if ((style().align() & ALIGN_VCENTER) && (subtype() == TEXT_TEXTLINE)) {
@@ -404,15 +535,26 @@ void Text::draw(Painter* painter) const
       else
             color = style().foregroundColor();
 
-      c.palette.setColor(QPalette::Text, color);
-
+      if (_doc) {
+            c.palette.setColor(QPalette::Text, color);
 #if 1
-      // make it thread save
-      QScopedPointer<QTextDocument> __doc(_doc->clone());
-      painter->drawText(__doc.data(), c);
+            // make it thread save
+            QScopedPointer<QTextDocument> __doc(_doc->clone());
+            painter->drawText(__doc.data(), c);
 #else
-      painter->drawText(_doc, c);
+            painter->drawText(_doc, c);
 #endif
+            }
+      else {
+            painter->setPenColor(color);
+#if QT_VERSION >= 0x040800
+            foreach(const QGlyphRun& gr, _run.glyphs)
+                  painter->drawGlyphRun(QPointF(), gr);
+#else
+            painter->setFont(font());
+            painter->drawText(QPointF(_run.textRect.x(), _run.baseLine), _text);
+#endif
+            }
 
       // draw frame
       if (hasFrame()) {
@@ -478,7 +620,7 @@ void Text::write(Xml& xml) const
 
 void Text::write(Xml& xml, const char* name) const
       {
-      if (doc()->isEmpty())
+      if (isEmpty())
             return;
       xml.stag(name);
       writeProperties(xml, true);
@@ -526,7 +668,7 @@ void Text::writeProperties(Xml& xml, bool writeText) const
                   xml.tag("text", getText());
             else {
                   xml.stag("html-data");
-                  xml.writeHtml(_doc->toHtml("utf-8"));
+                  xml.writeHtml(getHtml());
                   xml.etag();
                   }
             }
@@ -613,14 +755,14 @@ bool Text::readProperties(QDomElement e)
             _styled = false;
             }
       else if (tag == "data")                  // obsolete
-            _doc->setHtml(val);
+            doc()->setHtml(val);
       else if (tag == "frame") {
             setHasFrame(val.toInt());
             _styled = false;
             }
       else if (tag == "html") {
             QString s = Xml::htmlToString(e);
-            _doc->setHtml(s);
+            doc()->setHtml(s);
             }
       else if (tag == "text")
             setText(val);
@@ -663,7 +805,7 @@ bool Text::readProperties(QDomElement e)
 void Text::spatiumChanged(qreal oldVal, qreal newVal)
       {
       Element::spatiumChanged(oldVal, newVal);
-      if (!sizeIsSpatiumDependent())
+      if (!sizeIsSpatiumDependent() || _doc == 0)     // plain text picks up the font in layout()
             return;
 #if 0
 printf("Text::spatiumChanged %s %s %p %f\n",
@@ -942,7 +1084,11 @@ QPainterPath Text::shape() const
       {
       QPainterPath pp;
 
-      for (QTextBlock tb = doc()->begin(); tb.isValid(); tb = tb.next()) {
+      if (_doc == 0) {
+            pp.addRect(_run.textRect);
+            return pp;
+            }
+      for (QTextBlock tb = _doc->begin(); tb.isValid(); tb = tb.next()) {
             QTextLayout* tl = tb.layout();
             int n = tl->lineCount();
             for (int i = 0; i < n; ++i) {
@@ -962,7 +1108,9 @@ QPainterPath Text::shape() const
 
 qreal Text::baseLine() const
       {
-      for (QTextBlock tb = doc()->begin(); tb.isValid(); tb = tb.next()) {
+      if (_doc == 0)
+            return _run.baseLine;
+      for (QTextBlock tb = _doc->begin(); tb.isValid(); tb = tb.next()) {
             const QTextLayout* tl = tb.layout();
             if (tl->lineCount())
                   return (tl->lineAt(0).ascent() + tl->position().y());
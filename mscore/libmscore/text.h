@@ -56,15 +56,54 @@ enum {
       TEXT_LYRICS_VERSE_NUMBER
       };
 
+//---------------------------------------------------------
+//   TextRun
+//    layout of a single line of unformatted text
+//---------------------------------------------------------
+
+struct TextRun {
+      QSizeF size;            // size including document margin
+      QRectF lineRect;        // line rectangle
+      QRectF textRect;        // natural text rectangle
+      qreal baseLine;
+#if QT_VERSION >= 0x040800
+      QList<QGlyphRun> glyphs;
+#endif
+      TextRun() : baseLine(0.0) {}
+      };
+
+//---------------------------------------------------------
+//   TextLayoutCache
+//    score wide cache of laid out plain text, keyed
+//    by font and string
+//---------------------------------------------------------
+
+class TextLayoutCache {
+      QMutex mutex;
+      QHash<QPair<QString, QString>, TextRun> runs;
+
+   public:
+      TextRun run(const QFont&, const QString&);
+      void clear();
+      };
+
 //---------------------------------------------------------
 //   Text
+//    plain single style text is kept as a string and laid
+//    out through the TextLayoutCache; a QTextDocument is
+//    only created for formatted text, wrapped text and
+//    in edit mode
 //---------------------------------------------------------
 
 class Text : public Element {
-      QTextDocument* _doc;
+      mutable QTextDocument* _doc;
+      QString _text;          // text if _doc == 0
+      TextRun _run;           // set by layout() if _doc == 0
       QRectF frame;           // set by layout()
       bool _styled;
 
+      void initDoc(QTextDocument*, const QString&) const;
+
       Q_DECLARE_TR_FUNCTIONS(Text)
 
    protected:
@@ -97,9 +136,9 @@ class Text : public Element {
 
       QString getText() const;
       QString getHtml() const;
-      QTextDocumentFragment getFragment() const { return QTextDocumentFragment(_doc); }
+      QTextDocumentFragment getFragment() const { return QTextDocumentFragment(doc()); }
 
-      QTextDocument* doc() const            { return _doc; }
+      QTextDocument* doc() const;
 
       qreal frameWidth() const;
       qreal paddingWidth() const;
@@ -183,9 +222,9 @@ class Text : public Element {
       bool styled() const                 { return _styled; }
       void setStyled(bool v);
 
-      bool isEmpty() const                { return _doc->isEmpty(); }
-      void setModified(bool v)            { _doc->setModified(v);   }
-      void clear()                        { _doc->clear();          }
+      bool isEmpty() const                { return _doc ? _doc->isEmpty() : _text.isEmpty(); }
+      void setModified(bool v)            { if (_doc) _doc->setModified(v); }
+      void clear();
       QRectF pageRectangle() const;
       virtual void styleChanged();
       virtual void setScore(Score* s);
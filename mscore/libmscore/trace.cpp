@@ -0,0 +1,151 @@
+//=============================================================================
+//  MuseScore
+//  Music Composition & Notation
+//  $Id:$
+//
+//  Copyright (C) 2011 Werner Schweer
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2
+//  as published by the Free Software Foundation and appearing in
+//  the file LICENCE.GPL
+//=============================================================================
+
+#include "trace.h"
+#include "utils.h"
+
+bool Tracer::enabled = false;
+
+static Tracer::Event* ring;
+static unsigned ringMask;
+static QAtomicInt ringIdx;
+static qreal startTime;
+
+//---------------------------------------------------------
+//   enable
+//    events is rounded up to a power of two
+//---------------------------------------------------------
+
+void Tracer::enable(int events)
+      {
+      if (enabled)
+            return;
+      unsigned n = 1;
+      while (n < unsigned(events))
+            n <<= 1;
+      ring      = new Event[n];
+      ringMask  = n - 1;
+      startTime = curTime();
+      enabled   = true;
+      }
+
+//---------------------------------------------------------
+//   now
+//    usec since enable()
+//---------------------------------------------------------
+
+qint64 Tracer::now()
+      {
+      return qint64((curTime() - startTime) * 1000000.0);
+      }
+
+//---------------------------------------------------------
+//   record
+//    may be called from any thread, including the audio
+//    thread; no locks, no allocation
+//---------------------------------------------------------
+
+void Tracer::record(const char* name, qint64 start, qint64 duration)
+      {
+      unsigned idx = unsigned(ringIdx.fetchAndAddRelaxed(1)) & ringMask;
+      Event* e     = &ring[idx];
+      e->name      = name;
+      e->start     = start;
+      e->duration  = duration;
+      e->thread    = qint64(quintptr(QThread::currentThreadId()));
+      }
+
+//---------------------------------------------------------
+//   recordedEvents
+//    return events in buffer in recording order
+//---------------------------------------------------------
+
+static QList<Tracer::Event> recordedEvents()
+      {
+      QList<Tracer::Event> el;
+      if (!ring)
+            return el;
+      unsigned n    = unsigned(int(ringIdx));
+      unsigned size = ringMask + 1;
+      unsigned first = n > size ? n - size : 0;
+      for (unsigned i = first; i < n; ++i)
+            el.append(ring[i & ringMask]);
+      return el;
+      }
+
+//---------------------------------------------------------
+//   writeChromeTrace
+//    write events in "trace event format" for
+//    chrome://tracing
+//---------------------------------------------------------
+
+bool Tracer::writeChromeTrace(const QString& path)
+      {
+      QFile f(path);
+      if (!f.open(QIODevice::WriteOnly)) {
+            printf("Tracer: cannot open <%s>\n", qPrintable(path));
+            return false;
+            }
+      QList<Event> el = recordedEvents();
+      QMap<qint64, int> threads;          // map thread handles to small numbers
+      QTextStream os(&f);
+      os << "{\"traceEvents\":[\n";
+      for (int i = 0; i < el.size(); ++i) {
+            const Event& e = el[i];
+            if (!threads.contains(e.thread)) {
+                  int n = threads.size();
+                  threads[e.thread] = n;
+                  }
+            os << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+               << threads[e.thread] << ",\"ts\":" << e.start << ",\"dur\":" << e.duration << "}";
+            if (i != el.size() - 1)
+                  os << ",";
+            os << "\n";
+            }
+      os << "]}\n";
+      return true;
+      }
+
+//---------------------------------------------------------
+//   TraceSummary
+//---------------------------------------------------------
+
+struct TraceSummary {
+      int count;
+      qint64 total;
+      qint64 max;
+      TraceSummary() : count(0), total(0), max(0) {}
+      };
+
+//---------------------------------------------------------
+//   printSummary
+//---------------------------------------------------------
+
+void Tracer::printSummary()
+      {
+      QMap<QString, TraceSummary> sm;
+      foreach(const Event& e, recordedEvents()) {
+            TraceSummary& s = sm[e.name];
+            ++s.count;
+            s.total += e.duration;
+            if (e.duration > s.max)
+                  s.max = e.duration;
+            }
+      printf("%-24s %8s %12s %10s %10s\n", "scope", "count", "total ms", "avg ms", "max ms");
+      foreach(const QString& name, sm.keys()) {
+            const TraceSummary& s = sm[name];
+            printf("%-24s %8d %12.3f %10.3f %10.3f\n", qPrintable(name), s.count,
+               s.total / 1000.0, s.total / 1000.0 / s.count, s.max / 1000.0);
+            }
+      }
+
@@ -0,0 +1,70 @@
+//=============================================================================
+//  MuseScore
+//  Music Composition & Notation
+//  $Id:$
+//
+//  Copyright (C) 2011 Werner Schweer
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2
+//  as published by the Free Software Foundation and appearing in
+//  the file LICENCE.GPL
+//=============================================================================
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+//---------------------------------------------------------
+//   Tracer
+//    records timed scopes into a fixed size ring buffer;
+//    the buffer can be written as Chrome trace (json)
+//    or printed as a per scope summary
+//---------------------------------------------------------
+
+class Tracer {
+   public:
+      struct Event {
+            const char* name;
+            qint64 start;           // usec since enable()
+            qint64 duration;        // usec
+            qint64 thread;
+            };
+
+      static bool enabled;          ///< checked by every TraceScope
+
+      static void enable(int events = 1 << 18);
+      static qint64 now();
+      static void record(const char* name, qint64 start, qint64 duration);
+      static bool writeChromeTrace(const QString& path);
+      static void printSummary();
+      };
+
+//---------------------------------------------------------
+//   TraceScope
+//    time the enclosing scope; costs one flag test if
+//    tracing is disabled
+//---------------------------------------------------------
+
+class TraceScope {
+      const char* _name;
+      qint64 _start;
+
+   public:
+      TraceScope(const char* name) {
+            if (Tracer::enabled) {
+                  _name  = name;
+                  _start = Tracer::now();
+                  }
+            else
+                  _name = 0;
+            }
+      ~TraceScope() {
+            if (_name)
+                  Tracer::record(_name, _start, Tracer::now() - _start);
+            }
+      };
+
+#define TRACE(name) TraceScope traceScope__(name)
+
+#endif
+
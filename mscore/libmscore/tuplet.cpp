@@ -463,8 +463,8 @@ void Tuplet::write(Xml& xml) const
       xml.tag("actualNotes", _ratio.numerator());
       xml.tag("baseNote",    _baseLen.name());
       switch(_direction) {
-            case UP:   xml.tag("direction", QVariant("up")); break;
-            case DOWN: xml.tag("direction", QVariant("down")); break;
+            case UP:   xml.tag("direction", "up"); break;
+            case DOWN: xml.tag("direction", "down"); break;
             case AUTO: break;
             }
       if (_number)
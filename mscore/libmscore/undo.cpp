@@ -1450,6 +1450,7 @@ void ChangeInvisible::flip()
       element->setVisible(invisible);
       invisible = oval;
       element->score()->addRefresh(element->canvasBoundingRect());
+      element->score()->invalidateEvents(element);
       }
 
 //---------------------------------------------------------
@@ -1652,6 +1653,7 @@ void ChangeElement::flip()
             oldElement->parent()->change(oldElement, newElement);
             }
       qSwap(oldElement, newElement);
+      score->invalidateEvents(oldElement);
       if (newElement->type() == KEYSIG)
             newElement->staff()->setUpdateKeymap(true);
       else if (newElement->type() == DYNAMIC)
@@ -1806,6 +1808,7 @@ void InsertTime::flip()
       {
       score->insertTime(tick, len);
       len = -len;
+      score->invalidateEvents();
       }
 
 //---------------------------------------------------------
@@ -2077,11 +2080,13 @@ ExchangeVoice::ExchangeVoice(Measure* m, int _val1, int _val2, int _staff1, int
 void ExchangeVoice::undo()
       {
       measure->exchangeVoice(val2, val1, staff1, staff2);
+      measure->score()->invalidateEvents(measure);
       }
 
 void ExchangeVoice::redo()
       {
       measure->exchangeVoice(val1, val2, staff1, staff2);
+      measure->score()->invalidateEvents(measure);
       }
 
 //---------------------------------------------------------
@@ -2247,6 +2252,7 @@ void ChangeTuning::flip()
       qreal ot = note->tuning();
       note->setTuning(tuning);
       tuning = ot;
+      note->score()->invalidateEvents(note);
       }
 
 //---------------------------------------------------------
@@ -2574,6 +2580,7 @@ void ChangeVelocity::flip()
       note->setVeloOffset(veloOffset);
       veloType   = t;
       veloOffset = o;
+      note->score()->invalidateEvents(note);
       }
 
 //---------------------------------------------------------
@@ -2697,6 +2704,7 @@ void ChangeNoteProperties::flip()
       _veloOffset        = v3;
       _onTimeUserOffset  = v6;
       _offTimeUserOffset = v9;
+      note->score()->invalidateEvents(note);
       }
 
 //---------------------------------------------------------
@@ -2855,6 +2863,7 @@ void ChangeHairpin::flip()
       dynType    = t;
       diagonal   = dg;
       hairpin->score()->updateHairpin(hairpin);
+      hairpin->score()->invalidateEvents();
       }
 
 //---------------------------------------------------------
@@ -2866,6 +2875,7 @@ void ChangeDuration::flip()
       Fraction od = cr->duration();
       cr->setDuration(d);
       d = od;
+      cr->score()->invalidateEvents(cr);
       }
 
 //---------------------------------------------------------
@@ -3100,6 +3110,8 @@ void SwapCR::flip()
       s1->setElement(track, s2->element(track));
       s2->setElement(track, cr);
       cr1->score()->setLayoutAll(true);
+      cr1->score()->invalidateEvents(cr1);
+      cr2->score()->invalidateEvents(cr2);
       }
 
 //---------------------------------------------------------
@@ -12,6 +12,7 @@
 //=============================================================================
 
 #include "xml.h"
+#include "snapshot.h"
 
 QString docName;
 
@@ -21,24 +22,37 @@ QString docName;
 
 Xml::Xml()
       {
-      stack.clear();
-      curTick       = 0;
-      curTrack      = -1;
-      trackDiff     = 0;
-      clipboardmode = false;
-      excerptmode   = false;
-      tupletId      = 1;
-      beamId        = 1;
-      spannerId     = 0;
-      slurId        = 1;
-      writeOmr      = true;
+      _device   = 0;
+      _snapshot = 0;
+      init();
       }
 
 Xml::Xml(QIODevice* device)
-   : QTextStream(device)
       {
-      setCodec("utf8");
-      stack.clear();
+      _device   = device;
+      _snapshot = 0;
+      init();
+      }
+
+Xml::Xml(SnapshotWriter* snapshot)
+      {
+      _device   = 0;
+      _snapshot = snapshot;
+      init();
+      }
+
+Xml::~Xml()
+      {
+      flush();
+      }
+
+//---------------------------------------------------------
+//   init
+//---------------------------------------------------------
+
+void Xml::init()
+      {
+      _buffer.reserve(FLUSH_SIZE + BS);
       curTick       = 0;
       curTrack      = -1;
       trackDiff     = 0;
@@ -51,6 +65,189 @@ Xml::Xml(QIODevice* device)
       writeOmr      = true;
       }
 
+//---------------------------------------------------------
+//   flush
+//    write the buffer to the device; without device the
+//    output is kept until a device is set
+//---------------------------------------------------------
+
+void Xml::flush()
+      {
+      if (_snapshot) {
+            flushText();
+            return;
+            }
+      if (_device == 0 || _buffer.isEmpty())
+            return;
+      _device->write(_buffer);
+      _buffer.clear();
+      _buffer.reserve(FLUSH_SIZE + BS);
+      }
+
+//---------------------------------------------------------
+//   putInt
+//---------------------------------------------------------
+
+void Xml::putInt(int n)
+      {
+      char buf[16];
+      char* p = buf + sizeof(buf);
+      unsigned v = n < 0 ? -unsigned(n) : unsigned(n);
+      do {
+            *--p = '0' + v % 10;
+            v /= 10;
+            } while (v);
+      if (n < 0)
+            *--p = '-';
+      _buffer.append(p, buf + sizeof(buf) - p);
+      }
+
+//---------------------------------------------------------
+//   putDouble
+//    same format as QTextStream: %g with 6 digits in the
+//    C locale
+//---------------------------------------------------------
+
+void Xml::putDouble(double d)
+      {
+      // integral values print without exponent up to 6
+      // digits; -0 must keep its sign
+      if (d >= -999999.0 && d <= 999999.0 && d == double(int(d)) && (d != 0.0 || 1.0 / d > 0.0))
+            putInt(int(d));
+      else
+            _buffer.append(QByteArray::number(d, 'g', 6));
+      }
+
+//---------------------------------------------------------
+//   putString
+//    append s as utf8
+//---------------------------------------------------------
+
+void Xml::putString(const QString& s)
+      {
+      const QChar* p = s.unicode();
+      int n          = s.size();
+      for (int i = 0; i < n; ++i) {
+            if (p[i].unicode() >= 0x80) {
+                  _buffer.append(s.toUtf8());
+                  return;
+                  }
+            }
+      for (int i = 0; i < n; ++i)
+            _buffer.append(char(p[i].unicode()));
+      }
+
+//---------------------------------------------------------
+//   putEscaped
+//    append s as utf8 with xml special characters
+//    replaced like xmlString()
+//---------------------------------------------------------
+
+void Xml::putEscaped(const QString& s)
+      {
+      const QChar* p = s.unicode();
+      int n          = s.size();
+      for (int i = 0; i < n; ++i) {
+            switch (p[i].unicode()) {
+                  case '&': case '<': case '>': case '\'': case '"':
+                        putString(xmlString(s));
+                        return;
+                  }
+            }
+      putString(s);
+      }
+
+//---------------------------------------------------------
+//   flushText
+//    snapshot mode: pass the text written since the last
+//    tag to the snapshot. Text without markup and entities
+//    is passed as is; the html of writeHtml() and the
+//    output of operator<<() may contain tags.
+//---------------------------------------------------------
+
+void Xml::flushText()
+      {
+      if (_buffer.isEmpty())
+            return;
+      const char* p = _buffer.constData();
+      int n         = _buffer.size();
+      bool plain    = true;
+      for (int i = 0; i < n; ++i) {
+            if (p[i] == '<' || p[i] == '&') {
+                  plain = false;
+                  break;
+                  }
+            }
+      if (plain)
+            _snapshot->putText(QString::fromUtf8(p, n));
+      else
+            _snapshot->putXml(_buffer);
+      _buffer.clear();
+      }
+
+//---------------------------------------------------------
+//   startTag
+//    <name> where name may contain attributes
+//---------------------------------------------------------
+
+void Xml::startTag(const char* name)
+      {
+      if (_snapshot) {
+            flushText();
+            _snapshot->startElement(QString::fromUtf8(name));
+            return;
+            }
+      putLevel();
+      _buffer.append('<');
+      _buffer.append(name);
+      _buffer.append('>');
+      }
+
+void Xml::startTag(const QString& name)
+      {
+      if (_snapshot) {
+            flushText();
+            _snapshot->startElement(name);
+            return;
+            }
+      putLevel();
+      _buffer.append('<');
+      putString(name);
+      _buffer.append('>');
+      }
+
+//---------------------------------------------------------
+//   endTag
+//    </name> without the attributes of name
+//---------------------------------------------------------
+
+void Xml::endTag(const char* name)
+      {
+      if (_snapshot) {
+            flushText();
+            _snapshot->endElement();
+            return;
+            }
+      _buffer.append("</");
+      _buffer.append(name, strcspn(name, " "));
+      _buffer.append(">\n");
+      checkFlush();
+      }
+
+void Xml::endTag(const QString& name)
+      {
+      if (_snapshot) {
+            flushText();
+            _snapshot->endElement();
+            return;
+            }
+      int idx = name.indexOf(' ');
+      _buffer.append("</");
+      putString(idx == -1 ? name : name.left(idx));
+      _buffer.append(">\n");
+      checkFlush();
+      }
+
 //---------------------------------------------------------
 //   pTag
 //---------------------------------------------------------
@@ -120,7 +317,19 @@ ValueType readValueType(QDomElement e)
 
 void Xml::fTag(const char* name, const Fraction& f)
       {
-      tagE(QString("%1 z=\"%2\" n=\"%3\"").arg(name).arg(f.numerator()).arg(f.denominator()));
+      if (_snapshot) {
+            tagE(QString("%1 z=\"%2\" n=\"%3\"").arg(name).arg(f.numerator()).arg(f.denominator()));
+            return;
+            }
+      putLevel();
+      _buffer.append('<');
+      _buffer.append(name);
+      _buffer.append(" z=\"");
+      putInt(f.numerator());
+      _buffer.append("\" n=\"");
+      putInt(f.denominator());
+      _buffer.append("\"/>\n");
+      checkFlush();
       }
 
 //---------------------------------------------------------
@@ -140,9 +349,15 @@ Fraction readFraction(QDomElement e)
 
 void Xml::putLevel()
       {
-      int level = stack.size();
-      for (int i = 0; i < level * 2; ++i)
-            *this << ' ';
+      if (_snapshot)
+            return;
+      static const char spaces[] = "                                ";
+      int n = stack.size() * 2;
+      while (n > 0) {
+            int k = qMin(n, int(sizeof(spaces)) - 1);
+            _buffer.append(spaces, k);
+            n -= k;
+            }
       }
 
 //---------------------------------------------------------
@@ -151,7 +366,9 @@ void Xml::putLevel()
 
 void Xml::header()
       {
-      *this << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+      if (_snapshot)
+            return;
+      _buffer.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
       }
 
 //---------------------------------------------------------
@@ -159,22 +376,59 @@ void Xml::header()
 //    <mops attribute="value">
 //---------------------------------------------------------
 
+void Xml::stag(const char* s)
+      {
+      if (_snapshot) {
+            startTag(s);
+            stack.append(QByteArray());     // name only used for xml
+            return;
+            }
+      putLevel();
+      _buffer.append('<');
+      _buffer.append(s);
+      _buffer.append(">\n");
+      stack.append(QByteArray(s, strcspn(s, " ")));
+      checkFlush();
+      }
+
 void Xml::stag(const QString& s)
       {
+      if (_snapshot) {
+            startTag(s);
+            stack.append(QByteArray());     // name only used for xml
+            return;
+            }
       putLevel();
-      *this << '<' << s << '>' << endl;
-      stack.append(s.split(' ')[0]);
+      _buffer.append('<');
+      putString(s);
+      _buffer.append(">\n");
+      int idx = s.indexOf(' ');
+      stack.append((idx == -1 ? s : s.left(idx)).toUtf8());
+      checkFlush();
       }
 
 //---------------------------------------------------------
 //   etag
 //    </mops>
+//    the file is complete when the outermost tag is closed
 //---------------------------------------------------------
 
 void Xml::etag()
       {
+      QByteArray name(stack.takeLast());
+      if (_snapshot) {
+            flushText();
+            _snapshot->endElement();
+            return;
+            }
       putLevel();
-      *this << "</" << stack.takeLast() << '>' << endl;
+      _buffer.append("</");
+      _buffer.append(name);
+      _buffer.append(">\n");
+      if (stack.isEmpty())
+            flush();
+      else
+            checkFlush();
       }
 
 //---------------------------------------------------------
@@ -186,13 +440,19 @@ void Xml::tagE(const char* format, ...)
       {
       va_list args;
       va_start(args, format);
-      putLevel();
-      *this << '<';
     	char buffer[BS];
       vsnprintf(buffer, BS, format, args);
-    	*this << buffer;
       va_end(args);
-      *this << "/>" << endl;
+      if (_snapshot) {
+            startTag(buffer);
+            _snapshot->endElement();
+            return;
+            }
+      putLevel();
+      _buffer.append('<');
+    	_buffer.append(buffer);
+      _buffer.append("/>\n");
+      checkFlush();
       }
 
 //---------------------------------------------------------
@@ -201,8 +461,16 @@ void Xml::tagE(const char* format, ...)
 
 void Xml::tagE(const QString& s)
       {
+      if (_snapshot) {
+            startTag(s);
+            _snapshot->endElement();
+            return;
+            }
       putLevel();
-      *this << '<' << s << "/>\n";
+      _buffer.append('<');
+      putString(s);
+      _buffer.append("/>\n");
+      checkFlush();
       }
 
 //---------------------------------------------------------
@@ -212,8 +480,7 @@ void Xml::tagE(const QString& s)
 
 void Xml::ntag(const char* name)
       {
-      putLevel();
-      *this << "<" << name << ">";
+      startTag(name);
       }
 
 //---------------------------------------------------------
@@ -223,7 +490,7 @@ void Xml::ntag(const char* name)
 
 void Xml::netag(const char* s)
       {
-      *this << "</" << s << '>' << endl;
+      endTag(s);
       }
 
 //---------------------------------------------------------
@@ -231,58 +498,97 @@ void Xml::netag(const char* s)
 //    <mops>value</mops>
 //---------------------------------------------------------
 
-void Xml::tag(const QString& name, QVariant data)
+void Xml::tag(const char* name, bool val)
+      {
+      startTag(name);
+      _buffer.append(val ? '1' : '0');
+      endTag(name);
+      }
+
+void Xml::tag(const char* name, int val)
       {
-      QString ename(name.split(' ')[0]);
+      startTag(name);
+      putInt(val);
+      endTag(name);
+      }
 
-      putLevel();
+void Xml::tag(const char* name, unsigned val)
+      {
+      startTag(name);
+      putInt(int(val));       // as written through QVariant::toInt()
+      endTag(name);
+      }
+
+void Xml::tag(const char* name, double val)
+      {
+      startTag(name);
+      putDouble(val);
+      endTag(name);
+      }
+
+void Xml::tag(const char* name, const char* s)
+      {
+      startTag(name);
+      putEscaped(QString(s));
+      endTag(name);
+      }
+
+void Xml::tag(const char* name, const QString& s)
+      {
+      startTag(name);
+      putEscaped(s);
+      endTag(name);
+      }
+
+void Xml::tag(const QString& name, QVariant data)
+      {
       switch(data.type()) {
             case QVariant::Bool:
             case QVariant::Char:
             case QVariant::Int:
             case QVariant::UInt:
-                  *this << "<" << name << ">";
-                  *this << data.toInt();
-                  *this << "</" << ename << ">\n";
+                  startTag(name);
+                  putInt(data.toInt());
+                  endTag(name);
                   break;
             case QVariant::Double:
-                  *this << "<" << name << ">";
-                  *this << data.value<double>();
-                  *this << "</" << ename << ">\n";
+                  startTag(name);
+                  putDouble(data.value<double>());
+                  endTag(name);
                   break;
             case QVariant::String:
-                  *this << "<" << name << ">";
-                  *this << xmlString(data.value<QString>());
-                  *this << "</" << ename << ">\n";
+                  startTag(name);
+                  putEscaped(data.value<QString>());
+                  endTag(name);
                   break;
             case QVariant::Color:
                   {
                   QColor color(data.value<QColor>());
-                  *this << QString("<%1 r=\"%2\" g=\"%3\" b=\"%4\"/>\n").arg(name).arg(color.red()).arg(color.green()).arg(color.blue());
+                  tagE(QString("%1 r=\"%2\" g=\"%3\" b=\"%4\"").arg(name).arg(color.red()).arg(color.green()).arg(color.blue()));
                   }
                   break;
             case QVariant::Rect:
                   {
                   QRect r(data.value<QRect>());
-                  *this << QString("<%1 x=\"%2\" y=\"%3\" w=\"%4\" h=\"%5\"/>\n").arg(name).arg(r.x()).arg(r.y()).arg(r.width()).arg(r.height());
+                  tagE(QString("%1 x=\"%2\" y=\"%3\" w=\"%4\" h=\"%5\"").arg(name).arg(r.x()).arg(r.y()).arg(r.width()).arg(r.height()));
                   }
                   break;
             case QVariant::RectF:
                   {
                   QRectF r(data.value<QRectF>());
-                  *this << QString("<%1 x=\"%2\" y=\"%3\" w=\"%4\" h=\"%5\"/>\n").arg(name).arg(r.x()).arg(r.y()).arg(r.width()).arg(r.height());
+                  tagE(QString("%1 x=\"%2\" y=\"%3\" w=\"%4\" h=\"%5\"").arg(name).arg(r.x()).arg(r.y()).arg(r.width()).arg(r.height()));
                   }
                   break;
             case QVariant::PointF:
                   {
                   QPointF p(data.value<QPointF>());
-                  *this << QString("<%1 x=\"%2\" y=\"%3\"/>\n").arg(name).arg(p.x()).arg(p.y());
+                  tagE(QString("%1 x=\"%2\" y=\"%3\"").arg(name).arg(p.x()).arg(p.y()));
                   }
                   break;
             case QVariant::SizeF:
                   {
                   QSizeF p(data.value<QSizeF>());
-                  *this << QString("<%1 w=\"%2\" h=\"%3\"/>\n").arg(name).arg(p.width()).arg(p.height());
+                  tagE(QString("%1 w=\"%2\" h=\"%3\"").arg(name).arg(p.width()).arg(p.height()));
                   }
                   break;
             default:
@@ -290,6 +596,7 @@ void Xml::tag(const QString& name, QVariant data)
                   // abort();
                   break;
             }
+      checkFlush();
       }
 
 void Xml::tag(const char* name, const QWidget* g)
@@ -320,23 +627,22 @@ void Xml::dump(int len, const unsigned char* p)
       {
       putLevel();
       int col = 0;
-      setFieldWidth(5);
-      setNumberFlags(numberFlags() | QTextStream::ShowBase);
-      setIntegerBase(16);
+      char buf[16];
       for (int i = 0; i < len; ++i, ++col) {
             if (col >= 16) {
-                  setFieldWidth(0);
-                  *this << endl;
+                  _buffer.append('\n');
                   col = 0;
                   putLevel();
-                  setFieldWidth(5);
                   }
-            *this << (p[i] & 0xff);
+            // like QTextStream with field width 5 and ShowBase
+            char hex[8];
+            qsnprintf(hex, sizeof(hex), "0x%x", p[i] & 0xff);
+            qsnprintf(buf, sizeof(buf), "%5s", hex);
+            _buffer.append(buf);
             }
       if (col)
-            *this << endl << dec;
-      setFieldWidth(0);
-      setIntegerBase(10);
+            _buffer.append('\n');
+      checkFlush();
       }
 
 //---------------------------------------------------------
@@ -494,3 +800,68 @@ void Xml::writeHtml(const QString& s)
       }
 
 
+
+//---------------------------------------------------------
+//   readDomElement
+//    read the current element with all children into
+//    the dom document "doc"; the reader must be positioned
+//    on the start element. Like QDomDocument::setContent()
+//    whitespace only text nodes are dropped.
+//---------------------------------------------------------
+
+QDomElement XmlReader::readDomElement(QDomDocument* doc)
+      {
+      QDomElement top = doc->createElement(r->name().toString());
+      foreach(const QXmlStreamAttribute& a, r->attributes())
+            top.setAttribute(a.name().toString(), a.value().toString());
+      if (doc->documentElement().isNull())
+            doc->appendChild(top);
+
+      QDomElement cur = top;
+      QString text;
+      int level = 1;
+      while (level && !r->atEnd()) {
+            switch (r->readNext()) {
+                  case QXmlStreamReader::Characters:
+                        text += r->text().toString();
+                        continue;
+                  case QXmlStreamReader::StartElement:
+                  case QXmlStreamReader::EndElement:
+                        if (!text.isEmpty()) {
+                              if (!text.trimmed().isEmpty())
+                                    cur.appendChild(doc->createTextNode(text));
+                              text.clear();
+                              }
+                        if (r->isStartElement()) {
+                              QDomElement e = doc->createElement(r->name().toString());
+                              foreach(const QXmlStreamAttribute& a, r->attributes())
+                                    e.setAttribute(a.name().toString(), a.value().toString());
+                              cur.appendChild(e);
+                              cur = e;
+                              ++level;
+                              }
+                        else {
+                              cur = cur.parentNode().toElement();
+                              --level;
+                              }
+                        break;
+                  default:
+                        break;
+                  }
+            }
+      return top;
+      }
+
+//---------------------------------------------------------
+//   unknown
+//    skip current element
+//---------------------------------------------------------
+
+void XmlReader::unknown()
+      {
+      if (!docName.isEmpty())
+            fprintf(stderr, "<%s>:", qPrintable(docName));
+      fprintf(stderr, "line:%lld col:%lld: Unknown Node <%s>\n",
+         lineNumber(), columnNumber(), qPrintable(name().toString()));
+      skipCurrentElement();
+      }
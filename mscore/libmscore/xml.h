@@ -18,6 +18,8 @@
 #include "spatium.h"
 #include "fraction.h"
 
+class SnapshotWriter;
+
 //---------------------------------------------------------
 //   Property
 //---------------------------------------------------------
@@ -32,14 +34,41 @@ class Prop {
 
 //---------------------------------------------------------
 //   Xml
+//    writer for score files
+//
+//    Output is collected as utf8 in a buffer which is written
+//    to the device when it is full, when the outermost tag is
+//    closed and on destruction. tag() has overloads for the
+//    common value types which format directly into the buffer;
+//    the QVariant version is for the remaining types and for
+//    names built at runtime.
+//
+//    In snapshot mode tags are passed to a SnapshotWriter
+//    (see snapshot.h) and the buffer only collects the text
+//    between two tags.
 //---------------------------------------------------------
 
-class Xml : public QTextStream {
+class Xml {
       static const int BS = 2048;
+      static const int FLUSH_SIZE = 64 * 1024;
 
-      QList<QString> stack;
-      void putLevel();
+      QIODevice* _device;
+      SnapshotWriter* _snapshot;
+      QByteArray _buffer;           // output not yet written
+      QList<QByteArray> stack;      // names of open tags
 
+      void init();
+      void putLevel();
+      void putInt(int);
+      void putDouble(double);
+      void putString(const QString&);
+      void putEscaped(const QString&);
+      void startTag(const char* name);
+      void startTag(const QString& name);
+      void endTag(const char* name);
+      void endTag(const QString& name);
+      void flushText();
+      void checkFlush() { if (_snapshot == 0 && _buffer.size() >= FLUSH_SIZE) flush(); }
 
    public:
       int curTick;            // used to optimize output
@@ -55,15 +84,29 @@ class Xml : public QTextStream {
       int slurId;
 
       Xml(QIODevice* dev);
+      Xml(SnapshotWriter*);
       Xml();
+      ~Xml();
+
+      QIODevice* device() const         { return _device; }
+      void setDevice(QIODevice* dev)    { _device = dev; }
+      void flush();
 
-      void sTag(const char* name, Spatium sp) { Xml::tag(name, QVariant(sp.val())); }
+      Xml& operator<<(const char* s)        { _buffer.append(s); return *this; }
+      Xml& operator<<(const QByteArray& s)  { _buffer.append(s); return *this; }
+      Xml& operator<<(const QString& s)     { putString(s); return *this; }
+      Xml& operator<<(char c)               { _buffer.append(c); return *this; }
+      Xml& operator<<(int n)                { putInt(n); return *this; }
+      Xml& operator<<(double d)             { putDouble(d); return *this; }
+
+      void sTag(const char* name, Spatium sp) { tag(name, sp.val()); }
       void pTag(const char* name, Placement);
       void fTag(const char* name, const Fraction&);
       void valueTypeTag(const char* name, ValueType t);
 
       void header();
 
+      void stag(const char*);
       void stag(const QString&);
       void etag();
 
@@ -76,8 +119,14 @@ class Xml : public QTextStream {
       void prop(QList<Prop> pl) { foreach(Prop p, pl) prop(p); }
 
       void tag(const QString& name, QVariant data);
-      void tag(const char* name, const char* s)    { tag(name, QVariant(s)); }
-      void tag(const char* name, const QString& s) { tag(name, QVariant(s)); }
+      void tag(const char* name, bool);
+      void tag(const char* name, int);
+      void tag(const char* name, unsigned);
+      void tag(const char* name, double);
+      void tag(const char* name, const Spatium& sp) { tag(name, sp.val()); }
+      void tag(const char* name, const Fraction& f) { fTag(name, f); }
+      void tag(const char* name, const char* s);
+      void tag(const char* name, const QString& s);
       void tag(const char* name, const QWidget*);
 
       void writeHtml(const QString& s);
@@ -88,6 +137,42 @@ class Xml : public QTextStream {
       static QString htmlToString(QDomElement);
       };
 
+//---------------------------------------------------------
+//   XmlReader
+//    streaming reader for score files; subtrees which
+//    are handled by the QDomElement based read() methods
+//    are converted into small dom fragments
+//
+//    The functions are those of QXmlStreamReader used by
+//    the score reader; they are virtual so that snapshots
+//    can be read through the same code.
+//---------------------------------------------------------
+
+class XmlReader {
+      Q_DISABLE_COPY(XmlReader)
+      QXmlStreamReader* r;
+
+   protected:
+      XmlReader() : r(0) {}
+
+   public:
+      XmlReader(QIODevice* d)       : r(new QXmlStreamReader(d)) {}
+      XmlReader(const QByteArray& d) : r(new QXmlStreamReader(d)) {}
+      virtual ~XmlReader()                      { delete r; }
+
+      virtual bool readNextStartElement()       { return r->readNextStartElement(); }
+      virtual QStringRef name() const           { return r->name(); }
+      virtual QXmlStreamAttributes attributes() const { return r->attributes(); }
+      virtual QString readElementText()         { return r->readElementText(); }
+      virtual void skipCurrentElement()         { r->skipCurrentElement(); }
+      virtual QDomElement readDomElement(QDomDocument* doc);
+      virtual bool hasError() const             { return r->hasError(); }
+      virtual QString errorString() const       { return r->errorString(); }
+      virtual qint64 lineNumber() const         { return r->lineNumber(); }
+      virtual qint64 columnNumber() const       { return r->columnNumber(); }
+      void unknown();
+      };
+
 extern Placement readPlacement(QDomElement);
 extern ValueType readValueType(QDomElement);
 extern Fraction  readFraction(QDomElement);
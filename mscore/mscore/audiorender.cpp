@@ -0,0 +1,317 @@
+//=============================================================================
+//  MusE Score
+//  Linux Music Score Editor
+//  $Id:$
+//
+//  Copyright (C) 2011 Werner Schweer and others
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//=============================================================================
+
+#include "audiorender.h"
+#include "msynth/synti.h"
+#include "fluid.h"
+#include "libmscore/score.h"
+#include "libmscore/part.h"
+#include "libmscore/event.h"
+#include "libmscore/trace.h"
+
+static const unsigned CHUNK = 8192;       // frames mixed per step
+static const unsigned BLOCK = 1024;       // max frames per synthesizer call
+
+//---------------------------------------------------------
+//   FrameEvent
+//---------------------------------------------------------
+
+struct FrameEvent {
+      qint64 frame;
+      int synti;
+      Event event;
+
+      FrameEvent() {}
+      FrameEvent(qint64 f, int s, const Event& e) : frame(f), synti(s), event(e) {}
+      };
+
+//---------------------------------------------------------
+//   RenderWorker
+//    one synthesizer playing a subset of the midi
+//    channels
+//---------------------------------------------------------
+
+struct RenderWorker {
+      MasterSynth* synti;
+      QVector<FrameEvent> events;
+      int pos;                // next event to play
+      qint64 frame;           // start of next chunk
+      unsigned frames;        // length of next chunk
+      int load;               // number of events
+      float* left;
+      float* right;
+
+      RenderWorker(Score* score, int sampleRate);
+      ~RenderWorker();
+      };
+
+RenderWorker::RenderWorker(Score* score, int sampleRate)
+      {
+      synti = new MasterSynth();
+      synti->init(sampleRate);
+      synti->setState(score->syntiState());
+      synti->setGain(1.0);
+      pos    = 0;
+      frame  = 0;
+      frames = 0;
+      load   = 0;
+      left   = new float[CHUNK];
+      right  = new float[CHUNK];
+      }
+
+RenderWorker::~RenderWorker()
+      {
+      delete synti;
+      delete[] left;
+      delete[] right;
+      }
+
+//---------------------------------------------------------
+//   renderChunk
+//    render the next w->frames frames of worker w
+//---------------------------------------------------------
+
+static void renderChunk(RenderWorker*& w)
+      {
+      TRACE("AudioRender::renderChunk");
+      memset(w->left,  0, w->frames * sizeof(float));
+      memset(w->right, 0, w->frames * sizeof(float));
+      qint64 endFrame = w->frame + w->frames;
+      qint64 frame    = w->frame;
+      int n           = w->events.size();
+      while (frame < endFrame) {
+            while (w->pos < n && w->events[w->pos].frame <= frame) {
+                  const FrameEvent& e = w->events[w->pos++];
+                  w->synti->play(e.event, e.synti);
+                  }
+            qint64 next = endFrame;
+            if (w->pos < n && w->events[w->pos].frame < next)
+                  next = w->events[w->pos].frame;
+            if (next - frame > BLOCK)
+                  next = frame + BLOCK;
+            unsigned offset = frame - w->frame;
+            w->synti->process(next - frame, w->left + offset, w->right + offset);
+            frame = next;
+            }
+      w->frame = endFrame;
+      }
+
+//---------------------------------------------------------
+//   AudioRender
+//---------------------------------------------------------
+
+AudioRender::AudioRender(Score* s, int sampleRate)
+      {
+      score       = s;
+      _sampleRate = sampleRate;
+      _threads    = qMax(1, QThread::idealThreadCount());
+      _frames     = 0;
+      _peak       = 0.0;
+      _gain       = 1.0;
+      }
+
+AudioRender::~AudioRender()
+      {
+      qDeleteAll(workers);
+      }
+
+//---------------------------------------------------------
+//   createWorkers
+//---------------------------------------------------------
+
+void AudioRender::createWorkers(int n)
+      {
+      qDeleteAll(workers);
+      workers.clear();
+      for (int i = 0; i < n; ++i)
+            workers.append(new RenderWorker(score, _sampleRate));
+      if (n > 1) {
+            // the workers keep the cores busy already
+            foreach(RenderWorker* w, workers) {
+                  FluidS::Fluid* fluid = static_cast<FluidS::Fluid*>(w->synti->synth("Fluid"));
+                  if (fluid)
+                        fluid->setRenderThreads(0);
+                  }
+            }
+      }
+
+//---------------------------------------------------------
+//   render
+//    synthesize the whole score; returns false if there
+//    is nothing to render or the temporary file cannot
+//    be written
+//---------------------------------------------------------
+
+bool AudioRender::render(QProgressBar* pBar)
+      {
+      TRACE("AudioRender::render");
+      EventMap events;
+      score->toEList(&events);
+      if (events.isEmpty()) {
+            fprintf(stderr, "AudioRender: nothing to render\n");
+            return false;
+            }
+      if (!tmp.open()) {
+            fprintf(stderr, "AudioRender: cannot open temporary file: %s\n",
+               qPrintable(tmp.errorString()));
+            return false;
+            }
+
+      //
+      // distribute channels over the workers, busiest
+      // channel first to the least loaded worker
+      //
+      int channels = score->midiMapping()->size();
+      QVector<int> load(channels, 0);
+      for (EventMap::const_iterator i = events.constBegin(); i != events.constEnd(); ++i) {
+            if (i.value().isChannelEvent())
+                  ++load[i.value().channel()];
+            }
+      QList<QPair<int, int> > order;
+      for (int ch = 0; ch < channels; ++ch)
+            order.append(QPair<int, int>(-load[ch], ch));
+      qSort(order);
+      int n = 0;
+      for (int ch = 0; ch < channels; ++ch) {
+            if (load[ch])
+                  ++n;
+            }
+      createWorkers(qMax(1, qMin(_threads, n)));
+
+      QVector<int> owner(channels, 0);
+      for (int i = 0; i < order.size(); ++i) {
+            int idx = 0;
+            for (int k = 1; k < workers.size(); ++k) {
+                  if (workers[k]->load < workers[idx]->load)
+                        idx = k;
+                  }
+            int ch = order[i].second;
+            owner[ch] = idx;
+            workers[idx]->load += load[ch];
+            }
+
+      //
+      // init instruments
+      //
+      foreach(const Part* part, *score->parts()) {
+            foreach(const Channel& a, part->instr()->channel()) {
+                  a.updateInitList();
+                  MasterSynth* synti = workers[owner[a.channel]]->synti;
+                  int syntiIdx = score->midiMapping(a.channel)->articulation->synti;
+                  foreach(Event e, a.init) {
+                        if (e.type() == ME_INVALID)
+                              continue;
+                        e.setChannel(a.channel);
+                        synti->play(e, syntiIdx);
+                        }
+                  }
+            }
+
+      //
+      // convert ticks to frames once per tick and hand
+      // the events to the owner of their channel
+      //
+      int lastTick = -1;
+      qint64 frame = 0;
+      for (EventMap::const_iterator i = events.constBegin(); i != events.constEnd(); ++i) {
+            const Event& e = i.value();
+            if (!e.isChannelEvent())
+                  continue;
+            Channel* c = score->midiMapping(e.channel())->articulation;
+            if (c->mute)
+                  continue;
+            if (i.key() != lastTick) {
+                  lastTick = i.key();
+                  frame    = qint64(lrint(score->utick2utime(lastTick) * _sampleRate));
+                  }
+            workers[owner[e.channel()]]->events.append(FrameEvent(frame, c->synti, e));
+            }
+      double et = score->utick2utime((events.constEnd() - 1).key()) + 1.0;   // add trailer (sec)
+      qint64 endFrame = qint64(et * _sampleRate);
+
+      if (pBar) {
+            pBar->reset();
+            pBar->setRange(0, int(et));
+            }
+      bool threaded = workers.size() > 1 && QThreadPool::globalInstance()->maxThreadCount() > 1;
+      float* buffer = new float[CHUNK * 2];
+      bool rv       = true;
+      _peak         = 0.0;
+      for (frame = 0; frame < endFrame; frame += CHUNK) {
+            unsigned frames = qMin(qint64(CHUNK), endFrame - frame);
+            foreach(RenderWorker* w, workers)
+                  w->frames = frames;
+            if (threaded)
+                  QtConcurrent::blockingMap(workers, renderChunk);
+            else
+                  renderChunk(workers[0]);
+
+            //
+            // mix, measure peak and save
+            //
+            memset(buffer, 0, sizeof(float) * frames * 2);
+            foreach(const RenderWorker* w, workers) {
+                  float* p = buffer;
+                  for (unsigned i = 0; i < frames; ++i) {
+                        *p++ += w->left[i];
+                        *p++ += w->right[i];
+                        }
+                  }
+            for (unsigned i = 0; i < frames * 2; ++i) {
+                  if (qAbs(buffer[i]) > _peak)
+                        _peak = qAbs(buffer[i]);
+                  }
+            qint64 bytes = sizeof(float) * frames * 2;
+            if (tmp.write((const char*)buffer, bytes) != bytes) {
+                  fprintf(stderr, "AudioRender: write temporary file failed: %s\n",
+                     qPrintable(tmp.errorString()));
+                  rv = false;
+                  break;
+                  }
+            if (pBar)
+                  pBar->setValue(int((frame + frames) / _sampleRate));
+            }
+      delete[] buffer;
+      qDeleteAll(workers);
+      workers.clear();
+
+      _frames = rv ? endFrame : 0;
+      _gain   = _peak > 0.0 ? 0.99 / _peak : 1.0;
+      tmp.seek(0);
+      return rv;
+      }
+
+//---------------------------------------------------------
+//   read
+//    read the next normalized interleaved stereo frames;
+//    returns the number of frames read
+//---------------------------------------------------------
+
+int AudioRender::read(float* buffer, int frames)
+      {
+      qint64 n = tmp.read((char*)buffer, sizeof(float) * frames * 2);
+      if (n <= 0)
+            return 0;
+      int samples = n / sizeof(float);
+      for (int i = 0; i < samples; ++i)
+            buffer[i] *= _gain;
+      return samples / 2;
+      }
+
@@ -0,0 +1,68 @@
+//=============================================================================
+//  MusE Score
+//  Linux Music Score Editor
+//  $Id:$
+//
+//  Copyright (C) 2011 Werner Schweer and others
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//=============================================================================
+
+#ifndef __AUDIORENDER_H__
+#define __AUDIORENDER_H__
+
+class Score;
+class QProgressBar;
+struct RenderWorker;
+
+//---------------------------------------------------------
+//   AudioRender
+//    offline renderer for audio export
+//
+//    The midi channels of the score are distributed over
+//    a number of workers; every worker has its own
+//    synthesizer and renders its channels in a thread of
+//    the global thread pool. The mix is written as float
+//    into a temporary file while the peak is measured, so
+//    the score is synthesized only once. read() returns
+//    the normalized stereo frames.
+//---------------------------------------------------------
+
+class AudioRender {
+      Score* score;
+      int _sampleRate;
+      int _threads;
+      QList<RenderWorker*> workers;
+      QTemporaryFile tmp;
+      qint64 _frames;
+      float _peak;
+      float _gain;
+
+      void createWorkers(int n);
+
+   public:
+      AudioRender(Score*, int sampleRate);
+      ~AudioRender();
+
+      int threads() const     { return _threads; }
+      void setThreads(int n)  { _threads = n;    }
+      int sampleRate() const  { return _sampleRate; }
+
+      bool render(QProgressBar* = 0);
+      qint64 frames() const   { return _frames; }
+      float peak() const      { return _peak;   }
+      int read(float* buffer, int frames);
+      };
+
+#endif
+
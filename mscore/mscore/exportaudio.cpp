@@ -32,6 +32,7 @@
 #include "preferences.h"
 #include "seq.h"
 #include "libmscore/mscore.h"
+#include "audiorender.h"
 
 //---------------------------------------------------------
 //   saveAudio
@@ -52,13 +53,6 @@ bool MuseScore::saveAudio(Score* score, const QString& name, const QString& ext)
             }
       int sampleRate = preferences.exportAudioSampleRate;
 
-      MasterSynth* synti = new MasterSynth();
-      synti->init(sampleRate);
-      synti->setState(score->syntiState());
-
-      EventMap events;
-      score->toEList(&events);
-
       SF_INFO info;
       memset(&info, 0, sizeof(info));
       info.channels   = 2;
@@ -67,104 +61,33 @@ bool MuseScore::saveAudio(Score* score, const QString& name, const QString& ext)
       SNDFILE* sf     = sf_open(qPrintable(name), SFM_WRITE, &info);
       if (sf == 0) {
             fprintf(stderr, "open soundfile failed: %s\n", sf_strerror(sf));
-            delete synti;
             return false;
             }
 
       QProgressBar* pBar = showProgressBar();
-      pBar->reset();
-
-      double peak = 0.0;
-      double gain = 1.0;
-      for (int pass = 0; pass < 2; ++pass) {
-            EventMap::const_iterator playPos;
-            playPos = events.constBegin();
-            EventMap::const_iterator endPos = events.constEnd();
-            --endPos;
-            double et = score->utick2utime(endPos.key());
-            et += 1.0;   // add trailer (sec)
-            pBar->setRange(0, int(et));
-
-            //
-            // init instruments
-            //
-            foreach(const Part* part, *score->parts()) {
-                  foreach(const Channel& a, part->instr()->channel()) {
-                        a.updateInitList();
-                        foreach(Event e, a.init) {
-                              if (e.type() == ME_INVALID)
-                                    continue;
-                              e.setChannel(a.channel);
-                              int syntiIdx= score->midiMapping(a.channel)->articulation->synti;
-                              synti->play(e, syntiIdx);
-                              }
-                        }
-                  }
+      AudioRender render(score, sampleRate);
+      bool rv = render.render(pBar);
+      hideProgressBar();
 
-            static const unsigned FRAMES = 512;
+      if (rv) {
+            static const int FRAMES = 4096;
             float buffer[FRAMES * 2];
-            double playTime = 0.0;
-            synti->setGain(gain);
-
             for (;;) {
-                  unsigned frames = FRAMES;
-                  //
-                  // collect events for one segment
-                  //
-                  memset(buffer, 0, sizeof(float) * FRAMES * 2);
-                  double endTime = playTime + double(frames)/double(sampleRate);
-                  float* l = buffer;
-                  float* r = buffer + 1;
-                  for (; playPos != events.constEnd(); ++playPos) {
-                        double f = score->utick2utime(playPos.key());
-                        if (f >= endTime)
-                              break;
-                        int n = lrint((f - playTime) * sampleRate);
-                        synti->process(n, l, r);
-
-                        l         += n;
-                        r         += n;
-                        playTime += double(n)/double(sampleRate);
-                        frames    -= n;
-                        const Event& e = playPos.value();
-                        if (e.isChannelEvent()) {
-                              int channelIdx = e.channel();
-                              Channel* c = score->midiMapping(channelIdx)->articulation;
-                              if (!c->mute) {
-                                    synti->play(e, c->synti);
-                                    }
-                              }
-                        }
-                  if (frames) {
-                        synti->process(frames, l, r);
-                        playTime += double(frames)/double(sampleRate);
-                        }
-                  if (pass == 1) {
-                        sf_writef_float(sf, buffer, FRAMES);
-                        }
-                  else {
-                        for (unsigned i = 0; i < FRAMES * 2; ++i) {
-                              if (qAbs(buffer[i]) > peak)
-                                    peak = qAbs(buffer[i]);
-                              }
-                        }
-                  playTime = endTime;
-                  pBar->setValue(int(playTime));
-                  if (playTime > et)
+                  int n = render.read(buffer, FRAMES);
+                  if (n == 0)
                         break;
+                  if (sf_writef_float(sf, buffer, n) != n) {
+                        fprintf(stderr, "write soundfile failed: %s\n", sf_strerror(sf));
+                        rv = false;
+                        break;
+                        }
                   }
-            gain = 0.99 / peak;
             }
-
-      hideProgressBar();
-
-      delete synti;
       if (sf_close(sf)) {
             fprintf(stderr, "close soundfile failed\n");
             return false;
             }
-
-      return true;
+      return rv;
       }
 
 #endif // HAS_AUDIOFILE
@@ -285,6 +285,7 @@ void MuseScore::saveFile()
             tab2->setTabText(idx, cs->name());
       QString tmp = cs->tmpName();
       if (!tmp.isEmpty()) {
+            waitForAutoSave();
             QFile f(tmp);
             if (!f.remove())
                   printf("cannot remove temporary file <%s>\n", qPrintable(f.fileName()));
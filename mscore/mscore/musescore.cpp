@@ -19,6 +19,12 @@
 //=============================================================================
 
 #include <fenv.h>
+#if defined(Q_WS_WIN)
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "musescore.h"
 #include "scoreview.h"
@@ -30,6 +36,8 @@
 #include "icons.h"
 #include "textstyle.h"
 #include "libmscore/xml.h"
+#include "libmscore/pool.h"
+#include "libmscore/trace.h"
 #include "seq.h"
 #include "libmscore/tempo.h"
 #include "libmscore/sym.h"
@@ -196,6 +204,7 @@ static void printVersion(const char* prog)
       }
 
 static const int RECENT_LIST_SIZE = 10;
+static const int AUTOSAVE_LEVEL   = 1;      // fast zlib level for autosave files
 
 //---------------------------------------------------------
 //   closeEvent
@@ -224,6 +233,7 @@ void MuseScore::closeEvent(QCloseEvent* ev)
                   }
             }
       writeSessionFile(true);
+      waitForAutoSave();
       foreach(Score* score, scoreList) {
             if (!score->tmpName().isEmpty()) {
                   QFile f(score->tmpName());
@@ -1229,10 +1239,25 @@ static void usage()
         "   -i        load icons from INSTALLPATH/icons\n"
         "   -e        enable experimental features\n"
         "   -c dir    override config/settings directory\n"
+        "   -T file   trace layout, file i/o, midi rendering and audio;\n"
+        "             write Chrome trace to 'file' and print a summary on exit\n"
         );
       exit(-1);
       }
 
+//---------------------------------------------------------
+//   writeTrace
+//    called on exit if tracing is enabled (-T)
+//---------------------------------------------------------
+
+static QString traceFile;
+
+static void writeTrace()
+      {
+      Tracer::writeChromeTrace(traceFile);
+      Tracer::printSummary();
+      }
+
 //---------------------------------------------------------
 //   loadScoreList
 //    read list of "Recent Scores"
@@ -1727,6 +1752,7 @@ void MuseScore::removeTab(int i)
             }
       writeSessionFile(false);
       if (!score->tmpName().isEmpty()) {
+            waitForAutoSave();
             QFile f(score->tmpName());
             f.remove();
             }
@@ -2077,6 +2103,13 @@ int main(int argc, char* av[])
                   case 'e':
                         enableExperimental = true;
                         break;
+                  case 'T':
+                        if (argv.size() - i < 2)
+                              usage();
+                        traceFile = argv.takeAt(i + 1);
+                        Tracer::enable();
+                        atexit(writeTrace);
+                        break;
                   case 'c':
                         {
                         if (argv.size() - i < 2)
@@ -2297,7 +2330,10 @@ MScore::init();         // initialize libmscore
             printf("start event loop...\n");
       if (mscore->hasToCheckForUpdate())
             mscore->checkForUpdate();
-      return qApp->exec();
+      int rv = qApp->exec();
+      if (debugMode)
+            ElementPool::dumpStatistics();
+      return rv;
       }
 
 //---------------------------------------------------------
@@ -3032,38 +3068,133 @@ void MuseScore::removeSessionFile()
             }
       }
 
+//---------------------------------------------------------
+//   AutoSaveJob
+//---------------------------------------------------------
+
+struct AutoSaveJob {
+      QString path;
+      QList<ArchiveEntry> entries;
+      };
+
+//---------------------------------------------------------
+//   replaceFile
+//    atomically replace dst by src; dst is either the old
+//    or the new file at any time
+//---------------------------------------------------------
+
+static bool replaceFile(const QString& src, const QString& dst)
+      {
+#if defined(Q_WS_WIN)
+      return MoveFileExW((const wchar_t*)QDir::toNativeSeparators(src).utf16(),
+         (const wchar_t*)QDir::toNativeSeparators(dst).utf16(),
+         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+      return ::rename(QFile::encodeName(src).constData(), QFile::encodeName(dst).constData()) == 0;
+#endif
+      }
+
+//---------------------------------------------------------
+//   writeAutoSave
+//    compress the score snapshots into their files; runs
+//    in a thread of the global thread pool. Every file is
+//    written under a temporary name which then atomically
+//    replaces the old file, so a crash leaves the last
+//    autosave intact.
+//---------------------------------------------------------
+
+static void writeAutoSave(const QList<AutoSaveJob>& jobs)
+      {
+      foreach(const AutoSaveJob& job, jobs) {
+            QTemporaryFile tf(job.path + ".XXXXXX");
+            tf.setAutoRemove(false);
+            if (!tf.open()) {
+                  printf("autosave: cannot create temporary file for <%s>\n", qPrintable(job.path));
+                  continue;
+                  }
+            QString name = tf.fileName();
+            try {
+                  Score::writeArchive(&tf, job.entries, AUTOSAVE_LEVEL);
+                  }
+            catch (QString s) {
+                  printf("autosave <%s> failed: %s\n", qPrintable(job.path), qPrintable(s));
+                  tf.close();
+                  QFile::remove(name);
+                  continue;
+                  }
+            // the data must be on disk before the file is renamed
+            tf.flush();
+#if defined(Q_WS_WIN)
+            _commit(tf.handle());
+#else
+            fsync(tf.handle());
+#endif
+            tf.close();
+            if (!replaceFile(name, job.path)) {
+                  printf("autosave: cannot rename <%s> to <%s>\n", qPrintable(name), qPrintable(job.path));
+                  QFile::remove(name);
+                  }
+            }
+      }
+
+//---------------------------------------------------------
+//   waitForAutoSave
+//    wait until the autosave files are written; must be
+//    called before an autosave file is removed
+//---------------------------------------------------------
+
+void MuseScore::waitForAutoSave()
+      {
+      autoSaveFuture.waitForFinished();
+      }
+
 //---------------------------------------------------------
 //   autoSaveTimerTimeout
+//    Only the serialization of the dirty scores runs in
+//    the gui thread; the snapshots are compressed and
+//    written in the background.
 //---------------------------------------------------------
 
 void MuseScore::autoSaveTimerTimeout()
       {
       bool sessionChanged = false;
-      foreach(Score* s, scoreList) {
-            if (s->autosaveDirty()) {
+      // if the last autosave is still being written the
+      // scores stay dirty and are saved next time
+      if (!autoSaveFuture.isRunning()) {
+            QList<AutoSaveJob> jobs;
+            foreach(Score* s, scoreList) {
+                  if (!s->autosaveDirty())
+                        continue;
                   QString tmp = s->tmpName();
-                  if (!tmp.isEmpty()) {
-                        QFileInfo fi(tmp);
-                        // TODO: cannot catch exeption here:
-                        cs->saveCompressedFile(fi);
-                        }
-                  else {
+                  if (tmp.isEmpty()) {
                         QDir dir;
                         dir.mkpath(dataPath);
                         QTemporaryFile tf(dataPath + "/scXXXXXX.mscz");
                         tf.setAutoRemove(false);
                         if (!tf.open()) {
                               printf("autoSaveTimerTimeout(): create temporary file failed\n");
-                              return;
+                              break;
                               }
-                        s->setTmpName(tf.fileName());
-                        QFileInfo info(tf.fileName());
-                        s->saveCompressedFile(&tf, info);
+                        tmp = tf.fileName();
                         tf.close();
+                        s->setTmpName(tmp);
                         sessionChanged = true;
                         }
+                  AutoSaveJob job;
+                  job.path = tmp;
+                  QFileInfo info(tmp);
+                  try {
+                        job.entries = s->archiveEntries(info);
+                        }
+                  catch (QString e) {
+                        printf("autoSaveTimerTimeout(): %s\n", qPrintable(e));
+                        continue;
+                        }
+                  jobs.append(job);
                   s->setAutosaveDirty(false);
                   }
+            if (!jobs.isEmpty())
+                  autoSaveFuture = QtConcurrent::run(writeAutoSave, jobs);
             }
       if (sessionChanged)
             writeSessionFile(false);
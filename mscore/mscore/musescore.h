@@ -247,6 +247,7 @@ class MuseScore : public QMainWindow {
       QScriptEngineDebugger* scriptDebugger;
 
       QTimer* autoSaveTimer;
+      QFuture<void> autoSaveFuture;       // compresses autosave snapshots
       QList<QAction*> pluginActions;
       QSignalMapper* pluginMapper;
 
@@ -422,6 +423,7 @@ class MuseScore : public QMainWindow {
       MuseScore();
       ~MuseScore();
       bool checkDirty(Score*);
+      void waitForAutoSave();
       PlayPanel* getPlayPanel() const { return playPanel; }
       QMenu* genCreateMenu(QWidget* parent = 0);
       int appendScore(Score*);
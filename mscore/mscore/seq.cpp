@@ -58,6 +58,13 @@
 
 #include "fluid.h"
 #include "click.h"
+#include "libmscore/trace.h"
+
+#ifdef Q_WS_WIN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 Seq* seq;
 MasterSynth* synti;
@@ -82,10 +89,12 @@ Seq::Seq()
       endTick  = 0;
       state    = TRANSPORT_STOP;
       driver   = 0;
-      playPos  = events.constBegin();
+      playPos  = 0;
+      guiPos   = 0;
 
       playTime = 0.0;
       startTime = 0.0;
+      playTempo = 1.0;
       curTick   = 0;
       curUtick  = 0;
       metronomeVolume = 0.3;
@@ -158,6 +167,10 @@ void Seq::setScoreView(ScoreView* v)
 //            connect(cs, SIGNAL(selectionChanged(int)), SLOT(selectionChanged(int)));
             synti->setState(cs->syntiState());
             initInstruments();
+            SeqMsg msg;
+            msg.id    = SEQ_TEMPO_CHANGE;
+            msg.rdata = cs->tempomap()->relTempo();
+            guiToSeq(msg);
             seek(cs->playPos());
             }
       tackRest = 0;
@@ -340,7 +353,7 @@ void Seq::stop()
       if (cv)
             cv->setCursorOn(false);
       if (cs) {
-            cs->setPlayPos(playPos.key());
+            cs->setPlayPos(events.utick(playPos));
             cs->setLayoutAll(false);
             cs->setUpdateAll();
             cs->end();
@@ -534,23 +547,17 @@ void Seq::processMessages()
             SeqMsg msg = toSeq.dequeue();
             switch(msg.id) {
                   case SEQ_TEMPO_CHANGE:
-                        {
-                        if (playTime != 0) {
-                              int tick = cs->utime2utick(playTime);
-                              cs->tempomap()->setRelTempo(msg.rdata);
-                              cs->repeatList()->update();
-                              playTime = cs->utick2utime(tick);
-                              startTime = curTime() - playTime;
-                              }
-                        else
-                              cs->tempomap()->setRelTempo(msg.rdata);
-                        }
+                        // keep the position: play time scales
+                        // with 1/relTempo
+                        playTime  = playTime * playTempo / msg.rdata;
+                        startTime = curTime() - playTime;
+                        playTempo = msg.rdata;
                         break;
                   case SEQ_PLAY:
                         putEvent(msg.event);
                         break;
                   case SEQ_SEEK:
-                        setPos(msg.data);
+                        setPos(msg.data, msg.rdata);
                         break;
                   }
             }
@@ -595,6 +602,7 @@ void Seq::metronome(unsigned n, float* l, float* r)
 
 void Seq::process(unsigned n, float* lbuffer, float* rbuffer)
       {
+      TRACE("Seq::process");
       unsigned frames = n;
       int driverState = driver->getState();
 
@@ -619,15 +627,17 @@ void Seq::process(unsigned n, float* lbuffer, float* rbuffer)
             // play events for one segment
             //
             unsigned framePos = 0;
-            double endTime = playTime + double(frames)/double(MScore::sampleRate);
-            for (; playPos != events.constEnd(); ++playPos) {
-                  double f = cs->utick2utime(playPos.key());
+            double endTime  = playTime + double(frames)/double(MScore::sampleRate);
+            int nevents     = events.size();
+            for (; playPos < nevents; ++playPos) {
+                  const PlayEvent& pe = events.at(playPos);
+                  double f = pe.time / playTempo;
                   if (f >= endTime)
                         break;
                   int n = lrint((f - playTime) * MScore::sampleRate);
 
                   if (n < 0) {
-                        printf("%d:  %f - %f\n", playPos.key(), f, playTime);
+                        printf("%d:  %f - %f\n", pe.utick, f, playTime);
 				n = 0;
                         }
                   metronome(n, l, r);
@@ -638,9 +648,9 @@ void Seq::process(unsigned n, float* lbuffer, float* rbuffer)
 
                   frames    -= n;
                   framePos  += n;
-                  const Event& event = playPos.value();
+                  const Event& event = pe.event;
                   playEvent(event);
-                  playTick = playPos.key();
+                  playTick = pe.utick;
                   if (event.type() == ME_TICK1)
                         tickRest = tickLength;
                   else if (event.type() == ME_TICK2)
@@ -651,7 +661,7 @@ void Seq::process(unsigned n, float* lbuffer, float* rbuffer)
                   synti->process(frames, l, r);
                   playTime += double(frames)/double(MScore::sampleRate);
                   }
-            if (playPos == events.constEnd()) {
+            if (playPos == nevents) {
                   driver->stopTransport();
                   rewindStart();
                   }
@@ -713,12 +723,9 @@ void Seq::collectEvents()
       activeNotes.clear();
 
       cs->toEList(&events);
-      endTick = 0;
-      if (!events.empty()) {
-            EventMap::const_iterator e = events.constEnd();
-            --e;
-            endTick = e.key();
-            }
+      endTick = events.isEmpty() ? 0 : events.last().utick;
+      playPos = 0;
+      guiPos  = 0;
 
       PlayPanel* pp = mscore->getPlayPanel();
       if (pp)
@@ -782,12 +789,15 @@ void Seq::processToGuiMessages()
 
 void Seq::setRelTempo(double relTempo)
       {
+      cs->tempomap()->setRelTempo(relTempo);
+      cs->repeatList()->update();
+
       SeqMsg msg;
       msg.rdata = relTempo;
       msg.id    = SEQ_TEMPO_CHANGE;
       guiToSeq(msg);
 
-      double t = cs->tempomap()->tempo(playPos.key()) * relTempo;
+      double t = cs->tempomap()->tempo(events.utick(playPos)) * relTempo;
 
       PlayPanel* pp = mscore->getPlayPanel();
       if (pp) {
@@ -798,11 +808,12 @@ void Seq::setRelTempo(double relTempo)
 
 //---------------------------------------------------------
 //   setPos
-//    seek
+//    seek to playlist index pos at play time time for
+//    relative tempo 1.0
 //    realtime environment
 //---------------------------------------------------------
 
-void Seq::setPos(int utick)
+void Seq::setPos(int pos, double time)
       {
       // send note off events
       foreach(Event n, activeNotes) {
@@ -813,9 +824,9 @@ void Seq::setPos(int utick)
             }
       activeNotes.clear();
 
-      playTime  = cs->utick2utime(utick);
+      playTime  = time / playTempo;
       startTime = curTime() - playTime;
-      playPos   = events.lowerBound(utick);
+      playPos   = qMin(pos, events.size());     // the playlist may be newer
       guiPos    = playPos;
       }
 
@@ -839,8 +850,9 @@ void Seq::seek(int tick)
       tick = cs->repeatList()->tick2utick(tick);
 
       SeqMsg msg;
-      msg.data = tick;
-      msg.id   = SEQ_SEEK;
+      msg.id    = SEQ_SEEK;
+      msg.data  = events.lowerBound(tick);
+      msg.rdata = cs->utick2utime(tick) * cs->tempomap()->relTempo();
       guiToSeq(msg);
       mscore->setPos(tick);
       foreach(const Note* n, markedNotes) {
@@ -956,17 +968,13 @@ void Seq::sendEvent(const Event& ev)
 
 void Seq::nextMeasure()
       {
-      EventMap::const_iterator i = playPos;
       const Note* note = 0;
-      for (;;) {
-            if (i.value().type() == ME_NOTEON) {
-                  const Event& n = i.value();
+      for (int i = qMin(playPos, events.size() - 1); i >= 0; --i) {
+            const Event& n = events.at(i).event;
+            if (n.type() == ME_NOTEON) {
                   note = n.note();
                   break;
                   }
-            if (i == events.begin())
-                  break;
-            --i;
             }
       if (!note)
             return;
@@ -974,7 +982,7 @@ void Seq::nextMeasure()
       m = m->nextMeasure();
       if (m) {
             int rtick = m->tick() - note->chord()->tick();
-            seek(playPos.key() + rtick);
+            seek(events.utick(playPos) + rtick);
             }
       }
 
@@ -984,13 +992,13 @@ void Seq::nextMeasure()
 
 void Seq::nextChord()
       {
-      int tick = playPos.key();
-      for (EventMap::const_iterator i = playPos; i != events.constEnd(); ++i) {
-            if (i.value().type() != ME_NOTEON)
+      int tick = events.utick(playPos);
+      for (int i = playPos; i < events.size(); ++i) {
+            const PlayEvent& pe = events.at(i);
+            if (pe.event.type() != ME_NOTEON)
                   continue;
-            const Event& n = i.value();
-            if (i.key() > tick && n.velo()) {
-                  seek(i.key());
+            if (pe.utick > tick && pe.event.velo()) {
+                  seek(pe.utick);
                   break;
                   }
             }
@@ -1002,16 +1010,13 @@ void Seq::nextChord()
 
 void Seq::prevMeasure()
       {
-      EventMap::const_iterator i = playPos;
       const Note* note = 0;
-      for (;;) {
-            if (i.value().type() == ME_NOTEON) {
-                  note = i.value().note();
+      for (int i = qMin(playPos, events.size() - 1); i >= 0; --i) {
+            const Event& n = events.at(i).event;
+            if (n.type() == ME_NOTEON) {
+                  note = n.note();
                   break;
                   }
-            if (i == events.begin())
-                  break;
-            --i;
             }
       if (!note)
             return;
@@ -1020,7 +1025,7 @@ void Seq::prevMeasure()
 
       if (m) {
             int rtick = note->chord()->tick() - m->tick();
-            seek(playPos.key() - rtick);
+            seek(events.utick(playPos) - rtick);
             }
       else
             seek(0);
@@ -1032,35 +1037,27 @@ void Seq::prevMeasure()
 
 void Seq::prevChord()
       {
-      int tick  = playPos.key();
+      if (events.isEmpty())
+            return;
+      int tick  = events.utick(playPos);
+      int start = qMin(playPos, events.size() - 1);
       //find the chord just before playpos
-      EventMap::const_iterator i = playPos;
-      for (;;) {
-            if (i.value().type() == ME_NOTEON) {
-                  const Event& n = i.value();
-                  if (i.key() < tick && n.velo()) {
-                        tick = i.key();
-                        break;
-                        }
-                  }
-            if (i == events.constBegin())
+      int i = start;
+      for (; i >= 0; --i) {
+            const PlayEvent& pe = events.at(i);
+            if (pe.event.type() == ME_NOTEON && pe.utick < tick && pe.event.velo()) {
+                  tick = pe.utick;
                   break;
-            --i;
+                  }
             }
       //go the previous chord
-      if (i != events.constBegin()) {
-            i = playPos;
-            for (;;) {
-                  if (i.value().type() == ME_NOTEON) {
-                        const Event& n = i.value();
-                        if (i.key() < tick && n.velo()) {
-                              seek(i.key());
-                              break;
-                              }
-                        }
-                  if (i == events.constBegin())
+      if (i > 0) {
+            for (i = start; i >= 0; --i) {
+                  const PlayEvent& pe = events.at(i);
+                  if (pe.event.type() == ME_NOTEON && pe.utick < tick && pe.event.velo()) {
+                        seek(pe.utick);
                         break;
-                  --i;
+                        }
                   }
             }
       }
@@ -1094,7 +1091,8 @@ void Seq::eventToGui(Event e)
       SeqMsg msg;
       msg.event = e;
       msg.id    = SEQ_MIDI_INPUT_EVENT;
-      fromSeq.enqueue(msg);
+      if (!fromSeq.tryEnqueue(msg))
+            printf("===Seq: midi input overflow\n");
       }
 
 //---------------------------------------------------------
@@ -1126,29 +1124,38 @@ SeqMsgFifo::SeqMsgFifo()
       clear();
       }
 
+//---------------------------------------------------------
+//   tryEnqueue
+//    never blocks; returns false if the fifo is full
+//---------------------------------------------------------
+
+bool SeqMsgFifo::tryEnqueue(const SeqMsg& msg)
+      {
+      if (isFull())
+            return false;
+      messages[widx] = msg;
+      push();
+      return true;
+      }
+
 //---------------------------------------------------------
 //   enqueue
+//    if the fifo is full, poll in 1 ms steps until the
+//    reader made room; the message is dropped after 500 ms
 //---------------------------------------------------------
 
 void SeqMsgFifo::enqueue(const SeqMsg& msg)
       {
-      int i = 0;
-      int n = 50;
-
-      QMutex mutex;
-      QWaitCondition qwc;
-      mutex.lock();
-      for (; i < n; ++i) {
-            if (!isFull())
-                  break;
-            qwc.wait(&mutex,100);
-            }
-      if (i == n) {
-            printf("===SeqMsgFifo: overflow\n");
-            return;
+      for (int i = 0; i < 500; ++i) {
+            if (tryEnqueue(msg))
+                  return;
+#ifdef Q_WS_WIN
+            Sleep(1);
+#else
+            usleep(1000);
+#endif
             }
-      messages[widx] = msg;
-      push();
+      printf("===SeqMsgFifo: overflow, message %d dropped\n", msg.id);
       }
 
 //---------------------------------------------------------
@@ -1235,12 +1242,13 @@ void Seq::heartBeat()
       if (pp)
             pp->heartBeat2(lrint(endTime));
 
-      for (; guiPos != events.constEnd(); ++guiPos) {
-            double f = cs->utick2utime(guiPos.key());
-            if (f >= endTime)
+      double relTempo = cs->tempomap()->relTempo();
+      for (; guiPos < events.size(); ++guiPos) {
+            const PlayEvent& pe = events.at(guiPos);
+            if (pe.time / relTempo >= endTime)
                   break;
-            if (guiPos.value().type() == ME_NOTEON) {
-                  Event n = guiPos.value();
+            if (pe.event.type() == ME_NOTEON) {
+                  const Event& n = pe.event;
                   const Note* note1 = n.note();
                   if (n.velo()) {
                         while (note1) {
@@ -39,7 +39,12 @@ class MasterSynth;
 
 //---------------------------------------------------------
 //   SeqMsg
-//    message format for gui -> sequencer messages
+//    message format for gui -> sequencer messages; the
+//    gui resolves positions and times, the sequencer only
+//    sets them:
+//    SEQ_TEMPO_CHANGE  rdata: relative tempo
+//    SEQ_SEEK          data:  index into the playlist
+//                      rdata: play time for relative tempo 1.0
 //---------------------------------------------------------
 
 enum { SEQ_NO_MESSAGE, SEQ_TEMPO_CHANGE, SEQ_PLAY, SEQ_SEEK,
@@ -65,7 +70,8 @@ class SeqMsgFifo : public FifoBase {
    public:
       SeqMsgFifo();
       virtual ~SeqMsgFifo()     {}
-      void enqueue(const SeqMsg&);        // put object on fifo
+      bool tryEnqueue(const SeqMsg&);     // put object on fifo, false if full
+      void enqueue(const SeqMsg&);        // put object on fifo, poll if full
       SeqMsg dequeue();                   // remove object from fifo
       };
 
@@ -92,14 +98,15 @@ class Seq : public QObject {
       double meterPeakValue[2];
       int peakTimer[2];
 
-      EventMap events;                    // playlist
+      EventTimeline events;               // playlist
 
       QList<Event> activeNotes;           // notes sounding
       double playTime;
       double startTime;
+      double playTempo;                   // relative tempo, set in real time thread
 
-      EventMap::const_iterator playPos;   // moved in real time thread
-      EventMap::const_iterator guiPos;    // moved in gui thread
+      int playPos;                        // index into events, moved in real time thread
+      int guiPos;                         // index into events, moved in gui thread
       QList<const Note*> markedNotes;     // notes marked as sounding
 
       int endTick;
@@ -121,7 +128,7 @@ class Seq : public QObject {
 
       void stopTransport();
       void startTransport();
-      void setPos(int);
+      void setPos(int pos, double time);
       void playEvent(const Event&);
       void guiToSeq(const SeqMsg& msg);
       void metronome(unsigned n, float* l, float* r);
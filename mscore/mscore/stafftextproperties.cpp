@@ -350,5 +350,5 @@ void StaffTextProperties::saveValues()
             }
 
       staffText->score()->updateChannel();
-      staffText->score()->setPlaylistDirty(true);
+      staffText->score()->invalidateEvents();
       }
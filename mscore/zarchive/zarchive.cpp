@@ -101,6 +101,9 @@ class ZipEntryP
 //! This macro updates a one-char-only CRC; it's the Info-Zip macro re-adapted
 #define CRC32(c, b) crcTable[((int)c^b) & 0xff] ^ (c >> 8)
 
+//! Size of the blocks which are deflated in parallel
+static const int DEFLATE_BLOCK = 128 * 1024;
+
 //---------------------------------------------------------
 //   errorString
 //---------------------------------------------------------
@@ -158,12 +161,12 @@ Zip::Zip()
       {
 	headers = 0;
 	device  = 0;
+      _level  = 9;
 
 	// keep an unsigned pointer so we avoid to over bloat the code with casts
 	uBuffer  = (uchar*) buffer1;
 	crcTable = (quint32*) get_crc_table();
 	memset(buffer1, 0, sizeof(buffer1));
-	memset(buffer2, 0, sizeof(buffer2));
       }
 
 Zip::~Zip()
@@ -214,6 +217,74 @@ bool Zip::createArchive(QIODevice* dev)
 	return true;
       }
 
+//---------------------------------------------------------
+//   DeflateBlock
+//    a part of an entry which is deflated on its own;
+//    blocks end on a byte boundary (Z_SYNC_FLUSH) and only
+//    the last one is final, so the concatenated output of
+//    all blocks of an entry is one deflate stream
+//---------------------------------------------------------
+
+struct DeflateBlock {
+      int entry;              // index in entry list
+      const QByteArray* data;
+      int pos;                // start of block in data
+      int size;
+      int level;
+      bool isPNGFile;
+      bool last;
+
+      QByteArray out;
+      quint32 crc;
+      bool ok;
+      };
+
+//---------------------------------------------------------
+//   deflateBlock
+//    compress one block; the preceding 32k of data
+//    are used as dictionary to keep the compression ratio
+//---------------------------------------------------------
+
+static void deflateBlock(DeflateBlock& b)
+      {
+      const Bytef* data = (const Bytef*)b.data->constData() + b.pos;
+      b.crc = crc32(0L, data, b.size);
+      b.ok  = false;
+
+	z_stream zstr;
+	zstr.zalloc = Z_NULL;
+	zstr.zfree  = Z_NULL;
+	zstr.opaque = Z_NULL;
+
+	// negative windowBits: raw deflate stream
+	if (deflateInit2(&zstr, b.level, Z_DEFLATED, -MAX_WBITS, 8,
+	   b.isPNGFile ? Z_RLE : Z_DEFAULT_STRATEGY) != Z_OK)
+            return;
+      int dict = qMin(b.pos, 1 << MAX_WBITS);
+      if (dict && deflateSetDictionary(&zstr, data - dict, dict) != Z_OK) {
+            deflateEnd(&zstr);
+            return;
+            }
+      zstr.next_in  = (Bytef*)data;
+      zstr.avail_in = b.size;
+
+      int flush = b.last ? Z_FINISH : Z_SYNC_FLUSH;
+      int n     = deflateBound(&zstr, b.size) + 64;
+      int zret;
+      for (;;) {
+            b.out.resize(n);
+            zstr.next_out  = (Bytef*)b.out.data() + zstr.total_out;
+            zstr.avail_out = n - zstr.total_out;
+            zret = deflate(&zstr, flush);
+            if (zret == Z_STREAM_ERROR || zstr.avail_out != 0)
+                  break;
+            n *= 2;
+            }
+      b.out.resize(zstr.total_out);
+      deflateEnd(&zstr);
+      b.ok = zret == (b.last ? Z_STREAM_END : Z_OK);
+      }
+
 //---------------------------------------------------------
 //   createEntry
 //    Add a new entry \p entryName to the archive, reading
@@ -224,7 +295,8 @@ bool Zip::createArchive(QIODevice* dev)
 //    \p actualFile is ignored.
 //	For a PNG file, \p isPNGFile must be true and zlib
 //    strategy Z_RLE is used.
-//	Compression level is determined by \p level.
+//	Compression level is determined by \p level; -1 uses
+//    the level of the archive.
 //---------------------------------------------------------
 
 bool Zip::createEntry(const QString& entryName,
@@ -240,12 +312,125 @@ bool Zip::createEntry(const QString& entryName,
 		lastError = ReadFailed;
             return false;
             }
+      QList<ZipData> entries;
+      entries.append(ZipData(entryName, QByteArray(), dirOnly ? 0 : level, isPNGFile));
+      if (!dirOnly) {
+            qint64 size = actualFile.size();
+            entries[0].data = actualFile.read(size);
+            actualFile.close();
+            if (entries[0].data.size() != size) {
+                  lastError = ReadFailed;
+                  return false;
+                  }
+            }
+      return createEntries(entries, dt);
+      }
 
-	// create header and store it to write a central directory later
-	ZipEntryP* h = new ZipEntryP;
+//---------------------------------------------------------
+//   createEntries
+//    Add the entries to the archive with timestamp \p dt.
+//    Entries larger than DEFLATE_BLOCK are compressed in
+//    blocks; the blocks of all entries are compressed
+//    concurrently in the global thread pool and written
+//    in order.
+//---------------------------------------------------------
+
+bool Zip::createEntries(const QList<ZipData>& entries, QDateTime dt)
+      {
+	if (device == 0) {
+		lastError = NoOpenArchive;
+            return false;
+            }
+
+      QList<DeflateBlock> blocks;
+      for (int i = 0; i < entries.size(); ++i) {
+            const ZipData& e = entries[i];
+            int level = e.level < 0 ? _level : e.level;
+            if (level == 0)
+                  continue;
+            int size = e.data.size();
+            int pos  = 0;
+            do {
+                  DeflateBlock b;
+                  b.entry     = i;
+                  b.data      = &e.data;
+                  b.pos       = pos;
+                  b.size      = qMin(DEFLATE_BLOCK, size - pos);
+                  b.level     = level;
+                  b.isPNGFile = e.isPNGFile;
+                  b.last      = pos + b.size == size;
+                  b.crc       = 0;
+                  b.ok        = false;
+                  blocks.append(b);
+                  pos += b.size;
+                  } while (pos < size);
+            }
+      if (blocks.size() > 1 && QThreadPool::globalInstance()->maxThreadCount() > 1)
+            QtConcurrent::blockingMap(blocks, deflateBlock);
+      else {
+            for (int i = 0; i < blocks.size(); ++i)
+                  deflateBlock(blocks[i]);
+            }
+
+      int bi = 0;
+      for (int i = 0; i < entries.size(); ++i) {
+            const ZipData& e = entries[i];
+            int level = e.level < 0 ? _level : e.level;
+
+            // create header and store it to write a central directory later
+            ZipEntryP* h  = new ZipEntryP;
+            h->compMethod = (level == 0) ? 0 : 0x0008;
+            setDateTime(h, dt);
+            h->szUncomp   = e.data.size();
+
+            int firstBlock = bi;
+            if (level == 0) {
+                  h->crc    = crc32(0L, (const Bytef*)e.data.constData(), e.data.size());
+                  h->szComp = e.data.size();
+                  }
+            else {
+                  h->crc = crc32(0L, Z_NULL, 0);
+                  for (; bi < blocks.size() && blocks[bi].entry == i; ++bi) {
+                        const DeflateBlock& b = blocks[bi];
+                        if (!b.ok) {
+                              delete h;
+                              lastError = ZlibError;
+                              return false;
+                              }
+                        h->crc     = crc32_combine(h->crc, b.crc, b.size);
+                        h->szComp += b.out.size();
+                        }
+                  }
 
-	h->compMethod = (level == 0) ? 0 : 0x0008;
+            h->lhOffset = device->pos();
+            if (!writeLocalHeader(h, e.name.toUtf8())) {
+                  delete h;
+                  return false;
+                  }
+            bool ok = true;
+            if (level == 0)
+                  ok = device->write(e.data) == e.data.size();
+            else {
+                  for (int k = firstBlock; ok && k < bi; ++k)
+                        ok = device->write(blocks[k].out) == blocks[k].out.size();
+                  }
+            if (!ok) {
+                  delete h;
+                  lastError = WriteFailed;
+                  return false;
+                  }
+            headers->insert(e.name, h);
+            }
+      return true;
+      }
+
+//---------------------------------------------------------
+//   setDateTime
+//    store dt in dos format
+//---------------------------------------------------------
 
+void Zip::setDateTime(ZipEntryP* h, const QDateTime& dt)
+      {
 	QDate d = dt.date();
 	h->modDate[1] = ((d.year() - 1980) << 1) & 254;
 	h->modDate[1] |= ((d.month() >> 3) & 1);
@@ -257,11 +442,15 @@ bool Zip::createEntry(const QString& entryName,
 	h->modTime[1] |= ((t.minute() >> 3) & 7);
 	h->modTime[0] = ((t.minute() & 7) << 5) & 224;
 	h->modTime[0] |= t.second() / 2;
+      }
 
-	h->szUncomp = dirOnly ? 0 : actualFile.size();
-
-	// **** Write local file header ****
+//---------------------------------------------------------
+//   writeLocalHeader
+//    write local file header and file name of entry h
+//---------------------------------------------------------
 
+bool Zip::writeLocalHeader(const ZipEntryP* h, const QByteArray& entryNameBytes)
+      {
 	// signature
 	buffer1[0] = 'P'; buffer1[1] = 'K';
 	buffer1[2] = 0x3; buffer1[3] = 0x4;
@@ -286,211 +475,29 @@ bool Zip::createEntry(const QString& entryName,
 	buffer1[ZIP_LH_OFF_MODD] = h->modDate[0];
 	buffer1[ZIP_LH_OFF_MODD + 1] = h->modDate[1];
 
-	// skip crc (4bytes) [14,15,16,17]
-
-	// skip compressed size but include evtl. encryption header (4bytes: [18,19,20,21])
-	buffer1[ZIP_LH_OFF_CSIZE] =
-	buffer1[ZIP_LH_OFF_CSIZE + 1] =
-	buffer1[ZIP_LH_OFF_CSIZE + 2] =
-	buffer1[ZIP_LH_OFF_CSIZE + 3] = 0;
+	// crc [14,15,16,17]
+	setULong(h->crc, buffer1, ZIP_LH_OFF_CRC);
 
-	h->szComp = 0;
+	// compressed size [18,19,20,21]
+	setULong(h->szComp, buffer1, ZIP_LH_OFF_CSIZE);
 
 	// uncompressed size [22,23,24,25]
 	setULong(h->szUncomp, buffer1, ZIP_LH_OFF_USIZE);
 
 	// filename length
-	QByteArray entryNameBytes = entryName.toUtf8();
 	int sz = entryNameBytes.size();
-
 	buffer1[ZIP_LH_OFF_NAMELEN] = sz & 0xFF;
 	buffer1[ZIP_LH_OFF_NAMELEN + 1] = (sz >> 8) & 0xFF;
 
 	// extra field length
 	buffer1[ZIP_LH_OFF_XLEN] = buffer1[ZIP_LH_OFF_XLEN + 1] = 0;
 
-	// Store offset to write crc and compressed size
-	h->lhOffset = device->pos();
-	quint32 crcOffset = h->lhOffset + ZIP_LH_OFF_CRC;
-
-	if (device->write(buffer1, ZIP_LOCAL_HEADER_SIZE) != ZIP_LOCAL_HEADER_SIZE) {
-		delete h;
-		lastError = WriteFailed;
-            return false;
-	      }
-
-	// Write out filename
-	if (device->write(entryNameBytes) != sz) {
-		delete h;
-		lastError = WriteFailed;
-            return false;
-	      }
-
-	qint64 written = 0;
-	quint32 crc = crc32(0L, Z_NULL, 0);
-
-	if (!dirOnly) {
-		// Write file data
-		qint64 read = 0;
-		qint64 totRead = 0;
-		qint64 toRead = actualFile.size();
-
-		if (level == 0) {
-			while ( (read = actualFile.read(buffer1, BUFFER_SIZE)) > 0 ) {
-				crc = crc32(crc, uBuffer, read);
-
-				if ( (written = device->write(buffer1, read)) != read ) {
-					actualFile.close();
-					delete h;
-					lastError = WriteFailed;
-                              return false;
-				      }
-			      }
-		      }
-		else {
-			z_stream zstr;
-
-			// Initialize zalloc, zfree and opaque before calling the init function
-			zstr.zalloc = Z_NULL;
-			zstr.zfree = Z_NULL;
-			zstr.opaque = Z_NULL;
-
-			int zret;
-
-			// Use deflateInit2 with negative windowBits to get raw compression
-			if ((zret = deflateInit2_(
-					&zstr,
-					(int)level,
-					Z_DEFLATED,
-					-MAX_WBITS,
-					8,
-					isPNGFile ? Z_RLE : Z_DEFAULT_STRATEGY,
-					ZLIB_VERSION,
-					sizeof(z_stream)
-				)) != Z_OK ) {
-				actualFile.close();
-				delete h;
-				lastError = ZlibError;
-                        return false;
-			      }
-
-			qint64 compressed;
-
-			int flush = Z_NO_FLUSH;
-
-			do {
-				read = actualFile.read(buffer1, BUFFER_SIZE);
-				totRead += read;
-
-				if (read == 0)
-					break;
-				if (read < 0) {
-					actualFile.close();
-					deflateEnd(&zstr);
-					delete h;
-					lastError = ReadFailed;
-                              return false;
-				      }
-
-				crc = crc32(crc, uBuffer, read);
-
-				zstr.next_in = (Bytef*) buffer1;
-				zstr.avail_in = (uInt)read;
-
-				// Tell zlib if this is the last chunk we want to encode
-				// by setting the flush parameter to Z_FINISH
-				flush = (totRead == toRead) ? Z_FINISH : Z_NO_FLUSH;
-
-				// Run deflate() on input until output buffer not full
-				// finish compression if all of source has been read in
-        		do
-        		{
-					zstr.next_out = (Bytef*) buffer2;
-					zstr.avail_out = BUFFER_SIZE;
-
-					zret = deflate(&zstr, flush);
-					// State not clobbered
-
-					// Write compressed data to file and empty buffer
-					compressed = BUFFER_SIZE - zstr.avail_out;
-
-					if (device->write(buffer2, compressed) != compressed)
-					{
-						deflateEnd(&zstr);
-						actualFile.close();
-						delete h;
-                                    lastError = WriteFailed;
-                                    return false;
-					}
-
-					written += compressed;
-
-				} while (zstr.avail_out == 0);
-
-			} while (flush != Z_FINISH);
-
-			deflateEnd(&zstr);
-
-		} // if (level != STORE)
-
-		actualFile.close();
-	}
-
-	// Store end of entry offset
-	quint32 current = device->pos();
-
-	// Update crc and compressed size in local header
-	if (!device->seek(crcOffset)) {
-		delete h;
-		lastError = SeekFailed;
-            return false;
-	      }
-
-	h->crc = dirOnly ? 0 : crc;
-	h->szComp += written;
-
-	setULong(h->crc, buffer1, 0);
-	setULong(h->szComp, buffer1, 4);
-	if ( device->write(buffer1, 8) != 8) {
-		delete h;
+	if (device->write(buffer1, ZIP_LOCAL_HEADER_SIZE) != ZIP_LOCAL_HEADER_SIZE
+	   || device->write(entryNameBytes) != sz) {
 		lastError = WriteFailed;
             return false;
 	      }
-
-	// Seek to end of entry
-	if (!device->seek(current)) {
-		delete h;
-		lastError = SeekFailed;
-            return false;
-	      }
-
-	if ((h->gpFlag[0] & 8) == 8) {
-		// Write data descriptor
-
-		// Signature: PK\7\8
-		buffer1[0] = 'P';
-		buffer1[1] = 'K';
-		buffer1[2] = 0x07;
-		buffer1[3] = 0x08;
-
-		// CRC
-		setULong(h->crc, buffer1, ZIP_DD_OFF_CRC32);
-
-		// Compressed size
-		setULong(h->szComp, buffer1, ZIP_DD_OFF_CSIZE);
-
-		// Uncompressed size
-		setULong(h->szUncomp, buffer1, ZIP_DD_OFF_USIZE);
-
-		if (device->write(buffer1, ZIP_DD_SIZE_WS) != ZIP_DD_SIZE_WS) {
-			delete h;
-			lastError = WriteFailed;
-                  return false;
-		      }
-	      }
-
-	headers->insert(entryName, h);
-	return true;
+      return true;
       }
 
 //---------------------------------------------------------
@@ -768,6 +775,8 @@ Unzip::Unzip()
 	eocdOffset            = 0;
 	cdEntryCount          = 0;
 	unsupportedEntryCount = 0;
+      map                   = 0;
+      mapSize               = 0;
       }
 
 Unzip::~Unzip()
@@ -795,7 +804,12 @@ bool Unzip::openArchive(const QString& filename)
 		lastError = OpenFailed;
             return false;
 	      }
-	return openArchive(file);
+	if (!openArchive(file))
+            return false;
+      // entries are read from the mapped file by openFile()
+      mapSize = file->size();
+      map     = file->map(0, mapSize);
+      return true;
       }
 
 //---------------------------------------------------------
@@ -864,6 +878,203 @@ bool Unzip::extractFile(const QString& filename, QIODevice* dev)
       return false;
       }
 
+//---------------------------------------------------------
+//   UnzipDevice
+//    read only device which inflates a zip entry while it
+//    is read; the compressed data are not copied if the
+//    archive is mapped
+//---------------------------------------------------------
+
+class UnzipDevice : public QIODevice
+      {
+      const uchar* data;      // compressed data
+      QByteArray copy;        // compressed data if archive is not mapped
+      quint32 szComp;
+      quint32 szUncomp;
+      quint32 crc;
+      bool deflated;
+
+      z_stream zstr;
+      bool streamEnd;
+      qint64 _pos;            // uncompressed bytes delivered so far
+      quint32 myCRC;          // crc of the first _pos bytes
+
+      void rewind();
+      qint64 extract(char* buf, qint64 len);
+
+   protected:
+      virtual qint64 readData(char* buf, qint64 maxlen);
+      virtual qint64 writeData(const char*, qint64) { return -1; }
+
+   public:
+      UnzipDevice(const uchar* data, const QByteArray& copy, const ZipEntryP& entry);
+      ~UnzipDevice();
+      virtual qint64 size() const { return szUncomp; }
+      virtual bool seek(qint64 pos);
+      };
+
+UnzipDevice::UnzipDevice(const uchar* d, const QByteArray& c, const ZipEntryP& entry)
+   : copy(c)
+      {
+      data     = copy.isEmpty() ? d : (const uchar*)copy.constData();
+      szComp   = entry.szComp;
+      szUncomp = entry.szUncomp;
+      crc      = entry.crc;
+      deflated = entry.compMethod == 8;
+	zstr.zalloc = Z_NULL;
+	zstr.zfree  = Z_NULL;
+	zstr.opaque = Z_NULL;
+	zstr.next_in  = Z_NULL;
+	zstr.avail_in = 0;
+      // negative windowBits: raw deflate stream
+      if (deflated && inflateInit2(&zstr, -MAX_WBITS) != Z_OK) {
+            setErrorString("zlib init failed");
+            deflated = false;
+            szUncomp = 0;
+            }
+      rewind();
+      }
+
+UnzipDevice::~UnzipDevice()
+      {
+      if (deflated)
+            inflateEnd(&zstr);
+      }
+
+//---------------------------------------------------------
+//   rewind
+//---------------------------------------------------------
+
+void UnzipDevice::rewind()
+      {
+      if (deflated) {
+            inflateReset(&zstr);
+            zstr.next_in  = (Bytef*)data;
+            zstr.avail_in = szComp;
+            }
+      streamEnd = false;
+      _pos      = 0;
+      myCRC     = crc32(0L, Z_NULL, 0);
+      }
+
+//---------------------------------------------------------
+//   extract
+//    deliver the next len bytes at most; returns -1 on
+//    error
+//---------------------------------------------------------
+
+qint64 UnzipDevice::extract(char* buf, qint64 len)
+      {
+      len = qMin(len, qint64(szUncomp) - _pos);
+      if (len <= 0)
+            return 0;
+      if (deflated) {
+            zstr.next_out  = (Bytef*)buf;
+            zstr.avail_out = len;
+            while (zstr.avail_out && !streamEnd) {
+                  int zret = inflate(&zstr, Z_NO_FLUSH);
+                  if (zret == Z_STREAM_END)
+                        streamEnd = true;
+                  else if (zret != Z_OK) {
+                        setErrorString("corrupted zip entry");
+                        return -1;
+                        }
+                  }
+            len -= zstr.avail_out;
+            }
+      else
+            memcpy(buf, data + _pos, len);
+      myCRC = crc32(myCRC, (const Bytef*)buf, len);
+      _pos += len;
+      if (_pos == szUncomp && myCRC != crc) {
+            setErrorString("crc error in zip entry");
+            return -1;
+            }
+      return len;
+      }
+
+//---------------------------------------------------------
+//   readData
+//---------------------------------------------------------
+
+qint64 UnzipDevice::readData(char* buf, qint64 maxlen)
+      {
+      return extract(buf, maxlen);
+      }
+
+//---------------------------------------------------------
+//   seek
+//    going back restarts inflating at the entry start
+//---------------------------------------------------------
+
+bool UnzipDevice::seek(qint64 pos)
+      {
+      if (pos < 0 || pos > szUncomp || !QIODevice::seek(pos))
+            return false;
+      if (pos < _pos)
+            rewind();
+      char buf[4096];
+      while (_pos < pos) {
+            if (extract(buf, qMin(qint64(sizeof(buf)), pos - _pos)) <= 0)
+                  return false;
+            }
+      return true;
+      }
+
+//---------------------------------------------------------
+//   openFile
+//    Return a device which inflates entry \p filename
+//    while it is read or 0 on error. The device must be
+//    deleted before the archive is closed.
+//---------------------------------------------------------
+
+QIODevice* Unzip::openFile(const QString& filename)
+      {
+      ZipEntryP* h = headers ? headers->value(filename) : 0;
+      if (h == 0) {
+            lastError = FileNotFound;
+            return 0;
+            }
+      ZipEntryP& entry = *h;
+	if (!entry.lhEntryChecked) {
+	      lastError = parseLocalHeaderRecord(filename, entry);
+		entry.lhEntryChecked = true;
+		if (lastError != Ok)
+			return 0;
+	      }
+      if (entry.compMethod != 0 && entry.compMethod != 8) {
+            lastError = InvalidArchive;
+            return 0;
+            }
+      // stored entries are copied from the entry data
+      if (entry.compMethod == 0 && entry.szComp != entry.szUncomp) {
+            lastError = Corrupted;
+            return 0;
+            }
+      QByteArray copy;
+      if (map) {
+            if (qint64(entry.dataOffset) + entry.szComp > mapSize) {
+                  lastError = Corrupted;
+                  return 0;
+                  }
+            }
+      else {
+            if (!device->seek(entry.dataOffset)) {
+                  lastError = SeekFailed;
+                  return 0;
+                  }
+            copy = device->read(entry.szComp);
+            if (copy.size() != int(entry.szComp)) {
+                  lastError = ReadFailed;
+                  return 0;
+                  }
+            }
+      UnzipDevice* dev = new UnzipDevice(map ? map + entry.dataOffset : 0, copy, entry);
+      dev->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+      lastError = Ok;
+      return dev;
+      }
+
 //---------------------------------------------------------
 //   ZipEntry
 //---------------------------------------------------------
@@ -1226,8 +1437,10 @@ void Unzip::closeArchive()
 		headers = 0;
 	      }
 
-	delete device;
+	delete device;          // unmaps the file
       device                = 0;
+      map                   = 0;
+      mapSize               = 0;
 	cdOffset              = 0;
 	eocdOffset            = 0;
 	cdEntryCount          = 0;
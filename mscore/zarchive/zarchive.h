@@ -31,6 +31,22 @@ class QString;
 
 class ZipEntryP;
 
+//---------------------------------------------------------
+//   ZipData
+//    an entry for Zip::createEntries()
+//---------------------------------------------------------
+
+struct ZipData {
+      QString name;
+      QByteArray data;
+      int level;              // -1: level of the archive, 0: stored
+      bool isPNGFile;
+
+      ZipData() : level(-1), isPNGFile(false) {}
+      ZipData(const QString& n, const QByteArray& d, int l = -1, bool png = false)
+         : name(n), data(d), level(l), isPNGFile(png) {}
+      };
+
 //---------------------------------------------------------
 //   ZArchive
 //---------------------------------------------------------
@@ -74,22 +90,28 @@ class Zip : public ZArchive
 	QMap<QString, ZipEntryP*>* headers;
 
 	char buffer1[BUFFER_SIZE];
-	char buffer2[BUFFER_SIZE];
 
 	uchar* uBuffer;
 	const quint32* crcTable;
+      int _level;             // default compression level
 
 	void reset();
 	bool zLibInit();
 	void setULong(quint32 v, char* buffer, uint offset);
+      void setDateTime(ZipEntryP*, const QDateTime&);
+      bool writeLocalHeader(const ZipEntryP*, const QByteArray& entryNameBytes);
 
    public:
 	Zip();
 	~Zip();
 
+      int level() const       { return _level; }
+      void setLevel(int val)  { _level = qBound(0, val, 9); }
+
 	bool createArchive(const QString& file);
 	bool createArchive(QIODevice* device);
-	bool createEntry(const QString& entryName, QIODevice& actualFile, QDateTime dt, bool dirOnly = false, bool isPNGFile = false, int level = 9);
+	bool createEntry(const QString& entryName, QIODevice& actualFile, QDateTime dt, bool dirOnly = false, bool isPNGFile = false, int level = -1);
+      bool createEntries(const QList<ZipData>&, QDateTime dt);
 	bool closeArchive();
       };
 
@@ -131,6 +153,9 @@ class Unzip : public ZArchive
 	uchar* uBuffer;
 	const quint32* crcTable;
 
+	const uchar* map;       // archive file if it could be mapped
+	qint64 mapSize;
+
 	quint32 cdOffset;       // Central Directory (CD) offset
 	quint32 eocdOffset;     // End of Central Directory (EOCD) offset
 
@@ -165,6 +190,7 @@ class Unzip : public ZArchive
 	void closeArchive();
 	bool contains(const QString& file) const;
 	bool extractFile(const QString& filename, QIODevice* device);
+	QIODevice* openFile(const QString& filename);
       };
 
 #endif